@@ -17,11 +17,14 @@
 #include "csal_ipc_message_subscribequeue.h"
 #include "csal_ledmatrix.h"
 #include "os_led_strip.h"
+#include "os_led_encoder.h"
+#include "os_led_anim.h"
 #include "status_led.h"
 #include "os_ota.h"
 #include "os_st_ap.h"
 #include "os_pwm.h"
 #include "os_kvs.h"
 #include "os_unique_id.h"
+#include "os_time.h"
 #include "udp_fifostream.h"
 #endif
\ No newline at end of file
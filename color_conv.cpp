@@ -140,12 +140,124 @@ rgb_t kelvin2rgb(int kelvin)
     return col;
 }
 
+/**
+ * Table for kelvin2rgb_fast(), kelvin2rgb() worked out at compile time every 100K.
+ * pow() and log() aren't constexpr so the table has its own, good to well under a count of 255 over the range used
+ */
+#define COLOR_CONV_KELVIN_MIN 1000
+#define COLOR_CONV_KELVIN_MAX 40000
+#define COLOR_CONV_KELVIN_STEP 100
+#define COLOR_CONV_KELVIN_ENTRIES ((COLOR_CONV_KELVIN_MAX - COLOR_CONV_KELVIN_MIN) / COLOR_CONV_KELVIN_STEP + 1)
+
+// Natural log, x = m * 2^k with m in [1, 2) then the atanh series on m
+static constexpr double color_conv_ln(double x)
+{
+    int k = 0;
+    while (x >= 2.0)
+    {
+        x /= 2.0;
+        k++;
+    }
+    while (x < 1.0)
+    {
+        x *= 2.0;
+        k--;
+    }
+    double z = (x - 1.0) / (x + 1.0);
+    double term = z;
+    double sum = 0.0;
+    for (int n = 1; n < 60; n += 2)
+    {
+        sum += term / n;
+        term *= z * z;
+    }
+    return k * 0.69314718055994530942 + 2.0 * sum;
+}
+
+// e^x, x = k * ln(2) + r with |r| <= ln(2) / 2 then Taylor on r
+static constexpr double color_conv_exp(double x)
+{
+    int k = (int)(x / 0.69314718055994530942 + (x < 0 ? -0.5 : 0.5));
+    double r = x - k * 0.69314718055994530942;
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 30; n++)
+    {
+        term *= r / n;
+        sum += term;
+    }
+    for (; k > 0; k--)
+    {
+        sum *= 2.0;
+    }
+    for (; k < 0; k++)
+    {
+        sum /= 2.0;
+    }
+    return sum;
+}
+
+static constexpr uint8_t color_conv_clamp255(double x)
+{
+    return x < 0 ? 0 : x > 255 ? 255 : (uint8_t)x;
+}
+
+// Same curves as kelvin2rgb()
+static constexpr rgb_t color_conv_kelvin_entry(int kelvin)
+{
+    double temp = kelvin / 100.0;
+    rgb_t col = {0, 0, 0};
+    col.r = temp <= 66 ? 255 : color_conv_clamp255(329.698727446 * color_conv_exp(-0.1332047592 * color_conv_ln(temp - 60)));
+    col.g = temp <= 66 ? color_conv_clamp255(99.4708025861 * color_conv_ln(temp) - 161.1195681661)
+                       : color_conv_clamp255(288.1221695283 * color_conv_exp(-0.0755148492 * color_conv_ln(temp - 60)));
+    col.b = temp >= 66 ? 255 : temp <= 19 ? 0 : color_conv_clamp255(138.5177312231 * color_conv_ln(temp - 10) - 305.0447927307);
+    return col;
+}
+
+struct color_conv_kelvin_table_t
+{
+    rgb_t col[COLOR_CONV_KELVIN_ENTRIES];
+
+    constexpr color_conv_kelvin_table_t() : col()
+    {
+        for (int n = 0; n < COLOR_CONV_KELVIN_ENTRIES; n++)
+        {
+            col[n] = color_conv_kelvin_entry(COLOR_CONV_KELVIN_MIN + n * COLOR_CONV_KELVIN_STEP);
+        }
+    }
+};
+
+static constexpr color_conv_kelvin_table_t color_conv_kelvin_table;
+
+rgb_t kelvin2rgb_fast(int kelvin)
+{
+    if (kelvin <= COLOR_CONV_KELVIN_MIN)
+    {
+        return color_conv_kelvin_table.col[0];
+    }
+    if (kelvin >= COLOR_CONV_KELVIN_MAX)
+    {
+        return color_conv_kelvin_table.col[COLOR_CONV_KELVIN_ENTRIES - 1];
+    }
+
+    // Blend between the two entries around kelvin, frac in 256ths
+    int offset = kelvin - COLOR_CONV_KELVIN_MIN;
+    int index = offset / COLOR_CONV_KELVIN_STEP;
+    int frac = (offset - index * COLOR_CONV_KELVIN_STEP) * 256 / COLOR_CONV_KELVIN_STEP;
+    const rgb_t a = color_conv_kelvin_table.col[index];
+    const rgb_t b = color_conv_kelvin_table.col[index + 1];
+
+    rgb_t col = {(uint8_t)((a.r * (256 - frac) + b.r * frac + 128) >> 8), (uint8_t)((a.g * (256 - frac) + b.g * frac + 128) >> 8),
+                 (uint8_t)((a.b * (256 - frac) + b.b * frac + 128) >> 8)};
+    return col;
+}
+
 hsv_t rgb2hsv(const rgb_t rgb)
 {
     hsv_t hsv = {0, 0, 0};
 
-    float g = ((float)(rgb.r)) / 255;
-    float r = ((float)(rgb.g)) / 255;
+    float r = ((float)(rgb.r)) / 255;
+    float g = ((float)(rgb.g)) / 255;
     float b = ((float)(rgb.b)) / 255;
 
     float maxc = fmax(r, fmax(g, b));
@@ -177,9 +289,10 @@ hsv_t rgb2hsv(const rgb_t rgb)
     }
     h = (h / 6.0);
 
+    // Hue wraps around, magentas come out just under 1
     if (h < 0)
     {
-        h = h * -1;
+        h = h + 1;
     }
 
     hsv =
@@ -189,6 +302,56 @@ hsv_t rgb2hsv(const rgb_t rgb)
     return hsv;
 }
 
+hsv_t rgb2hsv_fast(const rgb_t rgb)
+{
+    int maxc = rgb.r > rgb.g ? (rgb.r > rgb.b ? rgb.r : rgb.b) : (rgb.g > rgb.b ? rgb.g : rgb.b);
+    int minc = rgb.r < rgb.g ? (rgb.r < rgb.b ? rgb.r : rgb.b) : (rgb.g < rgb.b ? rgb.g : rgb.b);
+    int delta = maxc - minc;
+    if (delta == 0)
+    {
+        return {0, 0, (uint8_t)maxc};
+    }
+
+    // hsv2rgb() gives the smallest channel as v * (255 - s) >> 8, s = 0 would make it a gray
+    int s = 255 - (minc * 256 + maxc / 2) / maxc;
+    if (s < 1)
+    {
+        s = 1;
+    }
+
+    /**
+     * Same six regions of 43 as hsv2rgb(), found by which channel is biggest and which is smallest.
+     * In regions 0, 2 and 4 the middle channel rises from the smallest to v, in 1, 3 and 5 it falls from v
+     */
+    int region;
+    int rise;
+    if (maxc == rgb.r)
+    {
+        region = rgb.g >= rgb.b ? 0 : 5;
+        rise = rgb.g >= rgb.b ? rgb.g - minc : maxc - rgb.b;
+    }
+    else if (maxc == rgb.g)
+    {
+        region = rgb.r >= rgb.b ? 1 : 2;
+        rise = rgb.r >= rgb.b ? maxc - rgb.r : rgb.b - minc;
+    }
+    else
+    {
+        region = rgb.g >= rgb.r ? 3 : 4;
+        rise = rgb.g >= rgb.r ? maxc - rgb.g : rgb.r - minc;
+    }
+    int offset = rise * 43 / delta;
+    int h = region * 43 + (offset > 42 ? 42 : offset);
+
+    // Region 5 is only 41 hues long, past its end goes to whichever of 255 or red is closer
+    if (h > 255)
+    {
+        h = (rgb.b - minc) * 32 < delta ? 0 : 255;
+    }
+
+    return {(uint8_t)h, (uint8_t)s, (uint8_t)maxc};
+}
+
 // Function to convert RGB888 to RGB565
 uint16_t rgb888_to_rgb565(uint8_t red, uint8_t green, uint8_t blue)
 {
@@ -201,4 +364,964 @@ uint16_t rgb888_to_rgb565(uint8_t red, uint8_t green, uint8_t blue)
     uint16_t rgb565 = (r << 11) | (g << 5) | b;
 
     return rgb565;
-}
\ No newline at end of file
+}
+uint8_t rgb_palette_nearest(const rgb_t *palette, int num_colors, rgb_t col)
+{
+    uint8_t best = 0;
+    int best_dist = INT32_MAX;
+    for (int n = 0; n < num_colors; n++)
+    {
+        int dr = palette[n].r - col.r;
+        int dg = palette[n].g - col.g;
+        int db = palette[n].b - col.b;
+        int dist = dr * dr + dg * dg + db * db;
+        if (dist < best_dist)
+        {
+            best_dist = dist;
+            best = (uint8_t)n;
+            // Can't do better than the color itself
+            if (dist == 0)
+            {
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ * Linear light
+ * sRGB to 16 bit linear is a 256 entry table, back is a 4096 entry table on the top 12 bits of linear.
+ * Codes near black are further apart than 16 linear steps, so each one gets its own slot in the second table
+ * and every 8 bit color comes back unchanged
+ */
+#define COLOR_CONV_LINEAR_BITS 12
+
+static constexpr double color_conv_srgb_decode(double c)
+{
+    return c <= 0.04045 ? c / 12.92 : color_conv_exp(2.4 * color_conv_ln((c + 0.055) / 1.055));
+}
+
+static constexpr double color_conv_srgb_encode(double l)
+{
+    return l <= 0.0031308 ? l * 12.92 : 1.055 * color_conv_exp(color_conv_ln(l) / 2.4) - 0.055;
+}
+
+struct color_conv_srgb_table_t
+{
+    uint16_t linear[256];
+    uint8_t srgb[1 << COLOR_CONV_LINEAR_BITS];
+
+    constexpr color_conv_srgb_table_t() : linear(), srgb()
+    {
+        for (int n = 0; n < 256; n++)
+        {
+            linear[n] = (uint16_t)(color_conv_srgb_decode(n / 255.0) * 65535 + 0.5);
+        }
+        for (int n = 0; n < (1 << COLOR_CONV_LINEAR_BITS); n++)
+        {
+            double l = ((n << (16 - COLOR_CONV_LINEAR_BITS)) + (1 << (15 - COLOR_CONV_LINEAR_BITS))) / 65535.0;
+            srgb[n] = (uint8_t)(color_conv_srgb_encode(l) * 255 + 0.5);
+        }
+        for (int n = 0; n < 256; n++)
+        {
+            srgb[linear[n] >> (16 - COLOR_CONV_LINEAR_BITS)] = (uint8_t)n;
+        }
+    }
+};
+
+static constexpr color_conv_srgb_table_t color_conv_srgb_table;
+
+rgb16_t srgb_to_linear(rgb_t col)
+{
+    rgb16_t linear = {color_conv_srgb_table.linear[col.r], color_conv_srgb_table.linear[col.g], color_conv_srgb_table.linear[col.b]};
+    return linear;
+}
+
+rgb_t linear_to_srgb(rgb16_t col)
+{
+    rgb_t srgb = {color_conv_srgb_table.srgb[col.r >> (16 - COLOR_CONV_LINEAR_BITS)],
+                  color_conv_srgb_table.srgb[col.g >> (16 - COLOR_CONV_LINEAR_BITS)],
+                  color_conv_srgb_table.srgb[col.b >> (16 - COLOR_CONV_LINEAR_BITS)]};
+    return srgb;
+}
+
+void srgb_to_linear_n(const rgb_t *in, rgb16_t *out, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        out[i] = srgb_to_linear(in[i]);
+    }
+}
+
+void linear_to_srgb_n(const rgb16_t *in, rgb_t *out, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        out[i] = linear_to_srgb(in[i]);
+    }
+}
+
+/**
+ * OKLab, from linear light through the LMS cone responses and a cube root.
+ * https://bottosson.github.io/posts/oklab/
+ */
+oklab_t rgb2oklab(rgb_t col)
+{
+    rgb16_t linear = srgb_to_linear(col);
+    float r = linear.r / 65535.0f;
+    float g = linear.g / 65535.0f;
+    float b = linear.b / 65535.0f;
+
+    float l = cbrtf(0.4122214708f * r + 0.5363325363f * g + 0.0514459929f * b);
+    float m = cbrtf(0.2119034982f * r + 0.6806995451f * g + 0.1073969566f * b);
+    float s = cbrtf(0.0883024619f * r + 0.2817188376f * g + 0.6299787005f * b);
+
+    oklab_t lab = {0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s,
+                   1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s,
+                   0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s};
+    return lab;
+}
+
+static uint16_t color_conv_linear_clamp(float x)
+{
+    return x <= 0 ? 0 : x >= 1 ? 65535 : (uint16_t)(x * 65535 + 0.5f);
+}
+
+rgb_t oklab2rgb(oklab_t lab)
+{
+    float l = lab.l + 0.3963377774f * lab.a + 0.2158037573f * lab.b;
+    float m = lab.l - 0.1055613458f * lab.a - 0.0638541728f * lab.b;
+    float s = lab.l - 0.0894841775f * lab.a - 1.2914855480f * lab.b;
+    l = l * l * l;
+    m = m * m * m;
+    s = s * s * s;
+
+    // Colors outside sRGB are clipped a channel at a time
+    rgb16_t linear = {color_conv_linear_clamp(4.0767416621f * l - 3.3077115913f * m + 0.2309699292f * s),
+                      color_conv_linear_clamp(-1.2684380046f * l + 2.6097574011f * m - 0.3413193965f * s),
+                      color_conv_linear_clamp(-0.0041960863f * l - 0.7034186147f * m + 1.7076147010f * s)};
+    return linear_to_srgb(linear);
+}
+
+rgb_t rgb_lerp_oklab(rgb_t a, rgb_t b, uint16_t frac)
+{
+    oklab_t from = rgb2oklab(a);
+    oklab_t to = rgb2oklab(b);
+    float t = frac / 65536.0f;
+    oklab_t lab = {from.l + (to.l - from.l) * t, from.a + (to.a - from.a) * t, from.b + (to.b - from.b) * t};
+    return oklab2rgb(lab);
+}
+
+/**
+ * Batch conversions
+ * Every kernel gives exactly what the single pixel functions above give, rgb2hsv_n does the same float math lane by lane.
+ * Pixels are loaded 4 bytes at a time where that's cheaper, so the vector loops stop early enough to never read past
+ * the end of the input, and only ever write the pixels of the block they're on so converting in place is fine
+ */
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define COLOR_CONV_SSE2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define COLOR_CONV_AVX2
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define COLOR_CONV_NEON
+#endif
+
+#if defined(COLOR_CONV_SSE2) || defined(COLOR_CONV_NEON)
+#include "string.h"
+#endif
+
+typedef struct color_conv_kernels
+{
+    const char *name;
+    void (*hsv2rgb_n)(const hsv_t *in, rgb_t *out, uint32_t n);
+    void (*rgb2hsv_n)(const rgb_t *in, hsv_t *out, uint32_t n);
+    void (*rgb565_n)(const rgb_t *in, uint16_t *out, uint32_t n);
+    void (*lerp16_n)(const uint16_t *a, const uint16_t *b, uint16_t *out, uint32_t n, uint16_t frac);
+    void (*convert_row)(const rgb_t *in, uint8_t *out, uint32_t n, color_format_t format, const uint8_t d5[4], const uint8_t d6[4]);
+} color_conv_kernels_t;
+
+static void hsv2rgb_n_scalar(const hsv_t *in, rgb_t *out, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        out[i] = hsv2rgb(in[i]);
+    }
+}
+
+static void rgb2hsv_n_scalar(const rgb_t *in, hsv_t *out, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        out[i] = rgb2hsv(in[i]);
+    }
+}
+
+static void rgb565_n_scalar(const rgb_t *in, uint16_t *out, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        out[i] = rgb888_to_rgb565(in[i].r, in[i].g, in[i].b);
+    }
+}
+
+// a - a * frac + b * frac, each product rounded down on its own so it's the same with a vector unit's high half multiplies
+static void lerp16_n_scalar(const uint16_t *a, const uint16_t *b, uint16_t *out, uint32_t n, uint16_t frac)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        out[i] = (uint16_t)(a[i] - ((a[i] * (uint32_t)frac) >> 16) + ((b[i] * (uint32_t)frac) >> 16));
+    }
+}
+
+static bool color_format_bgr(color_format_t format)
+{
+    return format == COLOR_FORMAT_BGR565_LE || format == COLOR_FORMAT_BGR565_BE || format == COLOR_FORMAT_BGR666;
+}
+
+static bool color_format_666(color_format_t format)
+{
+    return format == COLOR_FORMAT_RGB666 || format == COLOR_FORMAT_BGR666;
+}
+
+static inline uint8_t color_conv_adds(uint8_t c, uint8_t d)
+{
+    return c + d > 255 ? 255 : c + d;
+}
+
+/**
+ * One row into a display format, d5 and d6 are the dither added to 5 and 6 bit channels for pixels 0-3 of every 4,
+ * before the low bits are dropped. All zeroes is plain truncation like rgb888_to_rgb565()
+ */
+static void convert_row_scalar(const rgb_t *in, uint8_t *out, uint32_t n, color_format_t format, const uint8_t d5[4], const uint8_t d6[4])
+{
+    bool bgr = color_format_bgr(format);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint8_t r = bgr ? in[i].b : in[i].r;
+        uint8_t g = in[i].g;
+        uint8_t b = bgr ? in[i].r : in[i].b;
+        if (color_format_666(format))
+        {
+            out[i * 3] = color_conv_adds(r, d6[i & 3]) & 0xFC;
+            out[i * 3 + 1] = color_conv_adds(g, d6[i & 3]) & 0xFC;
+            out[i * 3 + 2] = color_conv_adds(b, d6[i & 3]) & 0xFC;
+            continue;
+        }
+
+        uint16_t px = ((color_conv_adds(r, d5[i & 3]) >> 3) << 11) | ((color_conv_adds(g, d6[i & 3]) >> 2) << 5) |
+                      (color_conv_adds(b, d5[i & 3]) >> 3);
+        if (format == COLOR_FORMAT_RGB565_BE || format == COLOR_FORMAT_BGR565_BE)
+        {
+            out[i * 2] = px >> 8;
+            out[i * 2 + 1] = px & 0xFF;
+        }
+        else
+        {
+            out[i * 2] = px & 0xFF;
+            out[i * 2 + 1] = px >> 8;
+        }
+    }
+}
+
+#ifdef COLOR_CONV_SSE2
+// Four 3 byte pixels into the low 24 bits of each 32 bit lane, reads one byte past the last pixel
+static inline __m128i color_conv_load4_sse2(const uint8_t *p)
+{
+    uint32_t px[4];
+    memcpy(&px[0], p, 4);
+    memcpy(&px[1], p + 3, 4);
+    memcpy(&px[2], p + 6, 4);
+    memcpy(&px[3], p + 9, 4);
+    return _mm_setr_epi32(px[0], px[1], px[2], px[3]);
+}
+
+// Low 24 bits of each 32 bit lane out as four 3 byte pixels, the byte a lane writes past its pixel gets overwritten by the next
+static inline void color_conv_store4_sse2(uint8_t *p, __m128i px)
+{
+    uint32_t word[4];
+    _mm_storeu_si128((__m128i *)word, px);
+    memcpy(p, &word[0], 4);
+    memcpy(p + 3, &word[1], 4);
+    memcpy(p + 6, &word[2], 4);
+    memcpy(p + 9, &word[3], 3);
+}
+
+static inline __m128i color_conv_select_sse2(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline __m128 color_conv_select_ps_sse2(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// hsv2rgb() on 8 pixels in 16 bit lanes, region is h / 43 as h * 191 >> 13 which is exact for h < 256
+static inline void color_conv_hsv2rgb_sse2(__m128i h, __m128i s, __m128i v, __m128i *r, __m128i *g, __m128i *b)
+{
+    const __m128i c255 = _mm_set1_epi16(255);
+    __m128i region = _mm_srli_epi16(_mm_mullo_epi16(h, _mm_set1_epi16(191)), 13);
+    __m128i rem = _mm_mullo_epi16(_mm_sub_epi16(h, _mm_mullo_epi16(region, _mm_set1_epi16(43))), _mm_set1_epi16(6));
+
+    __m128i p = _mm_srli_epi16(_mm_mullo_epi16(v, _mm_sub_epi16(c255, s)), 8);
+    __m128i q = _mm_srli_epi16(_mm_mullo_epi16(v, _mm_sub_epi16(c255, _mm_srli_epi16(_mm_mullo_epi16(s, rem), 8))), 8);
+    __m128i t = _mm_srli_epi16(
+        _mm_mullo_epi16(v, _mm_sub_epi16(c255, _mm_srli_epi16(_mm_mullo_epi16(s, _mm_sub_epi16(c255, rem)), 8))), 8);
+
+    __m128i r0 = _mm_cmpeq_epi16(region, _mm_setzero_si128());
+    __m128i r1 = _mm_cmpeq_epi16(region, _mm_set1_epi16(1));
+    __m128i r2 = _mm_cmpeq_epi16(region, _mm_set1_epi16(2));
+    __m128i r3 = _mm_cmpeq_epi16(region, _mm_set1_epi16(3));
+    __m128i r4 = _mm_cmpeq_epi16(region, _mm_set1_epi16(4));
+    __m128i gray = _mm_cmpeq_epi16(s, _mm_setzero_si128());
+
+    __m128i red = color_conv_select_sse2(
+        r1, q, color_conv_select_sse2(_mm_or_si128(r2, r3), p, color_conv_select_sse2(r4, t, v)));
+    __m128i green = color_conv_select_sse2(
+        r0, t, color_conv_select_sse2(_mm_or_si128(r1, r2), v, color_conv_select_sse2(r3, q, p)));
+    __m128i blue = color_conv_select_sse2(
+        _mm_or_si128(r0, r1), p, color_conv_select_sse2(r2, t, color_conv_select_sse2(_mm_or_si128(r3, r4), v, q)));
+
+    *r = color_conv_select_sse2(gray, v, red);
+    *g = color_conv_select_sse2(gray, v, green);
+    *b = color_conv_select_sse2(gray, v, blue);
+}
+
+// Splits 8 loaded pixels into their three channels, 16 bit lanes
+static inline void color_conv_unpack8_sse2(__m128i lo, __m128i hi, __m128i *c0, __m128i *c1, __m128i *c2)
+{
+    const __m128i ff = _mm_set1_epi32(0xFF);
+    *c0 = _mm_packs_epi32(_mm_and_si128(lo, ff), _mm_and_si128(hi, ff));
+    *c1 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 8), ff), _mm_and_si128(_mm_srli_epi32(hi, 8), ff));
+    *c2 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 16), ff), _mm_and_si128(_mm_srli_epi32(hi, 16), ff));
+}
+
+static void hsv2rgb_n_sse2(const hsv_t *in, rgb_t *out, uint32_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t i = 0;
+    for (; i + 9 <= n; i += 8)
+    {
+        const uint8_t *src = (const uint8_t *)&in[i];
+        __m128i h, s, v, r, g, b;
+        color_conv_unpack8_sse2(color_conv_load4_sse2(src), color_conv_load4_sse2(src + 12), &h, &s, &v);
+        color_conv_hsv2rgb_sse2(h, s, v, &r, &g, &b);
+
+        uint8_t *dst = (uint8_t *)&out[i];
+        color_conv_store4_sse2(dst, _mm_or_si128(_mm_unpacklo_epi16(r, zero),
+                                                 _mm_or_si128(_mm_slli_epi32(_mm_unpacklo_epi16(g, zero), 8),
+                                                              _mm_slli_epi32(_mm_unpacklo_epi16(b, zero), 16))));
+        color_conv_store4_sse2(dst + 12, _mm_or_si128(_mm_unpackhi_epi16(r, zero),
+                                                      _mm_or_si128(_mm_slli_epi32(_mm_unpackhi_epi16(g, zero), 8),
+                                                                   _mm_slli_epi32(_mm_unpackhi_epi16(b, zero), 16))));
+    }
+    hsv2rgb_n_scalar(&in[i], &out[i], n - i);
+}
+
+static void rgb565_n_sse2(const rgb_t *in, uint16_t *out, uint32_t n)
+{
+    uint32_t i = 0;
+    for (; i + 9 <= n; i += 8)
+    {
+        const uint8_t *src = (const uint8_t *)&in[i];
+        __m128i r, g, b;
+        color_conv_unpack8_sse2(color_conv_load4_sse2(src), color_conv_load4_sse2(src + 12), &r, &g, &b);
+        __m128i px = _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(r, 3), 11),
+                                  _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(g, 2), 5), _mm_srli_epi16(b, 3)));
+        _mm_storeu_si128((__m128i *)&out[i], px);
+    }
+    rgb565_n_scalar(&in[i], &out[i], n - i);
+}
+
+/**
+ * rgb2hsv() on 4 pixels as 32 bit lanes.
+ * Hue is worked out in double like the scalar code, which rounds to float between each step
+ */
+static inline __m128i color_conv_rgb2hsv_sse2(__m128i px)
+{
+    const __m128i ff = _mm_set1_epi32(0xFF);
+    const __m128 c255 = _mm_set1_ps(255.0f);
+    __m128 r = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(px, ff)), c255);
+    __m128 g = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 8), ff)), c255);
+    __m128i raw_b = _mm_and_si128(_mm_srli_epi32(px, 16), ff);
+    __m128 b = _mm_div_ps(_mm_cvtepi32_ps(raw_b), c255);
+
+    __m128 maxc = _mm_max_ps(r, _mm_max_ps(g, b));
+    __m128 minc = _mm_min_ps(r, _mm_min_ps(g, b));
+    __m128 delta = _mm_sub_ps(maxc, minc);
+    __m128 s = _mm_div_ps(delta, maxc);
+    __m128 rc = _mm_div_ps(_mm_sub_ps(maxc, r), delta);
+    __m128 gc = _mm_div_ps(_mm_sub_ps(maxc, g), delta);
+    __m128 bc = _mm_div_ps(_mm_sub_ps(maxc, b), delta);
+
+    __m128 r_max = _mm_cmpeq_ps(r, maxc);
+    __m128 g_max = _mm_andnot_ps(r_max, _mm_cmpeq_ps(g, maxc));
+    __m128 base = color_conv_select_ps_sse2(r_max, _mm_setzero_ps(),
+                                            color_conv_select_ps_sse2(g_max, _mm_set1_ps(2.0f), _mm_set1_ps(4.0f)));
+    __m128 x = color_conv_select_ps_sse2(r_max, bc, color_conv_select_ps_sse2(g_max, rc, gc));
+    __m128 y = color_conv_select_ps_sse2(r_max, gc, color_conv_select_ps_sse2(g_max, bc, rc));
+
+    const __m128d six = _mm_set1_pd(6.0);
+    __m128d h_lo = _mm_sub_pd(_mm_add_pd(_mm_cvtps_pd(base), _mm_cvtps_pd(x)), _mm_cvtps_pd(y));
+    __m128d h_hi = _mm_sub_pd(_mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(base, base)), _mm_cvtps_pd(_mm_movehl_ps(x, x))),
+                              _mm_cvtps_pd(_mm_movehl_ps(y, y)));
+    __m128 h = _mm_movelh_ps(_mm_cvtpd_ps(h_lo), _mm_cvtpd_ps(h_hi));
+    h_lo = _mm_div_pd(_mm_cvtps_pd(h), six);
+    h_hi = _mm_div_pd(_mm_cvtps_pd(_mm_movehl_ps(h, h)), six);
+    h = _mm_movelh_ps(_mm_cvtpd_ps(h_lo), _mm_cvtpd_ps(h_hi));
+    h = _mm_add_ps(h, _mm_and_ps(_mm_cmplt_ps(h, _mm_setzero_ps()), _mm_set1_ps(1.0f)));
+
+    __m128i out = _mm_or_si128(_mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(h, c255)), ff),
+                               _mm_or_si128(_mm_slli_epi32(_mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(s, c255)), ff), 8),
+                                            _mm_slli_epi32(_mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(maxc, c255)), ff), 16)));
+    // Grays come out as {0, 0, b}
+    return color_conv_select_sse2(_mm_castps_si128(_mm_cmpeq_ps(minc, maxc)), _mm_slli_epi32(raw_b, 16), out);
+}
+
+static void rgb2hsv_n_sse2(const rgb_t *in, hsv_t *out, uint32_t n)
+{
+    uint32_t i = 0;
+    for (; i + 5 <= n; i += 4)
+    {
+        color_conv_store4_sse2((uint8_t *)&out[i], color_conv_rgb2hsv_sse2(color_conv_load4_sse2((const uint8_t *)&in[i])));
+    }
+    rgb2hsv_n_scalar(&in[i], &out[i], n - i);
+}
+
+static void lerp16_n_sse2(const uint16_t *a, const uint16_t *b, uint16_t *out, uint32_t n, uint16_t frac)
+{
+    const __m128i f = _mm_set1_epi16((short)frac);
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)&a[i]);
+        __m128i y = _mm_loadu_si128((const __m128i *)&b[i]);
+        _mm_storeu_si128((__m128i *)&out[i], _mm_add_epi16(_mm_sub_epi16(x, _mm_mulhi_epu16(x, f)), _mm_mulhi_epu16(y, f)));
+    }
+    lerp16_n_scalar(&a[i], &b[i], &out[i], n - i, frac);
+}
+
+// Eight pixels a go for 565, with the dither repeating every 4 lanes, and four a go for 666 in 32 bit lanes
+static void convert_row_sse2(const rgb_t *in, uint8_t *out, uint32_t n, color_format_t format, const uint8_t d5[4], const uint8_t d6[4])
+{
+    bool bgr = color_format_bgr(format);
+    uint32_t i = 0;
+    if (color_format_666(format))
+    {
+        const __m128i mask = _mm_set1_epi32(0x00FCFCFC);
+        const __m128i dither = _mm_setr_epi32(d6[0] * 0x010101, d6[1] * 0x010101, d6[2] * 0x010101, d6[3] * 0x010101);
+        for (; i + 5 <= n; i += 4)
+        {
+            __m128i px = color_conv_load4_sse2((const uint8_t *)&in[i]);
+            if (bgr)
+            {
+                px = _mm_or_si128(_mm_and_si128(px, _mm_set1_epi32(0xFF00)),
+                                  _mm_or_si128(_mm_slli_epi32(_mm_and_si128(px, _mm_set1_epi32(0xFF)), 16),
+                                               _mm_and_si128(_mm_srli_epi32(px, 16), _mm_set1_epi32(0xFF))));
+            }
+            color_conv_store4_sse2(&out[i * 3], _mm_and_si128(_mm_adds_epu8(px, dither), mask));
+        }
+        convert_row_scalar(&in[i], &out[i * 3], n - i, format, d5, d6);
+        return;
+    }
+
+    const __m128i c255 = _mm_set1_epi16(255);
+    const __m128i dither5 = _mm_setr_epi16(d5[0], d5[1], d5[2], d5[3], d5[0], d5[1], d5[2], d5[3]);
+    const __m128i dither6 = _mm_setr_epi16(d6[0], d6[1], d6[2], d6[3], d6[0], d6[1], d6[2], d6[3]);
+    bool big_endian = format == COLOR_FORMAT_RGB565_BE || format == COLOR_FORMAT_BGR565_BE;
+    for (; i + 9 <= n; i += 8)
+    {
+        const uint8_t *src = (const uint8_t *)&in[i];
+        __m128i r, g, b;
+        color_conv_unpack8_sse2(color_conv_load4_sse2(src), color_conv_load4_sse2(src + 12), bgr ? &b : &r, &g, bgr ? &r : &b);
+        r = _mm_min_epi16(_mm_add_epi16(r, dither5), c255);
+        g = _mm_min_epi16(_mm_add_epi16(g, dither6), c255);
+        b = _mm_min_epi16(_mm_add_epi16(b, dither5), c255);
+        __m128i px = _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(r, 3), 11),
+                                  _mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(g, 2), 5), _mm_srli_epi16(b, 3)));
+        if (big_endian)
+        {
+            px = _mm_or_si128(_mm_slli_epi16(px, 8), _mm_srli_epi16(px, 8));
+        }
+        _mm_storeu_si128((__m128i *)&out[i * 2], px);
+    }
+    convert_row_scalar(&in[i], &out[i * 2], n - i, format, d5, d6);
+}
+
+static const color_conv_kernels_t color_conv_sse2 = {"sse2", hsv2rgb_n_sse2, rgb2hsv_n_sse2, rgb565_n_sse2, lerp16_n_sse2, convert_row_sse2};
+#endif
+
+#ifdef COLOR_CONV_AVX2
+// Built for AVX2 whatever the rest of the file is built for, only called once the cpu says it has it
+#define COLOR_CONV_AVX2_FUNC __attribute__((target("avx2")))
+
+// Eight 3 byte pixels into the low 24 bits of each 32 bit lane, reads 4 bytes past the last pixel
+COLOR_CONV_AVX2_FUNC static inline __m256i color_conv_load8_avx2(const uint8_t *p)
+{
+    const __m256i spread =
+        _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m256i raw = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+                                          _mm_loadu_si128((const __m128i *)(p + 12)), 1);
+    return _mm256_shuffle_epi8(raw, spread);
+}
+
+// Low 24 bits of each 32 bit lane out as eight 3 byte pixels
+COLOR_CONV_AVX2_FUNC static inline void color_conv_store8_avx2(uint8_t *p, __m256i px)
+{
+    const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, 0, 1, 2, 4, 5, 6, 8, 9, 10, 12,
+                                          13, 14, -1, -1, -1, -1);
+    px = _mm256_shuffle_epi8(px, pack);
+    __m128i lo = _mm256_castsi256_si128(px);
+    __m128i hi = _mm256_extracti128_si256(px, 1);
+    uint32_t tail;
+    _mm_storel_epi64((__m128i *)p, lo);
+    tail = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(lo, 8));
+    memcpy(p + 8, &tail, 4);
+    _mm_storel_epi64((__m128i *)(p + 12), hi);
+    tail = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(hi, 8));
+    memcpy(p + 20, &tail, 4);
+}
+
+COLOR_CONV_AVX2_FUNC static inline __m256i color_conv_select_avx2(__m256i mask, __m256i a, __m256i b)
+{
+    return _mm256_blendv_epi8(b, a, mask);
+}
+
+// Same as color_conv_hsv2rgb_sse2() on 16 pixels
+COLOR_CONV_AVX2_FUNC static inline void color_conv_hsv2rgb_avx2(__m256i h, __m256i s, __m256i v, __m256i *r, __m256i *g, __m256i *b)
+{
+    const __m256i c255 = _mm256_set1_epi16(255);
+    __m256i region = _mm256_srli_epi16(_mm256_mullo_epi16(h, _mm256_set1_epi16(191)), 13);
+    __m256i rem = _mm256_mullo_epi16(_mm256_sub_epi16(h, _mm256_mullo_epi16(region, _mm256_set1_epi16(43))), _mm256_set1_epi16(6));
+
+    __m256i p = _mm256_srli_epi16(_mm256_mullo_epi16(v, _mm256_sub_epi16(c255, s)), 8);
+    __m256i q =
+        _mm256_srli_epi16(_mm256_mullo_epi16(v, _mm256_sub_epi16(c255, _mm256_srli_epi16(_mm256_mullo_epi16(s, rem), 8))), 8);
+    __m256i t = _mm256_srli_epi16(
+        _mm256_mullo_epi16(v, _mm256_sub_epi16(c255, _mm256_srli_epi16(_mm256_mullo_epi16(s, _mm256_sub_epi16(c255, rem)), 8))),
+        8);
+
+    __m256i r0 = _mm256_cmpeq_epi16(region, _mm256_setzero_si256());
+    __m256i r1 = _mm256_cmpeq_epi16(region, _mm256_set1_epi16(1));
+    __m256i r2 = _mm256_cmpeq_epi16(region, _mm256_set1_epi16(2));
+    __m256i r3 = _mm256_cmpeq_epi16(region, _mm256_set1_epi16(3));
+    __m256i r4 = _mm256_cmpeq_epi16(region, _mm256_set1_epi16(4));
+    __m256i gray = _mm256_cmpeq_epi16(s, _mm256_setzero_si256());
+
+    __m256i red = color_conv_select_avx2(
+        r1, q, color_conv_select_avx2(_mm256_or_si256(r2, r3), p, color_conv_select_avx2(r4, t, v)));
+    __m256i green = color_conv_select_avx2(
+        r0, t, color_conv_select_avx2(_mm256_or_si256(r1, r2), v, color_conv_select_avx2(r3, q, p)));
+    __m256i blue = color_conv_select_avx2(
+        _mm256_or_si256(r0, r1), p, color_conv_select_avx2(r2, t, color_conv_select_avx2(_mm256_or_si256(r3, r4), v, q)));
+
+    *r = color_conv_select_avx2(gray, v, red);
+    *g = color_conv_select_avx2(gray, v, green);
+    *b = color_conv_select_avx2(gray, v, blue);
+}
+
+// Splits 16 loaded pixels into their three channels, 16 bit lanes in the lane order _mm256_packs_epi32() leaves them
+COLOR_CONV_AVX2_FUNC static inline void color_conv_unpack16_avx2(__m256i lo, __m256i hi, __m256i *c0, __m256i *c1, __m256i *c2)
+{
+    const __m256i ff = _mm256_set1_epi32(0xFF);
+    *c0 = _mm256_packs_epi32(_mm256_and_si256(lo, ff), _mm256_and_si256(hi, ff));
+    *c1 = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(lo, 8), ff), _mm256_and_si256(_mm256_srli_epi32(hi, 8), ff));
+    *c2 = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(lo, 16), ff), _mm256_and_si256(_mm256_srli_epi32(hi, 16), ff));
+}
+
+COLOR_CONV_AVX2_FUNC static void hsv2rgb_n_avx2(const hsv_t *in, rgb_t *out, uint32_t n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    uint32_t i = 0;
+    for (; i + 18 <= n; i += 16)
+    {
+        const uint8_t *src = (const uint8_t *)&in[i];
+        __m256i h, s, v, r, g, b;
+        color_conv_unpack16_avx2(color_conv_load8_avx2(src), color_conv_load8_avx2(src + 24), &h, &s, &v);
+        color_conv_hsv2rgb_avx2(h, s, v, &r, &g, &b);
+
+        // Unpacking within each 128 bit lane undoes the pack, first 8 pixels in the low words
+        uint8_t *dst = (uint8_t *)&out[i];
+        color_conv_store8_avx2(
+            dst, _mm256_or_si256(_mm256_unpacklo_epi16(r, zero), _mm256_or_si256(_mm256_slli_epi32(_mm256_unpacklo_epi16(g, zero), 8),
+                                                                                  _mm256_slli_epi32(_mm256_unpacklo_epi16(b, zero), 16))));
+        color_conv_store8_avx2(dst + 24, _mm256_or_si256(_mm256_unpackhi_epi16(r, zero),
+                                                         _mm256_or_si256(_mm256_slli_epi32(_mm256_unpackhi_epi16(g, zero), 8),
+                                                                         _mm256_slli_epi32(_mm256_unpackhi_epi16(b, zero), 16))));
+    }
+    hsv2rgb_n_sse2(&in[i], &out[i], n - i);
+}
+
+COLOR_CONV_AVX2_FUNC static void rgb565_n_avx2(const rgb_t *in, uint16_t *out, uint32_t n)
+{
+    uint32_t i = 0;
+    for (; i + 18 <= n; i += 16)
+    {
+        const uint8_t *src = (const uint8_t *)&in[i];
+        __m256i r, g, b;
+        color_conv_unpack16_avx2(color_conv_load8_avx2(src), color_conv_load8_avx2(src + 24), &r, &g, &b);
+        __m256i px = _mm256_or_si256(_mm256_slli_epi16(_mm256_srli_epi16(r, 3), 11),
+                                     _mm256_or_si256(_mm256_slli_epi16(_mm256_srli_epi16(g, 2), 5), _mm256_srli_epi16(b, 3)));
+        // Pixels 0-3, 8-11, 4-7, 12-15 back in order
+        _mm256_storeu_si256((__m256i *)&out[i], _mm256_permute4x64_epi64(px, 0xD8));
+    }
+    rgb565_n_sse2(&in[i], &out[i], n - i);
+}
+
+// Same as color_conv_rgb2hsv_sse2() on 8 pixels
+COLOR_CONV_AVX2_FUNC static inline __m256i color_conv_rgb2hsv_avx2(__m256i px)
+{
+    const __m256i ff = _mm256_set1_epi32(0xFF);
+    const __m256 c255 = _mm256_set1_ps(255.0f);
+    __m256 r = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_and_si256(px, ff)), c255);
+    __m256 g = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 8), ff)), c255);
+    __m256i raw_b = _mm256_and_si256(_mm256_srli_epi32(px, 16), ff);
+    __m256 b = _mm256_div_ps(_mm256_cvtepi32_ps(raw_b), c255);
+
+    __m256 maxc = _mm256_max_ps(r, _mm256_max_ps(g, b));
+    __m256 minc = _mm256_min_ps(r, _mm256_min_ps(g, b));
+    __m256 delta = _mm256_sub_ps(maxc, minc);
+    __m256 s = _mm256_div_ps(delta, maxc);
+    __m256 rc = _mm256_div_ps(_mm256_sub_ps(maxc, r), delta);
+    __m256 gc = _mm256_div_ps(_mm256_sub_ps(maxc, g), delta);
+    __m256 bc = _mm256_div_ps(_mm256_sub_ps(maxc, b), delta);
+
+    __m256 r_max = _mm256_cmp_ps(r, maxc, _CMP_EQ_OQ);
+    __m256 g_max = _mm256_andnot_ps(r_max, _mm256_cmp_ps(g, maxc, _CMP_EQ_OQ));
+    __m256 base = _mm256_blendv_ps(_mm256_blendv_ps(_mm256_set1_ps(4.0f), _mm256_set1_ps(2.0f), g_max), _mm256_setzero_ps(), r_max);
+    __m256 x = _mm256_blendv_ps(_mm256_blendv_ps(gc, rc, g_max), bc, r_max);
+    __m256 y = _mm256_blendv_ps(_mm256_blendv_ps(rc, bc, g_max), gc, r_max);
+
+    const __m256d six = _mm256_set1_pd(6.0);
+    __m256d h_lo = _mm256_sub_pd(_mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(base)), _mm256_cvtps_pd(_mm256_castps256_ps128(x))),
+                                 _mm256_cvtps_pd(_mm256_castps256_ps128(y)));
+    __m256d h_hi = _mm256_sub_pd(
+        _mm256_add_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(base, 1)), _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1))),
+        _mm256_cvtps_pd(_mm256_extractf128_ps(y, 1)));
+    __m128 h_lo_f = _mm256_cvtpd_ps(_mm256_div_pd(_mm256_cvtps_pd(_mm256_cvtpd_ps(h_lo)), six));
+    __m128 h_hi_f = _mm256_cvtpd_ps(_mm256_div_pd(_mm256_cvtps_pd(_mm256_cvtpd_ps(h_hi)), six));
+    __m256 h = _mm256_insertf128_ps(_mm256_castps128_ps256(h_lo_f), h_hi_f, 1);
+    h = _mm256_add_ps(h, _mm256_and_ps(_mm256_cmp_ps(h, _mm256_setzero_ps(), _CMP_LT_OQ), _mm256_set1_ps(1.0f)));
+
+    __m256i out = _mm256_or_si256(
+        _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(h, c255)), ff),
+        _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(s, c255)), ff), 8),
+                        _mm256_slli_epi32(_mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(maxc, c255)), ff), 16)));
+    return color_conv_select_avx2(_mm256_castps_si256(_mm256_cmp_ps(minc, maxc, _CMP_EQ_OQ)), _mm256_slli_epi32(raw_b, 16), out);
+}
+
+COLOR_CONV_AVX2_FUNC static void rgb2hsv_n_avx2(const rgb_t *in, hsv_t *out, uint32_t n)
+{
+    uint32_t i = 0;
+    for (; i + 10 <= n; i += 8)
+    {
+        color_conv_store8_avx2((uint8_t *)&out[i], color_conv_rgb2hsv_avx2(color_conv_load8_avx2((const uint8_t *)&in[i])));
+    }
+    rgb2hsv_n_sse2(&in[i], &out[i], n - i);
+}
+
+COLOR_CONV_AVX2_FUNC static void lerp16_n_avx2(const uint16_t *a, const uint16_t *b, uint16_t *out, uint32_t n, uint16_t frac)
+{
+    const __m256i f = _mm256_set1_epi16((short)frac);
+    uint32_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)&a[i]);
+        __m256i y = _mm256_loadu_si256((const __m256i *)&b[i]);
+        _mm256_storeu_si256((__m256i *)&out[i],
+                            _mm256_add_epi16(_mm256_sub_epi16(x, _mm256_mulhi_epu16(x, f)), _mm256_mulhi_epu16(y, f)));
+    }
+    lerp16_n_sse2(&a[i], &b[i], &out[i], n - i, frac);
+}
+
+// Rows of a display are short enough that the SSE2 row conversion keeps up
+static const color_conv_kernels_t color_conv_avx2 = {"avx2", hsv2rgb_n_avx2, rgb2hsv_n_avx2, rgb565_n_avx2, lerp16_n_avx2, convert_row_sse2};
+#endif
+
+#ifdef COLOR_CONV_NEON
+// Same as color_conv_hsv2rgb_sse2() on 8 pixels
+static inline void color_conv_hsv2rgb_neon(uint16x8_t h, uint16x8_t s, uint16x8_t v, uint16x8_t *r, uint16x8_t *g, uint16x8_t *b)
+{
+    const uint16x8_t c255 = vdupq_n_u16(255);
+    uint16x8_t region = vshrq_n_u16(vmulq_n_u16(h, 191), 13);
+    uint16x8_t rem = vmulq_n_u16(vsubq_u16(h, vmulq_n_u16(region, 43)), 6);
+
+    uint16x8_t p = vshrq_n_u16(vmulq_u16(v, vsubq_u16(c255, s)), 8);
+    uint16x8_t q = vshrq_n_u16(vmulq_u16(v, vsubq_u16(c255, vshrq_n_u16(vmulq_u16(s, rem), 8))), 8);
+    uint16x8_t t = vshrq_n_u16(vmulq_u16(v, vsubq_u16(c255, vshrq_n_u16(vmulq_u16(s, vsubq_u16(c255, rem)), 8))), 8);
+
+    uint16x8_t r0 = vceqq_u16(region, vdupq_n_u16(0));
+    uint16x8_t r1 = vceqq_u16(region, vdupq_n_u16(1));
+    uint16x8_t r2 = vceqq_u16(region, vdupq_n_u16(2));
+    uint16x8_t r3 = vceqq_u16(region, vdupq_n_u16(3));
+    uint16x8_t r4 = vceqq_u16(region, vdupq_n_u16(4));
+    uint16x8_t gray = vceqq_u16(s, vdupq_n_u16(0));
+
+    uint16x8_t red = vbslq_u16(r1, q, vbslq_u16(vorrq_u16(r2, r3), p, vbslq_u16(r4, t, v)));
+    uint16x8_t green = vbslq_u16(r0, t, vbslq_u16(vorrq_u16(r1, r2), v, vbslq_u16(r3, q, p)));
+    uint16x8_t blue = vbslq_u16(vorrq_u16(r0, r1), p, vbslq_u16(r2, t, vbslq_u16(vorrq_u16(r3, r4), v, q)));
+
+    *r = vbslq_u16(gray, v, red);
+    *g = vbslq_u16(gray, v, green);
+    *b = vbslq_u16(gray, v, blue);
+}
+
+static void hsv2rgb_n_neon(const hsv_t *in, rgb_t *out, uint32_t n)
+{
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint8x8x3_t hsv = vld3_u8((const uint8_t *)&in[i]);
+        uint16x8_t r, g, b;
+        color_conv_hsv2rgb_neon(vmovl_u8(hsv.val[0]), vmovl_u8(hsv.val[1]), vmovl_u8(hsv.val[2]), &r, &g, &b);
+        uint8x8x3_t rgb;
+        rgb.val[0] = vmovn_u16(r);
+        rgb.val[1] = vmovn_u16(g);
+        rgb.val[2] = vmovn_u16(b);
+        vst3_u8((uint8_t *)&out[i], rgb);
+    }
+    hsv2rgb_n_scalar(&in[i], &out[i], n - i);
+}
+
+static void rgb565_n_neon(const rgb_t *in, uint16_t *out, uint32_t n)
+{
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint8x8x3_t rgb = vld3_u8((const uint8_t *)&in[i]);
+        uint16x8_t px = vshlq_n_u16(vmovl_u8(vshr_n_u8(rgb.val[0], 3)), 11);
+        px = vorrq_u16(px, vshlq_n_u16(vmovl_u8(vshr_n_u8(rgb.val[1], 2)), 5));
+        px = vorrq_u16(px, vmovl_u8(vshr_n_u8(rgb.val[2], 3)));
+        vst1q_u16(&out[i], px);
+    }
+    rgb565_n_scalar(&in[i], &out[i], n - i);
+}
+
+// Same as color_conv_rgb2hsv_sse2() on 4 pixels, one channel a register
+static inline void color_conv_rgb2hsv_neon(uint32x4_t c0, uint32x4_t c1, uint32x4_t c2, uint32x4_t *h, uint32x4_t *s, uint32x4_t *v)
+{
+    const float32x4_t c255 = vdupq_n_f32(255.0f);
+    float32x4_t r = vdivq_f32(vcvtq_f32_u32(c0), c255);
+    float32x4_t g = vdivq_f32(vcvtq_f32_u32(c1), c255);
+    float32x4_t b = vdivq_f32(vcvtq_f32_u32(c2), c255);
+
+    float32x4_t maxc = vmaxq_f32(r, vmaxq_f32(g, b));
+    float32x4_t minc = vminq_f32(r, vminq_f32(g, b));
+    float32x4_t delta = vsubq_f32(maxc, minc);
+    float32x4_t sat = vdivq_f32(delta, maxc);
+    float32x4_t rc = vdivq_f32(vsubq_f32(maxc, r), delta);
+    float32x4_t gc = vdivq_f32(vsubq_f32(maxc, g), delta);
+    float32x4_t bc = vdivq_f32(vsubq_f32(maxc, b), delta);
+
+    uint32x4_t r_max = vceqq_f32(r, maxc);
+    uint32x4_t g_max = vbicq_u32(vceqq_f32(g, maxc), r_max);
+    float32x4_t base = vbslq_f32(r_max, vdupq_n_f32(0.0f), vbslq_f32(g_max, vdupq_n_f32(2.0f), vdupq_n_f32(4.0f)));
+    float32x4_t x = vbslq_f32(r_max, bc, vbslq_f32(g_max, rc, gc));
+    float32x4_t y = vbslq_f32(r_max, gc, vbslq_f32(g_max, bc, rc));
+
+    const float64x2_t six = vdupq_n_f64(6.0);
+    float64x2_t h_lo = vsubq_f64(vaddq_f64(vcvt_f64_f32(vget_low_f32(base)), vcvt_f64_f32(vget_low_f32(x))),
+                                 vcvt_f64_f32(vget_low_f32(y)));
+    float64x2_t h_hi = vsubq_f64(vaddq_f64(vcvt_high_f64_f32(base), vcvt_high_f64_f32(x)), vcvt_high_f64_f32(y));
+    float32x4_t hue = vcvt_high_f32_f64(vcvt_f32_f64(h_lo), h_hi);
+    h_lo = vdivq_f64(vcvt_f64_f32(vget_low_f32(hue)), six);
+    h_hi = vdivq_f64(vcvt_high_f64_f32(hue), six);
+    hue = vcvt_high_f32_f64(vcvt_f32_f64(h_lo), h_hi);
+    hue = vaddq_f32(hue, vreinterpretq_f32_u32(vandq_u32(vcltq_f32(hue, vdupq_n_f32(0.0f)), vreinterpretq_u32_f32(vdupq_n_f32(1.0f)))));
+
+    // Grays come out as {0, 0, b}
+    uint32x4_t gray = vceqq_f32(minc, maxc);
+    *h = vbicq_u32(vcvtq_u32_f32(vmulq_f32(hue, c255)), gray);
+    *s = vbicq_u32(vcvtq_u32_f32(vmulq_f32(sat, c255)), gray);
+    *v = vbslq_u32(gray, c2, vcvtq_u32_f32(vmulq_f32(maxc, c255)));
+}
+
+static void rgb2hsv_n_neon(const rgb_t *in, hsv_t *out, uint32_t n)
+{
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint8x8x3_t rgb = vld3_u8((const uint8_t *)&in[i]);
+        uint16x8_t c0 = vmovl_u8(rgb.val[0]);
+        uint16x8_t c1 = vmovl_u8(rgb.val[1]);
+        uint16x8_t c2 = vmovl_u8(rgb.val[2]);
+        uint32x4_t h_lo, s_lo, v_lo, h_hi, s_hi, v_hi;
+        color_conv_rgb2hsv_neon(vmovl_u16(vget_low_u16(c0)), vmovl_u16(vget_low_u16(c1)), vmovl_u16(vget_low_u16(c2)), &h_lo, &s_lo,
+                                &v_lo);
+        color_conv_rgb2hsv_neon(vmovl_high_u16(c0), vmovl_high_u16(c1), vmovl_high_u16(c2), &h_hi, &s_hi, &v_hi);
+
+        uint8x8x3_t hsv;
+        hsv.val[0] = vmovn_u16(vcombine_u16(vmovn_u32(h_lo), vmovn_u32(h_hi)));
+        hsv.val[1] = vmovn_u16(vcombine_u16(vmovn_u32(s_lo), vmovn_u32(s_hi)));
+        hsv.val[2] = vmovn_u16(vcombine_u16(vmovn_u32(v_lo), vmovn_u32(v_hi)));
+        vst3_u8((uint8_t *)&out[i], hsv);
+    }
+    rgb2hsv_n_scalar(&in[i], &out[i], n - i);
+}
+
+// High half of x * frac, there's no 16 bit high half multiply so it goes through 32 bits
+static inline uint16x8_t color_conv_mulhi_neon(uint16x8_t x, uint16_t frac)
+{
+    return vcombine_u16(vshrn_n_u32(vmull_n_u16(vget_low_u16(x), frac), 16), vshrn_n_u32(vmull_n_u16(vget_high_u16(x), frac), 16));
+}
+
+static void lerp16_n_neon(const uint16_t *a, const uint16_t *b, uint16_t *out, uint32_t n, uint16_t frac)
+{
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint16x8_t x = vld1q_u16(&a[i]);
+        uint16x8_t y = vld1q_u16(&b[i]);
+        vst1q_u16(&out[i], vaddq_u16(vsubq_u16(x, color_conv_mulhi_neon(x, frac)), color_conv_mulhi_neon(y, frac)));
+    }
+    lerp16_n_scalar(&a[i], &b[i], &out[i], n - i, frac);
+}
+
+static void convert_row_neon(const rgb_t *in, uint8_t *out, uint32_t n, color_format_t format, const uint8_t d5[4], const uint8_t d6[4])
+{
+    bool bgr = color_format_bgr(format);
+    bool big_endian = format == COLOR_FORMAT_RGB565_BE || format == COLOR_FORMAT_BGR565_BE;
+    const uint8_t pattern5[8] = {d5[0], d5[1], d5[2], d5[3], d5[0], d5[1], d5[2], d5[3]};
+    const uint8_t pattern6[8] = {d6[0], d6[1], d6[2], d6[3], d6[0], d6[1], d6[2], d6[3]};
+    const uint8x8_t dither5 = vld1_u8(pattern5);
+    const uint8x8_t dither6 = vld1_u8(pattern6);
+    uint32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint8x8x3_t px = vld3_u8((const uint8_t *)&in[i]);
+        uint8x8_t r = bgr ? px.val[2] : px.val[0];
+        uint8x8_t b = bgr ? px.val[0] : px.val[2];
+        if (color_format_666(format))
+        {
+            const uint8x8_t mask = vdup_n_u8(0xFC);
+            px.val[0] = vand_u8(vqadd_u8(r, dither6), mask);
+            px.val[1] = vand_u8(vqadd_u8(px.val[1], dither6), mask);
+            px.val[2] = vand_u8(vqadd_u8(b, dither6), mask);
+            vst3_u8(&out[i * 3], px);
+            continue;
+        }
+
+        uint16x8_t rgb565 = vshlq_n_u16(vmovl_u8(vshr_n_u8(vqadd_u8(r, dither5), 3)), 11);
+        rgb565 = vorrq_u16(rgb565, vshlq_n_u16(vmovl_u8(vshr_n_u8(vqadd_u8(px.val[1], dither6), 2)), 5));
+        rgb565 = vorrq_u16(rgb565, vmovl_u8(vshr_n_u8(vqadd_u8(b, dither5), 3)));
+        uint8x16_t bytes = vreinterpretq_u8_u16(rgb565);
+        vst1q_u8(&out[i * 2], big_endian ? vrev16q_u8(bytes) : bytes);
+    }
+    convert_row_scalar(&in[i], &out[i * (color_format_666(format) ? 3 : 2)], n - i, format, d5, d6);
+}
+
+static const color_conv_kernels_t color_conv_neon = {"neon", hsv2rgb_n_neon, rgb2hsv_n_neon, rgb565_n_neon, lerp16_n_neon, convert_row_neon};
+#endif
+
+static const color_conv_kernels_t color_conv_scalar = {"scalar", hsv2rgb_n_scalar, rgb2hsv_n_scalar, rgb565_n_scalar, lerp16_n_scalar,
+                                                       convert_row_scalar};
+
+// Picks the widest kernels the cpu we're running on has, once
+static const color_conv_kernels_t *color_conv_detect(void)
+{
+#ifdef COLOR_CONV_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return &color_conv_avx2;
+    }
+#endif
+#if defined(COLOR_CONV_SSE2)
+    return &color_conv_sse2;
+#elif defined(COLOR_CONV_NEON)
+    return &color_conv_neon;
+#else
+    return &color_conv_scalar;
+#endif
+}
+
+static const color_conv_kernels_t *color_conv_kernels(void)
+{
+    static const color_conv_kernels_t *kernels = color_conv_detect();
+    return kernels;
+}
+
+void hsv2rgb_n(const hsv_t *in, rgb_t *out, uint32_t n)
+{
+    color_conv_kernels()->hsv2rgb_n(in, out, n);
+}
+
+void rgb2hsv_n(const rgb_t *in, hsv_t *out, uint32_t n)
+{
+    color_conv_kernels()->rgb2hsv_n(in, out, n);
+}
+
+void rgb888_to_rgb565_n(const rgb_t *in, uint16_t *out, uint32_t n)
+{
+    color_conv_kernels()->rgb565_n(in, out, n);
+}
+
+void rgb16_lerp_n(const rgb16_t *a, const rgb16_t *b, rgb16_t *out, uint32_t n, uint16_t frac)
+{
+    color_conv_kernels()->lerp16_n((const uint16_t *)a, (const uint16_t *)b, (uint16_t *)out, n * 3, frac);
+}
+
+void rgb_lerp_linear_n(const rgb_t *a, const rgb_t *b, rgb_t *out, uint32_t n, uint16_t frac)
+{
+    // A chunk at a time through 16 bit linear light
+    rgb16_t from[64];
+    rgb16_t to[64];
+    const color_conv_kernels_t *kernels = color_conv_kernels();
+    for (uint32_t done = 0; done < n;)
+    {
+        uint32_t len = n - done < 64 ? n - done : 64;
+        srgb_to_linear_n(&a[done], from, len);
+        srgb_to_linear_n(&b[done], to, len);
+        kernels->lerp16_n((const uint16_t *)from, (const uint16_t *)to, (uint16_t *)from, len * 3, frac);
+        linear_to_srgb_n(from, &out[done], len);
+        done += len;
+    }
+}
+
+uint32_t color_format_bytes(color_format_t format)
+{
+    return color_format_666(format) ? 3 : 2;
+}
+
+// 4x4 ordered dither thresholds, 0-15
+static const uint8_t color_conv_bayer[4][4] = {
+    {0, 8, 2, 10},
+    {12, 4, 14, 6},
+    {3, 11, 1, 9},
+    {15, 7, 13, 5},
+};
+
+void rgb_convert_row(const rgb_t *in, uint8_t *out, uint32_t n, color_format_t format, bool dither, uint32_t x, uint32_t y)
+{
+    // Thresholds lined up with the first pixel, scaled to the bits each channel drops
+    uint8_t d5[4] = {0, 0, 0, 0};
+    uint8_t d6[4] = {0, 0, 0, 0};
+    if (dither)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            d5[k] = color_conv_bayer[y & 3][(x + k) & 3] >> 1;
+            d6[k] = color_conv_bayer[y & 3][(x + k) & 3] >> 2;
+        }
+    }
+    color_conv_kernels()->convert_row(in, out, n, format, d5, d6);
+}
+
+void rgb_convert_frame(const rgb_t *in, uint8_t *out, uint32_t width, uint32_t height, color_format_t format, bool dither)
+{
+    uint32_t stride = width * color_format_bytes(format);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        rgb_convert_row(&in[y * width], &out[y * stride], width, format, dither, 0, y);
+    }
+}
+
+const char *color_conv_kernel_name(void)
+{
+    return color_conv_kernels()->name;
+}
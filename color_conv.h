@@ -12,6 +12,16 @@ typedef struct
     uint8_t b; /**< Blue component value. */
 } rgb_t;
 
+/**
+ * @brief Structure representing an RGB color with 16 bits a channel.
+ */
+typedef struct
+{
+    uint16_t r; /**< Red component value. */
+    uint16_t g; /**< Green component value. */
+    uint16_t b; /**< Blue component value. */
+} rgb16_t;
+
 /**
  * @brief Structure representing an HSV color.
  */
@@ -22,6 +32,29 @@ typedef struct
     uint8_t v; /**< Value (brightness) component value. */
 } hsv_t;
 
+/**
+ * @brief Structure representing an OKLab color, lightness and two opponent color axes.
+ */
+typedef struct
+{
+    float l; /**< Lightness, 0 to 1. */
+    float a; /**< Green(-) to red(+), about -0.25 to 0.3 for sRGB colors. */
+    float b; /**< Blue(-) to yellow(+), about -0.3 to 0.2 for sRGB colors. */
+} oklab_t;
+
+/**
+ * @brief Pixel formats display panels take over SPI, for rgb_convert_row().
+ */
+typedef enum color_format
+{
+    COLOR_FORMAT_RGB565_LE, /**< 2 bytes, red in the top 5 bits, low byte first. */
+    COLOR_FORMAT_RGB565_BE, /**< 2 bytes, red in the top 5 bits, high byte first, what most SPI panels want. */
+    COLOR_FORMAT_BGR565_LE, /**< 2 bytes, blue in the top 5 bits, low byte first. */
+    COLOR_FORMAT_BGR565_BE, /**< 2 bytes, blue in the top 5 bits, high byte first. */
+    COLOR_FORMAT_RGB666,    /**< 3 bytes, red green blue, 6 bits each in the top of the byte. */
+    COLOR_FORMAT_BGR666,    /**< 3 bytes, blue green red, 6 bits each in the top of the byte. */
+} color_format_t;
+
 /**
  * @brief Converts an HSV color to an RGB color.
  *
@@ -38,6 +71,18 @@ rgb_t hsv2rgb(hsv_t hsv);
  */
 rgb_t kelvin2rgb(int kelvin);
 
+/**
+ * @brief Converts a Kelvin color temperature to an RGB color without any floating point.
+ *
+ * Blends between kelvin2rgb() values built into a table every 100K, for fading white balance across a lot of pixels.
+ * Temperatures outside 1000K-40000K get the closest end of the table.
+ *
+ * @param kelvin The Kelvin color temperature.
+ * @return The RGB color converted from the Kelvin temperature, within a count of kelvin2rgb() except for up to 4 between
+ * 6500K and 6700K where its curves meet.
+ */
+rgb_t kelvin2rgb_fast(int kelvin);
+
 /**
  * @brief Convert RGB color to HSV color space.
  *
@@ -46,6 +91,18 @@ rgb_t kelvin2rgb(int kelvin);
  */
 hsv_t rgb2hsv(const rgb_t rgb);
 
+/**
+ * @brief Convert RGB color to HSV color space with integer math only.
+ *
+ * Inverse of hsv2rgb(), hue is on its scale of six regions of 43 rather than rgb2hsv()'s 0-255 for the full circle.
+ * 8 bit HSV can't hold every RGB color, so hsv2rgb(rgb2hsv_fast(rgb)) isn't exact: each channel comes back at most
+ * 8 counts off(about 1 on average), and at most 5 off for colors that came out of hsv2rgb() in the first place.
+ *
+ * @param rgb RGB color values.
+ * @return Corresponding HSV color values.
+ */
+hsv_t rgb2hsv_fast(const rgb_t rgb);
+
 /**
  * @brief Converts an RGB888 color to RGB565 format.
  *
@@ -64,4 +121,176 @@ hsv_t rgb2hsv(const rgb_t rgb);
  */
 uint16_t rgb888_to_rgb565(uint8_t red, uint8_t green, uint8_t blue);
 
+/**
+ * @brief Converts an array of HSV colors to RGB, the same as hsv2rgb() on each.
+ *
+ * Uses the widest vector unit the cpu has(AVX2, SSE2 or NEON), in and out can be the same buffer.
+ *
+ * @param in The HSV colors to convert.
+ * @param out Where the RGB colors go.
+ * @param n Number of colors.
+ */
+void hsv2rgb_n(const hsv_t *in, rgb_t *out, uint32_t n);
+
+/**
+ * @brief Converts an array of RGB colors to HSV, the same as rgb2hsv() on each.
+ *
+ * @param in The RGB colors to convert.
+ * @param out Where the HSV colors go, can be the same buffer as in.
+ * @param n Number of colors.
+ */
+void rgb2hsv_n(const rgb_t *in, hsv_t *out, uint32_t n);
+
+/**
+ * @brief Converts an array of RGB888 colors to RGB565, the same as rgb888_to_rgb565() on each.
+ *
+ * @param in The RGB colors to convert.
+ * @param out Where the RGB565 colors go.
+ * @param n Number of colors.
+ */
+void rgb888_to_rgb565_n(const rgb_t *in, uint16_t *out, uint32_t n);
+
+/**
+ * @brief Converts an sRGB color to linear light, 16 bits a channel, from a table.
+ *
+ * @param col The sRGB color to convert.
+ * @return The color in linear light, 0-65535.
+ */
+rgb16_t srgb_to_linear(rgb_t col);
+
+/**
+ * @brief Converts a linear light color back to sRGB, from a table on the top 12 bits of each channel.
+ *
+ * linear_to_srgb(srgb_to_linear(col)) is always col.
+ *
+ * @param col The linear light color to convert.
+ * @return The sRGB color.
+ */
+rgb_t linear_to_srgb(rgb16_t col);
+
+/**
+ * @brief srgb_to_linear() on an array of colors.
+ *
+ * @param in The sRGB colors to convert.
+ * @param out Where the linear colors go.
+ * @param n Number of colors.
+ */
+void srgb_to_linear_n(const rgb_t *in, rgb16_t *out, uint32_t n);
+
+/**
+ * @brief linear_to_srgb() on an array of colors.
+ *
+ * @param in The linear colors to convert.
+ * @param out Where the sRGB colors go.
+ * @param n Number of colors.
+ */
+void linear_to_srgb_n(const rgb16_t *in, rgb_t *out, uint32_t n);
+
+/**
+ * @brief Blends two arrays of 16 bit colors, a + (b - a) * frac / 65536 on each channel.
+ *
+ * Vectorized the same way as the other array conversions, out can be the same buffer as a or b.
+ *
+ * @param a Colors at frac 0.
+ * @param b Colors frac goes towards.
+ * @param out Where the blended colors go.
+ * @param n Number of colors.
+ * @param frac How far from a to b, in 65536ths.
+ */
+void rgb16_lerp_n(const rgb16_t *a, const rgb16_t *b, rgb16_t *out, uint32_t n, uint16_t frac);
+
+/**
+ * @brief Crossfades two arrays of sRGB colors in linear light, so midpoints keep their brightness instead of
+ * going dark and muddy the way blending the 8 bit values does.
+ *
+ * @param a Colors at frac 0.
+ * @param b Colors frac goes towards.
+ * @param out Where the blended colors go, can be the same buffer as a or b.
+ * @param n Number of colors.
+ * @param frac How far from a to b, in 65536ths.
+ */
+void rgb_lerp_linear_n(const rgb_t *a, const rgb_t *b, rgb_t *out, uint32_t n, uint16_t frac);
+
+/**
+ * @brief Converts an sRGB color to OKLab, where equal steps look like equal changes of color.
+ *
+ * @param col The sRGB color to convert.
+ * @return The OKLab color.
+ */
+oklab_t rgb2oklab(rgb_t col);
+
+/**
+ * @brief Converts an OKLab color to sRGB, channels outside of sRGB are clipped.
+ *
+ * @param lab The OKLab color to convert.
+ * @return The sRGB color.
+ */
+rgb_t oklab2rgb(oklab_t lab);
+
+/**
+ * @brief Blends two colors in OKLab, for gradients and fades between hues that stay even all the way across.
+ *
+ * Floating point with cube roots, meant for working out keyframes or palette entries rather than every pixel of a frame.
+ *
+ * @param a Color at frac 0.
+ * @param b Color frac goes towards.
+ * @param frac How far from a to b, in 65536ths.
+ * @return The blended color.
+ */
+rgb_t rgb_lerp_oklab(rgb_t a, rgb_t b, uint16_t frac);
+
+/**
+ * @brief Bytes a pixel takes in a display format.
+ *
+ * @param format The display format.
+ * @return 2 for the 565 formats, 3 for 666.
+ */
+uint32_t color_format_bytes(color_format_t format);
+
+/**
+ * @brief Converts a row of pixels into a display format, vectorized the same way as the other array conversions.
+ *
+ * Meant to be called a row at a time straight into an SPI DMA buffer, x and y are where the row starts on the
+ * display so dithering lines up between rows and partial updates.
+ * Without dithering the low bits are just dropped, the same as rgb888_to_rgb565().
+ *
+ * @param in Colors to convert.
+ * @param out Where the converted pixels go, n * color_format_bytes(format) bytes.
+ * @param n Number of pixels.
+ * @param format The display format.
+ * @param dither Adds a 4x4 ordered(Bayer) dither before dropping the low bits, so gradients don't band.
+ * @param x Column of the first pixel on the display.
+ * @param y Row on the display.
+ */
+void rgb_convert_row(const rgb_t *in, uint8_t *out, uint32_t n, color_format_t format, bool dither, uint32_t x, uint32_t y);
+
+/**
+ * @brief Converts a whole frame into a display format, rgb_convert_row() on every row.
+ *
+ * @param in width * height colors, a row at a time.
+ * @param out Where the converted pixels go, width * height * color_format_bytes(format) bytes.
+ * @param width Pixels in a row.
+ * @param height Number of rows.
+ * @param format The display format.
+ * @param dither Adds a 4x4 ordered(Bayer) dither before dropping the low bits.
+ */
+void rgb_convert_frame(const rgb_t *in, uint8_t *out, uint32_t width, uint32_t height, color_format_t format, bool dither);
+
+/**
+ * @brief Which kernels the array conversions ended up using on this cpu.
+ *
+ * @return "avx2", "sse2", "neon" or "scalar".
+ */
+const char *color_conv_kernel_name(void);
+
+/**
+ * @brief Finds the palette entry closest to a color, by squared distance in RGB
+ *
+ * @param palette Colors to pick from.
+ * @param num_colors Number of entries in the palette(1-256).
+ * @param col The color to match.
+ * @return Index of the closest entry, the first one on ties.
+ */
+uint8_t rgb_palette_nearest(const rgb_t *palette, int num_colors, rgb_t col);
+
 #endif
\ No newline at end of file
@@ -1,5 +1,60 @@
 #include "csal_ledmatrix.h"
+#include "csal_ledmatrix_font.h"
 #include "global_includes.h"
+#include "string.h"
+#include "math.h"
+#include "os_time.h"
+
+// Everything the flush thread needs, owned by a double buffered matrix
+struct os_ledmatrix_flush
+{
+    // Frame being pushed to the backend, and the region of it that changed
+    rgb_t *front;
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    bool clear;
+
+    // Guards busy, last_ret and the stats, the matrix mutex is taken first when both are needed
+    os_mut_t mutex;
+    // Set from present until the flush thread is done with the front buffer
+    bool busy;
+    // Presented while busy, the flush thread swaps it in itself once its slot is over
+    bool pending;
+    os_setbits_t frame_ready;
+    os_setbits_t frame_done;
+    int last_ret;
+
+    uint32_t frame_period_us;
+    int64_t next_vsync_us;
+
+    uint32_t frames_presented;
+    uint32_t frames_dropped;
+    uint32_t last_flush_us;
+    uint32_t max_flush_us;
+    uint32_t last_frame_interval_us;
+};
+
+// Palette mode of a matrix, pixels are indices into colors
+struct os_ledmatrix_palette
+{
+    uint8_t bits;
+    // 16 or 256, whatever fits in bits
+    int num_colors;
+    rgb_t *colors;
+    // Row major, two pixels a byte at 4 bits with even pixels in the low nibble. Rows start on a new byte
+    uint8_t *indices;
+    int stride;
+
+    // One row of colors, the dirty region is expanded into it a row at a time on update
+    rgb_t *row;
+
+    // Last color looked up, so shapes only search the palette once
+    rgb_t last_col;
+    uint8_t last_index;
+    bool last_valid;
+};
 
 bool is_valid_line(os_2d_line_t line)
 {
@@ -10,392 +65,2809 @@ bool is_valid_line(os_2d_line_t line)
     return true;
 }
 
-static int os_matrix_draw_vline(os_ledmatrix_t *matrix, int len, os_2d_point_t point, rgb_t col)
+// Grows the dirty region to cover the given inclusive bounds
+static inline void os_matrix_mark_dirty(os_ledmatrix_t *matrix, int x0, int y0, int x1, int y1)
+{
+    if (x0 < matrix->dirty_x0)
+        matrix->dirty_x0 = x0;
+    if (y0 < matrix->dirty_y0)
+        matrix->dirty_y0 = y0;
+    if (x1 > matrix->dirty_x1)
+        matrix->dirty_x1 = x1;
+    if (y1 > matrix->dirty_y1)
+        matrix->dirty_y1 = y1;
+}
+
+static inline bool os_matrix_is_dirty(os_ledmatrix_t *matrix)
 {
+    return (matrix->dirty_x0 <= matrix->dirty_x1) && (matrix->dirty_y0 <= matrix->dirty_y1);
+}
+
+static inline void os_matrix_clear_dirty(os_ledmatrix_t *matrix)
+{
+    matrix->dirty_x0 = matrix->width;
+    matrix->dirty_y0 = matrix->height;
+    matrix->dirty_x1 = -1;
+    matrix->dirty_y1 = -1;
+}
 
-    for (int n = point.y; n <= point.y + len; n++)
+// Palette entry to draw a color with
+static inline uint8_t os_matrix_palette_lookup(os_ledmatrix_palette *palette, rgb_t col)
+{
+    if (!palette->last_valid || palette->last_col.r != col.r || palette->last_col.g != col.g || palette->last_col.b != col.b)
     {
-        matrix->setpixel_func(matrix->data_ptr, point.x, n, col.r, col.g, col.b);
+        palette->last_col = col;
+        palette->last_index = rgb_palette_nearest(palette->colors, palette->num_colors, col);
+        palette->last_valid = true;
     }
-
-    return OS_RET_OK;
+    return palette->last_index;
 }
 
-/*
-static int os_matrix_draw_hline(os_ledmatrix_t *matrix, int len, os_2d_point_t point, rgb_t col)
+static inline void os_matrix_palette_put(os_ledmatrix_palette *palette, int x, int y, uint8_t index)
 {
-    for (int n = point.x; n <= point.x + len; n++)
+    uint8_t *row = &palette->indices[y * palette->stride];
+    if (palette->bits == 8)
     {
-        matrix->setpixel_func(matrix->data_ptr, n, point.y, col.r, col.g, col.b);
+        row[x] = index;
+        return;
     }
 
-    return OS_RET_OK;
+    int shift = (x & 1) * 4;
+    row[x >> 1] = (uint8_t)((row[x >> 1] & ~(0x0F << shift)) | ((index & 0x0F) << shift));
 }
-*/
 
-// Swaps x n y corrdinates to make them valid
-os_2d_line_t os_make_line_valid(os_2d_line_t line)
+// Expands indices x0 to x1 of a row into out[x0] to out[x1]
+static void os_matrix_palette_expand(const os_ledmatrix_palette *palette, int y, int x0, int x1, rgb_t *out)
 {
-    if (line.p1.x > line.p2.x)
+    const uint8_t *row = &palette->indices[y * palette->stride];
+    if (palette->bits == 8)
     {
-        int x = line.p1.x;
-        line.p1.x = line.p2.x;
-        line.p2.x = x;
+        for (int x = x0; x <= x1; x++)
+        {
+            out[x] = palette->colors[row[x]];
+        }
+        return;
     }
 
-    if (line.p1.y > line.p2.y)
+    for (int x = x0; x <= x1; x++)
     {
-        int y = line.p1.y;
-        line.p1.y = line.p2.y;
-        line.p2.y = y;
+        out[x] = palette->colors[(row[x >> 1] >> ((x & 1) * 4)) & 0x0F];
     }
-
-    return line;
 }
 
-int os_drawline_ledmatrix_hsv(os_ledmatrix_t *matrix, os_2d_line_t line, hsv_t hsv)
+// Writes a single pixel into the framebuffer, anything off the panel is dropped
+static inline void os_matrix_fb_set(os_ledmatrix_t *matrix, int x, int y, rgb_t col)
 {
-    rgb_t col = hsv2rgb(hsv);
-    return os_drawline_ledmatrix(matrix, line, col);
+    if ((unsigned)x >= (unsigned)matrix->width || (unsigned)y >= (unsigned)matrix->height)
+    {
+        return;
+    }
+
+    if (matrix->palette != NULL)
+    {
+        os_matrix_palette_put(matrix->palette, x, y, os_matrix_palette_lookup(matrix->palette, col));
+    }
+    else
+    {
+        matrix->framebuffer[y * matrix->width + x] = col;
+    }
+    os_matrix_mark_dirty(matrix, x, y, x, y);
 }
 
-int os_drawline_ledmatrix(os_ledmatrix_t *matrix, os_2d_line_t line, rgb_t rgb)
+static inline int64_t os_matrix_ceil_div(int64_t num, int64_t den)
 {
-
-    if (matrix == NULL)
+    int64_t q = num / den;
+    if ((num % den != 0) && ((num < 0) == (den < 0)))
     {
-        return OS_RET_NULL_PTR;
+        q++;
     }
+    return q;
+}
 
-    // Make sure line is valid to rasterize
-    line = os_make_line_valid(line);
-
-    int x1 = line.p1.x;
-    int x2 = line.p2.x;
-    int y1 = line.p1.y;
-    int y2 = line.p2.y;
-
-    int m_new = 2 * (y2 - y1);
-    int slope_error_new = m_new - (x2 - x1);
-    for (int x = x1, y = y1; x <= x2; x++)
+static inline uint32_t os_matrix_isqrt(uint64_t n)
+{
+    uint64_t res = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > n)
     {
-        // Add slope to increment angle formed
-        slope_error_new += m_new;
+        bit >>= 2;
+    }
 
-        // Slope error reached limit, time to
-        // increment y and update slope error.
-        if (slope_error_new >= 0)
+    while (bit != 0)
+    {
+        if (n >= res + bit)
+        {
+            n -= res + bit;
+            res = (res >> 1) + bit;
+        }
+        else
         {
-            y++;
-            slope_error_new -= 2 * (x2 - x1);
+            res >>= 1;
         }
-        // os_printf("x:%d, y:%d\n", x, y);
-        matrix->setpixel_func(matrix->data_ptr, x, y, rgb.r, rgb.g, rgb.b);
+        bit >>= 2;
     }
+    return (uint32_t)res;
+}
 
-    return OS_RET_OK;
+static inline int os_matrix_lock(os_ledmatrix_t *matrix)
+{
+    return os_mut_entry_wait_indefinite((os_mut_t *)matrix->matrix_mut);
 }
 
-int os_init_ledmatrix(os_ledmatrix_init_t matrix_init, os_ledmatrix_t *matrix)
+static inline int os_matrix_unlock(os_ledmatrix_t *matrix)
 {
+    return os_mut_exit((os_mut_t *)matrix->matrix_mut);
+}
 
-    if (matrix == NULL)
+// Same as os_matrix_fill_span() but with a palette index, matrix has to be in palette mode
+static inline void os_matrix_fill_span_index(os_ledmatrix_t *matrix, int y, int x0, int x1, uint8_t index)
+{
+    if ((unsigned)y >= (unsigned)matrix->height)
     {
-        println("Matrix null");
-        return OS_RET_NULL_PTR;
+        return;
     }
 
-    // Basic checking of the structure to make sure none of the parameters are off
-    if ((matrix_init.init_func == NULL) |
-        (matrix_init.setpixel_func == NULL) |
-        (matrix_init.update_func == NULL) |
-        (matrix_init.matrix_ptr == NULL) |
-        (matrix_init.height == 0) |
-        (matrix_init.width == 0))
+    if (x0 < 0)
+        x0 = 0;
+    if (x1 >= matrix->width)
+        x1 = matrix->width - 1;
+    if (x0 > x1)
     {
-
-        return OS_RET_INVALID_PARAM;
+        return;
     }
 
-    matrix->init_func = matrix_init.init_func;
-    matrix->setpixel_func = matrix_init.setpixel_func;
-    matrix->update_fun = matrix_init.update_func;
-    matrix->height = matrix_init.height;
-    matrix->width = matrix_init.width;
-    matrix->data_ptr = matrix_init.matrix_ptr;
-
-    matrix->matrix_mut = malloc(sizeof(os_mut_t));
-    int ret = os_mut_init((os_mut_t *)matrix->matrix_mut);
-    if (ret != OS_RET_OK)
+    os_ledmatrix_palette *palette = matrix->palette;
+    if (palette->bits == 8)
     {
-        return ret;
+        memset(&palette->indices[y * palette->stride + x0], index, x1 - x0 + 1);
     }
-
-    // Calls the initialization function
-    return matrix->init_func(matrix->data_ptr, matrix->width, matrix->height);
-}
-
-int os_clear_ledmatrix(os_ledmatrix_t *matrix)
-{
-    for (int x = 0; x < matrix->width; x++)
+    else
     {
-        for (int y = 0; y < matrix->height; y++)
+        for (int x = x0; x <= x1; x++)
         {
-            os_setpixel_ledmatrix(matrix, x, y, {0, 0, 0});
+            os_matrix_palette_put(palette, x, y, index);
         }
     }
-
-    return OS_RET_OK;
+    os_matrix_mark_dirty(matrix, x0, y, x1, y);
 }
 
-static inline int os_drawcircle_ledmatrix_outline(os_ledmatrix_t *matrix, os_2d_circle_t circle, rgb_t rgb)
+// Writes a horizontal run of pixels straight into the framebuffer, clipped to the panel
+static inline void os_matrix_fill_span(os_ledmatrix_t *matrix, int y, int x0, int x1, rgb_t col)
 {
-    int x0 = circle.p.x;
-    int y0 = circle.p.y;
-    int r = circle.intensity;
-
-    int16_t f = 1 - r;
-    int16_t ddF_x = 1;
-    int16_t ddF_y = -2 * r;
-    int16_t x = 0;
-    int16_t y = r;
+    if (matrix->palette != NULL)
+    {
+        os_matrix_fill_span_index(matrix, y, x0, x1, os_matrix_palette_lookup(matrix->palette, col));
+        return;
+    }
 
-    matrix->setpixel_func(matrix->data_ptr, x0, y0 + r, rgb.r, rgb.g, rgb.b);
-    matrix->setpixel_func(matrix->data_ptr, x0, y0 - r, rgb.r, rgb.g, rgb.b);
-    matrix->setpixel_func(matrix->data_ptr, x0 + r, y0, rgb.r, rgb.g, rgb.b);
-    matrix->setpixel_func(matrix->data_ptr, x0 - r, y0, rgb.r, rgb.g, rgb.b);
+    if ((unsigned)y >= (unsigned)matrix->height)
+    {
+        return;
+    }
 
-    while (x < y)
+    if (x0 < 0)
+        x0 = 0;
+    if (x1 >= matrix->width)
+        x1 = matrix->width - 1;
+    if (x0 > x1)
     {
-        if (f >= 0)
-        {
-            y--;
-            ddF_y += 2;
-            f += ddF_y;
-        }
-        x++;
-        ddF_x += 2;
-        f += ddF_x;
+        return;
+    }
 
-        matrix->setpixel_func(matrix->data_ptr, x0 + x, y0 + y, rgb.r, rgb.g, rgb.b);
-        matrix->setpixel_func(matrix->data_ptr, x0 - x, y0 + y, rgb.r, rgb.g, rgb.b);
-        matrix->setpixel_func(matrix->data_ptr, x0 + x, y0 - y, rgb.r, rgb.g, rgb.b);
-        matrix->setpixel_func(matrix->data_ptr, x0 - x, y0 - y, rgb.r, rgb.g, rgb.b);
-        matrix->setpixel_func(matrix->data_ptr, x0 + y, y0 + x, rgb.r, rgb.g, rgb.b);
-        matrix->setpixel_func(matrix->data_ptr, x0 - y, y0 + x, rgb.r, rgb.g, rgb.b);
-        matrix->setpixel_func(matrix->data_ptr, x0 + y, y0 - x, rgb.r, rgb.g, rgb.b);
-        matrix->setpixel_func(matrix->data_ptr, x0 - y, y0 - x, rgb.r, rgb.g, rgb.b);
+    rgb_t *row = &matrix->framebuffer[y * matrix->width];
+    for (int x = x0; x <= x1; x++)
+    {
+        row[x] = col;
     }
-    return OS_RET_OK;
+    os_matrix_mark_dirty(matrix, x0, y, x1, y);
 }
 
-static inline int os_drawcircle_ledmatrix_fill(os_ledmatrix_t *matrix, os_2d_circle_t circle, rgb_t rgb)
+// Sends each run of same colored pixels in the region as one fill
+static int os_matrix_flush_fill_runs(os_ledmatrix_t *matrix, int x0, int y0, int w, int h, const rgb_t *src)
 {
-    os_2d_point_t point = circle.p;
-    int r = circle.intensity;
-    point.y = point.y - r;
-    // Drawin center line hehe
-    os_matrix_draw_vline(matrix, 2 * r + 1, point, rgb);
-
-    int corners = 3;
-    int16_t f = 1 - r;
-    int16_t ddF_x = 1;
-    int16_t ddF_y = -2 * r;
-    int16_t x = 0;
-    int16_t y = r;
-    int16_t px = x;
-    int16_t py = y;
-    int x0 = circle.p.x;
-    int y0 = circle.p.y;
-
-    int delta = 1;
-
-    while (x < y)
+    for (int y = 0; y < h; y++)
     {
-        if (f >= 0)
-        {
-            y--;
-            ddF_y += 2;
-            f += ddF_y;
-        }
-        x++;
-        ddF_x += 2;
-        f += ddF_x;
-        // These checks avoid double-drawing certain lines, important
-        // for the SSD1306 library which has an INVERT drawing mode.
-        if (x < (y + 1))
+        const rgb_t *row = &src[y * matrix->width];
+        int start = 0;
+        for (int x = 1; x <= w; x++)
         {
-            if (corners & 1)
+            if (x < w && row[x].r == row[start].r && row[x].g == row[start].g && row[x].b == row[start].b)
             {
-                point.x = x0 + x;
-                point.y = y0 - y;
-                os_matrix_draw_vline(matrix, 2 * y + delta, point, rgb);
+                continue;
             }
 
-            if (corners & 2)
+            int ret = matrix->fill_rect_func(matrix->data_ptr, x0 + start, y0 + y, x - start, 1,
+                                             row[start].r, row[start].g, row[start].b);
+            if (ret != OS_RET_OK)
             {
-                point.x = x0 - x;
-                point.y = y0 - y;
-                os_matrix_draw_vline(matrix, 2 * y + delta, point, rgb);
+                return ret;
             }
+            start = x;
         }
-        if (y != py)
+    }
+
+    return OS_RET_OK;
+}
+
+static int os_matrix_flush_pixels(os_ledmatrix_t *matrix, int x0, int y0, int w, int h, const rgb_t *src)
+{
+    for (int y = 0; y < h; y++)
+    {
+        const rgb_t *row = &src[y * matrix->width];
+        for (int x = 0; x < w; x++)
         {
-            if (corners & 1)
-            {
-                point.x = x0 + py;
-                point.y = y0 - px;
-                os_matrix_draw_vline(matrix, 2 * px + delta, point, rgb);
-            }
-            if (corners & 2)
+            int ret = matrix->setpixel_func(matrix->data_ptr, x0 + x, y0 + y, row[x].r, row[x].g, row[x].b);
+            if (ret != OS_RET_OK)
             {
-                point.x = x0 - py;
-                point.y = y0 - px;
-                os_matrix_draw_vline(matrix, 2 * px + delta, point, rgb);
+                return ret;
             }
-            py = y;
         }
-        px = x;
     }
 
     return OS_RET_OK;
 }
 
-int os_drawcircle_ledmatrix(os_ledmatrix_t *matrix, os_2d_circle_t circle, rgb_t rgb, os_ledmatrix_fill_type_t fill_type)
+// Pushes a region of a frame out to the backend, using the cheapest call it has
+// rows is where row y0 of the frame starts, rows after it follow width pixels apart
+static int os_matrix_flush_region(os_ledmatrix_t *matrix, const rgb_t *rows, int x0, int y0, int x1, int y1, bool clear)
 {
-    if (matrix == NULL)
+    int ret = OS_RET_OK;
+    if (clear)
     {
-        return OS_RET_NULL_PTR;
+        ret = matrix->clear_func(matrix->data_ptr);
+        if (ret != OS_RET_OK)
+        {
+            return ret;
+        }
     }
 
-    switch (fill_type)
+    if (x0 > x1 || y0 > y1)
     {
-    case MATRIX_2D_FILL_OUTLINE:
-        return os_drawcircle_ledmatrix_outline(matrix, circle, rgb);
-
-    case MATRIX_2D_FILL_FULL:
-        return os_drawcircle_ledmatrix_fill(matrix, circle, rgb);
-
-    default:
-        return OS_RET_INVALID_PARAM;
+        return OS_RET_OK;
     }
-}
 
-int os_setpixel_ledmatrix(os_ledmatrix_t *matrix, int x, int y, rgb_t rgb)
-{
-    if (matrix == NULL)
+    int w = x1 - x0 + 1;
+    int h = y1 - y0 + 1;
+    const rgb_t *src = &rows[x0];
+
+    if (matrix->blit_func != NULL)
     {
-        return OS_RET_NULL_PTR;
+        ret = matrix->blit_func(matrix->data_ptr, x0, y0, w, h, src, matrix->width);
     }
-
-    if ((x > matrix->width) | (y > matrix->height))
+    else if (matrix->blit_rows_func != NULL)
     {
-        return OS_RET_INVALID_PARAM;
+        ret = matrix->blit_rows_func(matrix->data_ptr, y0, h, rows);
     }
-
-    int final_ret = OS_RET_OK;
-    int ret = os_mut_entry_wait_indefinite((os_mut_t *)matrix->matrix_mut);
-    if (ret != OS_RET_OK)
+    else if (matrix->fill_rect_func != NULL)
     {
-        return ret;
+        ret = os_matrix_flush_fill_runs(matrix, x0, y0, w, h, src);
     }
-    final_ret = matrix->setpixel_func(matrix->data_ptr, x, y, rgb.r, rgb.g, rgb.b);
-    ret = os_mut_exit((os_mut_t *)matrix->matrix_mut);
-    if (ret != OS_RET_OK)
+    else
     {
-        return ret;
+        // Backend can only take single pixels, but at least we only send what changed
+        ret = os_matrix_flush_pixels(matrix, x0, y0, w, h, src);
     }
 
-    return final_ret;
+    return ret;
 }
 
-int os_setpixel_ledmatrix_hsv(os_ledmatrix_t *matrix, int x, int y, hsv_t hsv)
+// Same as os_matrix_flush_region(), but puts the region in chain order first when the matrix is mapped
+static int os_matrix_flush_mapped(os_ledmatrix_t *matrix, const rgb_t *frame, int x0, int y0, int x1, int y1, bool clear)
 {
-    if (matrix == NULL)
+    if (matrix->map_lut == NULL)
     {
-        return OS_RET_NULL_PTR;
+        return os_matrix_flush_region(matrix, &frame[y0 * matrix->width], x0, y0, x1, y1, clear);
     }
 
-    if ((x > matrix->width) | (y > matrix->height))
+    if (clear)
     {
-        return OS_RET_INVALID_PARAM;
+        memset(matrix->map_buffer, 0, matrix->width * matrix->height * sizeof(rgb_t));
     }
-    rgb_t rgb = hsv2rgb(hsv);
 
-    int final_ret;
-    int ret = os_mut_entry_wait_indefinite((os_mut_t *)matrix->matrix_mut);
-    if (ret != OS_RET_OK)
+    if (x0 > x1 || y0 > y1)
     {
-        return ret;
+        return os_matrix_flush_region(matrix, matrix->map_buffer, 0, 0, -1, -1, clear);
     }
-    final_ret = matrix->setpixel_func(matrix->data_ptr, x, y, rgb.r, rgb.g, rgb.b);
-    ret = os_mut_exit((os_mut_t *)matrix->matrix_mut);
-    if (ret != OS_RET_OK)
+
+    // One table load per pixel, keeping track of how far along the chain the region reaches.
+    // In palette mode there's no frame, each row is expanded on the way instead
+    uint32_t lo = UINT32_MAX;
+    uint32_t hi = 0;
+    for (int y = y0; y <= y1; y++)
     {
-        return ret;
+        const rgb_t *src = matrix->palette != NULL ? matrix->palette->row : &frame[y * matrix->width];
+        if (matrix->palette != NULL)
+        {
+            os_matrix_palette_expand(matrix->palette, y, x0, x1, matrix->palette->row);
+        }
+        const uint32_t *lut = &matrix->map_lut[y * matrix->width];
+        for (int x = x0; x <= x1; x++)
+        {
+            uint32_t idx = lut[x];
+            matrix->map_buffer[idx] = src[x];
+            if (idx < lo)
+                lo = idx;
+            if (idx > hi)
+                hi = idx;
+        }
     }
 
-    return final_ret;
+    int first_row = lo / matrix->width;
+    int last_row = hi / matrix->width;
+    if (first_row == last_row)
+    {
+        return os_matrix_flush_region(matrix, &matrix->map_buffer[first_row * matrix->width], lo % matrix->width, first_row,
+                                      hi % matrix->width, last_row, clear);
+    }
+    return os_matrix_flush_region(matrix, &matrix->map_buffer[first_row * matrix->width], 0, first_row, matrix->width - 1,
+                                  last_row, clear);
 }
 
-int os_ledmatrix_update(os_ledmatrix_t *matrix)
+// Pushes a region of the palette indices out to the backend a row at a time, matrix can't be mapped
+static int os_matrix_flush_palette(os_ledmatrix_t *matrix, int x0, int y0, int x1, int y1, bool clear)
 {
-    if (matrix == NULL)
+    if (x0 > x1 || y0 > y1)
     {
-        return OS_RET_NULL_PTR;
+        return os_matrix_flush_region(matrix, matrix->palette->row, 0, 0, -1, -1, clear);
     }
 
-    int final_ret;
-    int ret = os_mut_entry_wait_indefinite((os_mut_t *)matrix->matrix_mut);
-    if (ret != OS_RET_OK)
+    // blit_rows takes whole rows, anything left outside the region would be whatever the last row had there
+    bool whole_rows = matrix->blit_func == NULL && matrix->blit_rows_func != NULL;
+    for (int y = y0; y <= y1; y++)
     {
-        return ret;
+        os_matrix_palette_expand(matrix->palette, y, whole_rows ? 0 : x0, whole_rows ? matrix->width - 1 : x1, matrix->palette->row);
+        int ret = os_matrix_flush_region(matrix, matrix->palette->row, x0, y, x1, y, clear && y == y0);
+        if (ret != OS_RET_OK)
+        {
+            return ret;
+        }
     }
-    final_ret = matrix->update_fun(matrix->data_ptr);
-    ret = os_mut_exit((os_mut_t *)matrix->matrix_mut);
-    if (ret != OS_RET_OK)
+    return OS_RET_OK;
+}
+
+// Pushes the dirty region of the framebuffer out to the backend
+static int os_matrix_flush_dirty(os_ledmatrix_t *matrix)
+{
+    int ret;
+    if (matrix->palette != NULL && matrix->map_lut == NULL)
     {
-        return ret;
+        ret = os_matrix_flush_palette(matrix, matrix->dirty_x0, matrix->dirty_y0, matrix->dirty_x1, matrix->dirty_y1,
+                                      matrix->clear_pending);
+    }
+    else
+    {
+        ret = os_matrix_flush_mapped(matrix, matrix->framebuffer,
+                                     matrix->dirty_x0, matrix->dirty_y0, matrix->dirty_x1, matrix->dirty_y1,
+                                     matrix->clear_pending);
+    }
+    if (ret == OS_RET_OK)
+    {
+        matrix->clear_pending = false;
+        os_matrix_clear_dirty(matrix);
     }
 
-    return final_ret;
+    return ret;
 }
 
-int os_setpixel_ledmatrix_hsv_image(os_ledmatrix_t *matrix, hsv_t *hsv_range)
+// Swaps x n y corrdinates to make them valid
+os_2d_line_t os_make_line_valid(os_2d_line_t line)
 {
-    if (matrix == NULL)
+    if (line.p1.x > line.p2.x)
     {
-        return OS_RET_NULL_PTR;
+        int x = line.p1.x;
+        line.p1.x = line.p2.x;
+        line.p2.x = x;
     }
 
-    int final_ret = OS_RET_OK;
-    int ret = os_mut_entry_wait_indefinite((os_mut_t *)matrix->matrix_mut);
-
-    for (int x = 0; x < matrix->width; x++)
+    if (line.p1.y > line.p2.y)
     {
-        for (int y = 0; y < matrix->height; y++)
-        {
-            rgb_t rgb = hsv2rgb(hsv_range[x * matrix->width + y]);
-            ret = matrix->setpixel_func(matrix->data_ptr, x, y, rgb.r, rgb.g, rgb.b);
+        int y = line.p1.y;
+        line.p1.y = line.p2.y;
+        line.p2.y = y;
+    }
 
-            // Failiure to update LED matrix
-            if (ret != OS_RET_OK)
-            {
-                int final_ret = os_mut_exit((os_mut_t *)matrix->matrix_mut);
-                if (final_ret != OS_RET_OK)
+    return line;
+}
+
+int os_drawline_ledmatrix_hsv(os_ledmatrix_t *matrix, os_2d_line_t line, hsv_t hsv)
+{
+    rgb_t col = hsv2rgb(hsv);
+    return os_drawline_ledmatrix(matrix, line, col);
+}
+
+#define OS_MATRIX_CLIP_LEFT 1
+#define OS_MATRIX_CLIP_RIGHT 2
+#define OS_MATRIX_CLIP_TOP 4
+#define OS_MATRIX_CLIP_BOTTOM 8
+
+// Cohen-Sutherland outcode against the panel grown by pad pixels on every side
+static inline int os_matrix_outcode(os_ledmatrix_t *matrix, int x, int y, int pad)
+{
+    int code = 0;
+    if (x < -pad)
+        code |= OS_MATRIX_CLIP_LEFT;
+    else if (x >= matrix->width + pad)
+        code |= OS_MATRIX_CLIP_RIGHT;
+    if (y < -pad)
+        code |= OS_MATRIX_CLIP_TOP;
+    else if (y >= matrix->height + pad)
+        code |= OS_MATRIX_CLIP_BOTTOM;
+    return code;
+}
+
+// A line walked along its major axis, step i lands on
+// major0 + major_dir * i, minor0 + minor_dir * floor((2 * i * minor_len + bias) / (2 * major_len))
+typedef struct os_matrix_line_walk
+{
+    bool steep;
+    int major0;
+    int minor0;
+    int major_dir;
+    int minor_dir;
+    int64_t major_len;
+    int64_t minor_len;
+    int64_t bias;
+    int64_t i_start;
+    int64_t i_end;
+} os_matrix_line_walk_t;
+
+/**
+ * Works out which steps of the line land on the panel(grown by pad), so the walk can jump straight
+ * to the first visible pixel with the exact same error term the unclipped line would have there.
+ * bias of major_len rounds the minor axis to the nearest pixel (Bresenham), 0 floors it (Wu)
+ */
+static bool os_matrix_clip_line(os_ledmatrix_t *matrix, os_2d_line_t line, int pad, bool nearest, os_matrix_line_walk_t *walk)
+{
+    int c1 = os_matrix_outcode(matrix, line.p1.x, line.p1.y, pad);
+    int c2 = os_matrix_outcode(matrix, line.p2.x, line.p2.y, pad);
+    if (c1 & c2)
+    {
+        // Both ends off the same side of the panel
+        return false;
+    }
+
+    int dx = line.p2.x - line.p1.x;
+    int dy = line.p2.y - line.p1.y;
+    int adx = dx < 0 ? -dx : dx;
+    int ady = dy < 0 ? -dy : dy;
+
+    walk->steep = ady > adx;
+    walk->major0 = walk->steep ? line.p1.y : line.p1.x;
+    walk->minor0 = walk->steep ? line.p1.x : line.p1.y;
+    walk->major_dir = (walk->steep ? dy : dx) < 0 ? -1 : 1;
+    walk->minor_dir = (walk->steep ? dx : dy) < 0 ? -1 : 1;
+    walk->major_len = walk->steep ? ady : adx;
+    walk->minor_len = walk->steep ? adx : ady;
+    walk->bias = nearest ? walk->major_len : 0;
+    walk->i_start = 0;
+    walk->i_end = walk->major_len;
+
+    // Both ends already on the panel, nothing to clip
+    if ((c1 | c2) == 0)
+    {
+        return true;
+    }
+
+    int major_max = (walk->steep ? matrix->height : matrix->width) - 1 + pad;
+    int minor_max = (walk->steep ? matrix->width : matrix->height) - 1 + pad;
+
+    // Major axis moves one pixel per step
+    int64_t lo = walk->major_dir > 0 ? -pad - walk->major0 : walk->major0 - major_max;
+    int64_t hi = walk->major_dir > 0 ? major_max - walk->major0 : walk->major0 + pad;
+    if (lo > walk->i_start)
+        walk->i_start = lo;
+    if (hi < walk->i_end)
+        walk->i_end = hi;
+
+    // Minor axis offset only ever grows along the walk, so it's in range for one run of steps
+    int64_t kmin = walk->minor_dir > 0 ? -pad - walk->minor0 : walk->minor0 - minor_max;
+    int64_t kmax = walk->minor_dir > 0 ? minor_max - walk->minor0 : walk->minor0 + pad;
+    if (walk->minor_len == 0)
+    {
+        if (kmin > 0 || kmax < 0)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        lo = os_matrix_ceil_div(2 * walk->major_len * kmin - walk->bias, 2 * walk->minor_len);
+        hi = os_matrix_ceil_div(2 * walk->major_len * (kmax + 1) - walk->bias, 2 * walk->minor_len) - 1;
+        if (lo > walk->i_start)
+            walk->i_start = lo;
+        if (hi < walk->i_end)
+            walk->i_end = hi;
+    }
+
+    return walk->i_start <= walk->i_end;
+}
+
+// Bresenham over the clipped steps, each step draws run pixels across the minor axis centered on the line
+static void os_matrix_walk_line(os_ledmatrix_t *matrix, const os_matrix_line_walk_t *walk, int run, rgb_t rgb)
+{
+    int64_t den = walk->major_len == 0 ? 1 : 2 * walk->major_len;
+    int64_t num = 2 * walk->i_start * walk->minor_len + walk->bias;
+    int k = (int)(num / den);
+    int64_t rem = num % den;
+    int offset = run / 2;
+
+    for (int64_t i = walk->i_start; i <= walk->i_end; i++)
+    {
+        int major = walk->major0 + walk->major_dir * (int)i;
+        int minor = walk->minor0 + walk->minor_dir * k - offset;
+        if (walk->steep)
+        {
+            os_matrix_fill_span(matrix, major, minor, minor + run - 1, rgb);
+        }
+        else
+        {
+            for (int n = 0; n < run; n++)
+            {
+                os_matrix_fb_set(matrix, major, minor + n, rgb);
+            }
+        }
+
+        rem += 2 * walk->minor_len;
+        if (rem >= den)
+        {
+            rem -= den;
+            k++;
+        }
+    }
+}
+
+int os_drawline_ledmatrix(os_ledmatrix_t *matrix, os_2d_line_t line, rgb_t rgb)
+{
+
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    os_matrix_line_walk_t walk;
+    if (os_matrix_clip_line(matrix, line, 0, true, &walk))
+    {
+        os_matrix_walk_line(matrix, &walk, 1, rgb);
+    }
+
+    return os_matrix_unlock(matrix);
+}
+
+int os_drawline_ledmatrix_thick(os_ledmatrix_t *matrix, os_2d_line_t line, int thickness, rgb_t rgb)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (thickness < 1)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // Runs go across the major axis, stretch them so the width measured across the line is right
+    int64_t dx = line.p2.x - line.p1.x;
+    int64_t dy = line.p2.y - line.p1.y;
+    int64_t major_len = dx * dx > dy * dy ? (dx < 0 ? -dx : dx) : (dy < 0 ? -dy : dy);
+    int run = thickness;
+    if (major_len != 0)
+    {
+        uint64_t len2 = 4 * (uint64_t)thickness * thickness * (dx * dx + dy * dy);
+        run = (int)((os_matrix_isqrt(len2) + major_len) / (2 * major_len));
+    }
+
+    os_matrix_line_walk_t walk;
+    if (os_matrix_clip_line(matrix, line, run / 2 + 1, true, &walk))
+    {
+        os_matrix_walk_line(matrix, &walk, run, rgb);
+    }
+
+    return os_matrix_unlock(matrix);
+}
+
+static inline uint8_t os_matrix_blend_channel(uint8_t dst, uint8_t src, uint8_t alpha)
+{
+    // dst * (255 - alpha) + src * alpha, divided by 255 with rounding
+    uint32_t t = dst * (255 - alpha) + src * alpha + 128;
+    return (uint8_t)((t + (t >> 8)) >> 8);
+}
+
+// Blends a pixel into the framebuffer, anything off the panel is dropped
+static inline void os_matrix_fb_blend(os_ledmatrix_t *matrix, int x, int y, rgb_t col, uint8_t alpha)
+{
+    if ((unsigned)x >= (unsigned)matrix->width || (unsigned)y >= (unsigned)matrix->height || alpha == 0)
+    {
+        return;
+    }
+
+    rgb_t *dst = &matrix->framebuffer[y * matrix->width + x];
+    dst->r = os_matrix_blend_channel(dst->r, col.r, alpha);
+    dst->g = os_matrix_blend_channel(dst->g, col.g, alpha);
+    dst->b = os_matrix_blend_channel(dst->b, col.b, alpha);
+    os_matrix_mark_dirty(matrix, x, y, x, y);
+}
+
+int os_drawline_ledmatrix_aa(os_ledmatrix_t *matrix, os_2d_line_t line, rgb_t rgb)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    // Blending needs the colors underneath
+    if (matrix->palette != NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // Wu's algorithm, the exact line falls between two pixels on the minor axis which share the coverage
+    os_matrix_line_walk_t walk;
+    if (os_matrix_clip_line(matrix, line, 1, false, &walk))
+    {
+        int64_t den = walk.major_len == 0 ? 1 : walk.major_len;
+        int64_t num = walk.i_start * walk.minor_len;
+        int k = (int)(num / den);
+        int64_t rem = num % den;
+
+        // rem / major_len as 0-255 coverage without a divide per pixel
+        uint64_t coverage_scale = ((uint64_t)255 << 24) / den;
+
+        for (int64_t i = walk.i_start; i <= walk.i_end; i++)
+        {
+            int major = walk.major0 + walk.major_dir * (int)i;
+            int minor = walk.minor0 + walk.minor_dir * k;
+            uint8_t coverage = (uint8_t)(((uint64_t)rem * coverage_scale + (1 << 23)) >> 24);
+
+            if (walk.steep)
+            {
+                os_matrix_fb_blend(matrix, minor, major, rgb, 255 - coverage);
+                os_matrix_fb_blend(matrix, minor + walk.minor_dir, major, rgb, coverage);
+            }
+            else
+            {
+                os_matrix_fb_blend(matrix, major, minor, rgb, 255 - coverage);
+                os_matrix_fb_blend(matrix, major, minor + walk.minor_dir, rgb, coverage);
+            }
+
+            rem += walk.minor_len;
+            if (rem >= den)
+            {
+                rem -= den;
+                k++;
+            }
+        }
+    }
+
+    return os_matrix_unlock(matrix);
+}
+
+int os_init_ledmatrix(os_ledmatrix_init_t matrix_init, os_ledmatrix_t *matrix)
+{
+
+    if (matrix == NULL)
+    {
+        println("Matrix null");
+        return OS_RET_NULL_PTR;
+    }
+
+    // Basic checking of the structure to make sure none of the parameters are off
+    if ((matrix_init.init_func == NULL) |
+        (matrix_init.setpixel_func == NULL) |
+        (matrix_init.update_func == NULL) |
+        (matrix_init.matrix_ptr == NULL) |
+        (matrix_init.height == 0) |
+        (matrix_init.width == 0))
+    {
+
+        return OS_RET_INVALID_PARAM;
+    }
+
+    matrix->init_func = matrix_init.init_func;
+    matrix->setpixel_func = matrix_init.setpixel_func;
+    matrix->update_fun = matrix_init.update_func;
+    matrix->blit_func = matrix_init.blit_func;
+    matrix->blit_rows_func = matrix_init.blit_rows_func;
+    matrix->fill_rect_func = matrix_init.fill_rect_func;
+    matrix->clear_func = matrix_init.clear_func;
+    matrix->height = matrix_init.height;
+    matrix->width = matrix_init.width;
+    matrix->data_ptr = matrix_init.matrix_ptr;
+
+    matrix->framebuffer = (rgb_t *)calloc(matrix->width * matrix->height, sizeof(rgb_t));
+    if (matrix->framebuffer == NULL)
+    {
+        return OS_RET_LOW_MEM_ERROR;
+    }
+    os_matrix_clear_dirty(matrix);
+    matrix->clear_pending = false;
+    matrix->palette = NULL;
+    matrix->flush = NULL;
+    matrix->map_lut = NULL;
+    matrix->map_buffer = NULL;
+
+    matrix->matrix_mut = malloc(sizeof(os_mut_t));
+    if (matrix->matrix_mut == NULL)
+    {
+        free(matrix->framebuffer);
+        matrix->framebuffer = NULL;
+        return OS_RET_LOW_MEM_ERROR;
+    }
+
+    int ret = os_mut_init((os_mut_t *)matrix->matrix_mut);
+    if (ret == OS_RET_OK && matrix_init.mapping != NULL)
+    {
+        ret = os_ledmatrix_set_mapping(matrix, matrix_init.mapping);
+    }
+    if (ret != OS_RET_OK)
+    {
+        free(matrix->matrix_mut);
+        free(matrix->framebuffer);
+        matrix->matrix_mut = NULL;
+        matrix->framebuffer = NULL;
+        return ret;
+    }
+
+    // Calls the initialization function
+    return matrix->init_func(matrix->data_ptr, matrix->width, matrix->height);
+}
+
+// Chain index of a pixel on the tile grid
+static uint32_t os_matrix_map_index(const os_ledmatrix_mapping_t *mapping, int panel_w, int panel_h, int tiles_x, int gx, int gy)
+{
+    int tile_x = gx / panel_w;
+    int tile_y = gy / panel_h;
+    int px = gx % panel_w;
+    int py = gy % panel_h;
+
+    if (mapping->tile_serpentine && (tile_y & 1))
+    {
+        tile_x = tiles_x - 1 - tile_x;
+    }
+    uint32_t tile = tile_y * tiles_x + tile_x;
+
+    // Rows of a panel, or columns when it's wired that way
+    int major = mapping->column_major ? px : py;
+    int minor = mapping->column_major ? py : px;
+    int minor_len = mapping->column_major ? panel_h : panel_w;
+    if (mapping->serpentine && (major & 1))
+    {
+        minor = minor_len - 1 - minor;
+    }
+
+    return tile * panel_w * panel_h + major * minor_len + minor;
+}
+
+int os_ledmatrix_set_mapping(os_ledmatrix_t *matrix, const os_ledmatrix_mapping_t *mapping)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    // The flush thread reads the table without the mutex
+    if (matrix->flush != NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    uint32_t *lut = NULL;
+    rgb_t *buffer = NULL;
+    if (mapping != NULL)
+    {
+        bool rotated = mapping->rotation == MATRIX_ROTATE_90 || mapping->rotation == MATRIX_ROTATE_270;
+        int grid_w = rotated ? matrix->height : matrix->width;
+        int grid_h = rotated ? matrix->width : matrix->height;
+        int tiles_x = mapping->tiles_x < 1 ? 1 : mapping->tiles_x;
+        int tiles_y = mapping->tiles_y < 1 ? 1 : mapping->tiles_y;
+        int panel_w = mapping->panel_width;
+        int panel_h = mapping->panel_height;
+        if (panel_w == 0 && panel_h == 0)
+        {
+            panel_w = grid_w / tiles_x;
+            panel_h = grid_h / tiles_y;
+        }
+
+        if (panel_w <= 0 || panel_h <= 0 || panel_w * tiles_x != grid_w || panel_h * tiles_y != grid_h)
+        {
+            return OS_RET_INVALID_PARAM;
+        }
+
+        lut = (uint32_t *)malloc(matrix->width * matrix->height * sizeof(uint32_t));
+        buffer = (rgb_t *)calloc(matrix->width * matrix->height, sizeof(rgb_t));
+        if (lut == NULL || buffer == NULL)
+        {
+            free(lut);
+            free(buffer);
+            return OS_RET_LOW_MEM_ERROR;
+        }
+
+        // All the divisions happen here, once
+        for (int y = 0; y < matrix->height; y++)
+        {
+            int ly = mapping->mirror_y ? matrix->height - 1 - y : y;
+            for (int x = 0; x < matrix->width; x++)
+            {
+                int lx = mapping->mirror_x ? matrix->width - 1 - x : x;
+                int gx;
+                int gy;
+                switch (mapping->rotation)
                 {
-                    return final_ret;
+                case MATRIX_ROTATE_90:
+                    gx = grid_w - 1 - ly;
+                    gy = lx;
+                    break;
+                case MATRIX_ROTATE_180:
+                    gx = grid_w - 1 - lx;
+                    gy = grid_h - 1 - ly;
+                    break;
+                case MATRIX_ROTATE_270:
+                    gx = ly;
+                    gy = grid_h - 1 - lx;
+                    break;
+                default:
+                    gx = lx;
+                    gy = ly;
+                    break;
                 }
-                return ret;
+                lut[y * matrix->width + x] = os_matrix_map_index(mapping, panel_w, panel_h, tiles_x, gx, gy);
             }
         }
     }
 
-    ret = os_mut_exit((os_mut_t *)matrix->matrix_mut);
+    int ret = os_matrix_lock(matrix);
     if (ret != OS_RET_OK)
     {
+        free(lut);
+        free(buffer);
         return ret;
     }
 
-    return final_ret;
-}
\ No newline at end of file
+    free(matrix->map_lut);
+    free(matrix->map_buffer);
+    matrix->map_lut = lut;
+    matrix->map_buffer = buffer;
+
+    // Every pixel is somewhere else on the chain now
+    os_matrix_mark_dirty(matrix, 0, 0, matrix->width - 1, matrix->height - 1);
+
+    return os_matrix_unlock(matrix);
+}
+
+int os_clear_ledmatrix(os_ledmatrix_t *matrix)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // Black might not be in the palette, so the backend can't clear itself
+    if (matrix->palette != NULL)
+    {
+        uint8_t index = os_matrix_palette_lookup(matrix->palette, {0, 0, 0});
+        for (int y = 0; y < matrix->height; y++)
+        {
+            os_matrix_fill_span_index(matrix, y, 0, matrix->width - 1, index);
+        }
+        return os_matrix_unlock(matrix);
+    }
+
+    memset(matrix->framebuffer, 0, matrix->width * matrix->height * sizeof(rgb_t));
+
+    // Let the backend clear itself in one go, then only what gets drawn afterwards is dirty
+    if (matrix->clear_func != NULL)
+    {
+        matrix->clear_pending = true;
+        os_matrix_clear_dirty(matrix);
+    }
+    else
+    {
+        os_matrix_mark_dirty(matrix, 0, 0, matrix->width - 1, matrix->height - 1);
+    }
+
+    return os_matrix_unlock(matrix);
+}
+
+static void os_matrix_palette_free(os_ledmatrix_palette *palette)
+{
+    free(palette->colors);
+    free(palette->indices);
+    free(palette->row);
+    delete palette;
+}
+
+int os_ledmatrix_enable_palette(os_ledmatrix_t *matrix, uint8_t bits, const rgb_t *colors, int num_colors)
+{
+    if (matrix == NULL || colors == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    // Layer canvases get blended from their framebuffer
+    if ((bits != 4 && bits != 8) || num_colors < 1 || num_colors > (1 << bits) || matrix->update_fun == NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    os_ledmatrix_palette *palette = new os_ledmatrix_palette;
+    palette->bits = bits;
+    palette->num_colors = 1 << bits;
+    palette->stride = (matrix->width * bits + 7) / 8;
+    palette->colors = (rgb_t *)calloc(palette->num_colors, sizeof(rgb_t));
+    palette->indices = (uint8_t *)calloc(palette->stride * matrix->height, 1);
+    palette->row = (rgb_t *)malloc(matrix->width * sizeof(rgb_t));
+    palette->last_valid = false;
+    if (palette->colors == NULL || palette->indices == NULL || palette->row == NULL)
+    {
+        os_matrix_palette_free(palette);
+        return OS_RET_LOW_MEM_ERROR;
+    }
+    memcpy(palette->colors, colors, num_colors * sizeof(rgb_t));
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        os_matrix_palette_free(palette);
+        return ret;
+    }
+
+    int final_ret = OS_RET_OK;
+    if (matrix->palette != NULL || matrix->flush != NULL)
+    {
+        os_matrix_palette_free(palette);
+        final_ret = OS_RET_INVALID_PARAM;
+    }
+    else
+    {
+        // Carry on from whatever was drawn so far
+        for (int y = 0; y < matrix->height; y++)
+        {
+            for (int x = 0; x < matrix->width; x++)
+            {
+                os_matrix_palette_put(palette, x, y, os_matrix_palette_lookup(palette, matrix->framebuffer[y * matrix->width + x]));
+            }
+        }
+        free(matrix->framebuffer);
+        matrix->framebuffer = NULL;
+        matrix->palette = palette;
+    }
+
+    ret = os_matrix_unlock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+int os_ledmatrix_set_palette(os_ledmatrix_t *matrix, uint8_t first, const rgb_t *colors, int count)
+{
+    if (matrix == NULL || colors == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_ledmatrix_palette *palette = matrix->palette;
+    if (palette == NULL || count < 1 || first + count > palette->num_colors)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    memcpy(&palette->colors[first], colors, count * sizeof(rgb_t));
+    palette->last_valid = false;
+    os_matrix_mark_dirty(matrix, 0, 0, matrix->width - 1, matrix->height - 1);
+
+    return os_matrix_unlock(matrix);
+}
+
+int os_ledmatrix_set_palette_hsv(os_ledmatrix_t *matrix, uint8_t first, const hsv_t *colors, int count)
+{
+    if (matrix == NULL || colors == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_ledmatrix_palette *palette = matrix->palette;
+    if (palette == NULL || count < 1 || first + count > palette->num_colors)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    hsv2rgb_n(colors, &palette->colors[first], count);
+    palette->last_valid = false;
+    os_matrix_mark_dirty(matrix, 0, 0, matrix->width - 1, matrix->height - 1);
+
+    return os_matrix_unlock(matrix);
+}
+
+int os_ledmatrix_rotate_palette(os_ledmatrix_t *matrix, uint8_t first, int count, int steps)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_ledmatrix_palette *palette = matrix->palette;
+    if (palette == NULL || count < 1 || first + count > palette->num_colors)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    steps %= count;
+    if (steps < 0)
+    {
+        steps += count;
+    }
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    rgb_t rotated[256];
+    for (int n = 0; n < count; n++)
+    {
+        int from = n - steps;
+        rotated[n] = palette->colors[first + (from < 0 ? from + count : from)];
+    }
+    memcpy(&palette->colors[first], rotated, count * sizeof(rgb_t));
+    palette->last_valid = false;
+    os_matrix_mark_dirty(matrix, 0, 0, matrix->width - 1, matrix->height - 1);
+
+    return os_matrix_unlock(matrix);
+}
+
+int os_setpixel_ledmatrix_index(os_ledmatrix_t *matrix, int x, int y, uint8_t index)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if ((x < 0) | (y < 0) | (x >= matrix->width) | (y >= matrix->height))
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    return os_fillrect_ledmatrix_index(matrix, {x, y, 1, 1}, index);
+}
+
+int os_fillrect_ledmatrix_index(os_ledmatrix_t *matrix, os_2d_rect_t rect, uint8_t index)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (matrix->palette == NULL || index >= matrix->palette->num_colors || rect.w < 0 || rect.h < 0)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int y0 = rect.y < 0 ? 0 : rect.y;
+    int y1 = rect.y + rect.h - 1;
+    if (y1 >= matrix->height)
+        y1 = matrix->height - 1;
+    for (int y = y0; y <= y1; y++)
+    {
+        os_matrix_fill_span_index(matrix, y, rect.x, rect.x + rect.w - 1, index);
+    }
+
+    return os_matrix_unlock(matrix);
+}
+
+static inline int os_drawcircle_ledmatrix_outline(os_ledmatrix_t *matrix, os_2d_circle_t circle, rgb_t rgb)
+{
+    int x0 = circle.p.x;
+    int y0 = circle.p.y;
+    int r = circle.intensity;
+
+    int16_t f = 1 - r;
+    int16_t ddF_x = 1;
+    int16_t ddF_y = -2 * r;
+    int16_t x = 0;
+    int16_t y = r;
+
+    os_matrix_fb_set(matrix, x0, y0 + r, rgb);
+    os_matrix_fb_set(matrix, x0, y0 - r, rgb);
+    os_matrix_fb_set(matrix, x0 + r, y0, rgb);
+    os_matrix_fb_set(matrix, x0 - r, y0, rgb);
+
+    while (x < y)
+    {
+        if (f >= 0)
+        {
+            y--;
+            ddF_y += 2;
+            f += ddF_y;
+        }
+        x++;
+        ddF_x += 2;
+        f += ddF_x;
+
+        os_matrix_fb_set(matrix, x0 + x, y0 + y, rgb);
+        os_matrix_fb_set(matrix, x0 - x, y0 + y, rgb);
+        os_matrix_fb_set(matrix, x0 + x, y0 - y, rgb);
+        os_matrix_fb_set(matrix, x0 - x, y0 - y, rgb);
+        os_matrix_fb_set(matrix, x0 + y, y0 + x, rgb);
+        os_matrix_fb_set(matrix, x0 - y, y0 + x, rgb);
+        os_matrix_fb_set(matrix, x0 + y, y0 - x, rgb);
+        os_matrix_fb_set(matrix, x0 - y, y0 - x, rgb);
+    }
+    return OS_RET_OK;
+}
+
+// Same midpoint walk as the outline, but every row gets filled in with a single span
+static inline int os_drawcircle_ledmatrix_fill(os_ledmatrix_t *matrix, os_2d_circle_t circle, rgb_t rgb)
+{
+    int x0 = circle.p.x;
+    int y0 = circle.p.y;
+    int r = circle.intensity;
+
+    int16_t f = 1 - r;
+    int16_t ddF_x = 1;
+    int16_t ddF_y = -2 * r;
+    int16_t x = 0;
+    int16_t y = r;
+    int16_t px = x;
+    int16_t py = y;
+
+    // Center row
+    os_matrix_fill_span(matrix, y0, x0 - r, x0 + r, rgb);
+
+    while (x < y)
+    {
+        if (f >= 0)
+        {
+            y--;
+            ddF_y += 2;
+            f += ddF_y;
+        }
+        x++;
+        ddF_x += 2;
+        f += ddF_x;
+
+        // These checks make sure every row only gets written once
+        if (x < (y + 1))
+        {
+            os_matrix_fill_span(matrix, y0 + x, x0 - y, x0 + y, rgb);
+            os_matrix_fill_span(matrix, y0 - x, x0 - y, x0 + y, rgb);
+        }
+        if (y != py)
+        {
+            os_matrix_fill_span(matrix, y0 + py, x0 - px, x0 + px, rgb);
+            os_matrix_fill_span(matrix, y0 - py, x0 - px, x0 + px, rgb);
+            py = y;
+        }
+        px = x;
+    }
+
+    return OS_RET_OK;
+}
+
+int os_drawcircle_ledmatrix(os_ledmatrix_t *matrix, os_2d_circle_t circle, rgb_t rgb, os_ledmatrix_fill_type_t fill_type)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int final_ret;
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    switch (fill_type)
+    {
+    case MATRIX_2D_FILL_OUTLINE:
+        final_ret = os_drawcircle_ledmatrix_outline(matrix, circle, rgb);
+        break;
+
+    case MATRIX_2D_FILL_FULL:
+        final_ret = os_drawcircle_ledmatrix_fill(matrix, circle, rgb);
+        break;
+
+    default:
+        final_ret = OS_RET_INVALID_PARAM;
+        break;
+    }
+
+    ret = os_matrix_unlock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    return final_ret;
+}
+
+int os_setpixel_ledmatrix(os_ledmatrix_t *matrix, int x, int y, rgb_t rgb)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if ((x < 0) | (y < 0) | (x >= matrix->width) | (y >= matrix->height))
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_mut_entry_wait_indefinite((os_mut_t *)matrix->matrix_mut);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    os_matrix_fb_set(matrix, x, y, rgb);
+    return os_mut_exit((os_mut_t *)matrix->matrix_mut);
+}
+
+int os_setpixel_ledmatrix_hsv(os_ledmatrix_t *matrix, int x, int y, hsv_t hsv)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if ((x < 0) | (y < 0) | (x >= matrix->width) | (y >= matrix->height))
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+    rgb_t rgb = hsv2rgb(hsv);
+
+    int ret = os_mut_entry_wait_indefinite((os_mut_t *)matrix->matrix_mut);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    os_matrix_fb_set(matrix, x, y, rgb);
+    return os_mut_exit((os_mut_t *)matrix->matrix_mut);
+}
+
+int os_ledmatrix_update(os_ledmatrix_t *matrix)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    // Layer canvases have no backend to update
+    if (matrix->update_fun == NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    if (matrix->flush != NULL)
+    {
+        return os_ledmatrix_present(matrix);
+    }
+
+    int final_ret;
+    int ret = os_mut_entry_wait_indefinite((os_mut_t *)matrix->matrix_mut);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // Nothing changed since the last update, so there's nothing worth sending
+    final_ret = OS_RET_OK;
+    if (os_matrix_is_dirty(matrix) || matrix->clear_pending)
+    {
+        final_ret = os_matrix_flush_dirty(matrix);
+        if (final_ret == OS_RET_OK)
+        {
+            final_ret = matrix->update_fun(matrix->data_ptr);
+        }
+    }
+    ret = os_mut_exit((os_mut_t *)matrix->matrix_mut);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    return final_ret;
+}
+
+int os_ledmatrix_enable_double_buffer(os_ledmatrix_t *matrix, uint32_t max_fps)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (matrix->flush != NULL || matrix->update_fun == NULL || matrix->palette != NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    os_ledmatrix_flush *flush = new os_ledmatrix_flush;
+    flush->front = (rgb_t *)malloc(matrix->width * matrix->height * sizeof(rgb_t));
+    if (flush->front == NULL)
+    {
+        delete flush;
+        return OS_RET_LOW_MEM_ERROR;
+    }
+
+    flush->x0 = matrix->width;
+    flush->y0 = matrix->height;
+    flush->x1 = -1;
+    flush->y1 = -1;
+    flush->clear = false;
+    flush->busy = false;
+    flush->pending = false;
+    flush->last_ret = OS_RET_OK;
+    flush->frame_period_us = max_fps == 0 ? 0 : 1000000 / max_fps;
+    flush->next_vsync_us = os_time_us() + flush->frame_period_us;
+    flush->frames_presented = 0;
+    flush->frames_dropped = 0;
+    flush->last_flush_us = 0;
+    flush->max_flush_us = 0;
+    flush->last_frame_interval_us = 0;
+    os_setbits_init(&flush->frame_ready);
+    os_setbits_init(&flush->frame_done);
+
+    int ret = os_mut_init(&flush->mutex);
+    if (ret != OS_RET_OK)
+    {
+        free(flush->front);
+        delete flush;
+        return ret;
+    }
+
+    ret = os_mut_entry_wait_indefinite((os_mut_t *)matrix->matrix_mut);
+    if (ret != OS_RET_OK)
+    {
+        free(flush->front);
+        delete flush;
+        return ret;
+    }
+
+    // Both buffers start out with whatever has been drawn so far, the first present sends it all
+    memcpy(flush->front, matrix->framebuffer, matrix->width * matrix->height * sizeof(rgb_t));
+    matrix->flush = flush;
+
+    return os_mut_exit((os_mut_t *)matrix->matrix_mut);
+}
+
+// Hands the back buffer to the flush thread, matrix and flush mutexes held and the flush thread not busy
+static void os_matrix_flush_swap(os_ledmatrix_t *matrix)
+{
+    os_ledmatrix_flush *flush = matrix->flush;
+    rgb_t *back = flush->front;
+    flush->front = matrix->framebuffer;
+    flush->x0 = matrix->dirty_x0;
+    flush->y0 = matrix->dirty_y0;
+    flush->x1 = matrix->dirty_x1;
+    flush->y1 = matrix->dirty_y1;
+    flush->clear = matrix->clear_pending;
+
+    // The old front buffer only differs from the new one by what was drawn this frame, so catch it up
+    if (flush->clear)
+    {
+        memset(back, 0, matrix->width * matrix->height * sizeof(rgb_t));
+    }
+    if (os_matrix_is_dirty(matrix))
+    {
+        int w = matrix->dirty_x1 - matrix->dirty_x0 + 1;
+        for (int y = matrix->dirty_y0; y <= matrix->dirty_y1; y++)
+        {
+            int offset = y * matrix->width + matrix->dirty_x0;
+            memcpy(&back[offset], &flush->front[offset], w * sizeof(rgb_t));
+        }
+    }
+
+    matrix->framebuffer = back;
+    matrix->clear_pending = false;
+    os_matrix_clear_dirty(matrix);
+
+    flush->frames_presented++;
+    flush->busy = true;
+}
+
+void os_ledmatrix_flush_thread(void *params)
+{
+    os_ledmatrix_t *matrix = (os_ledmatrix_t *)params;
+    if (matrix == NULL || matrix->flush == NULL)
+    {
+        return;
+    }
+
+    os_ledmatrix_flush *flush = matrix->flush;
+    int64_t last_start = os_time_us();
+    for (;;)
+    {
+        os_waitbits_indefinite(&flush->frame_ready, 0);
+        os_clearbits(&flush->frame_ready, 0);
+
+        // The front buffer is ours until busy is cleared, so no need for the matrix mutex here
+        int64_t start = os_time_us();
+        int ret = os_matrix_flush_mapped(matrix, flush->front, flush->x0, flush->y0, flush->x1, flush->y1, flush->clear);
+        if (ret == OS_RET_OK)
+        {
+            ret = matrix->update_fun(matrix->data_ptr);
+        }
+        int64_t end = os_time_us();
+
+        os_mut_entry_wait_indefinite(&flush->mutex);
+        uint32_t flush_us = (uint32_t)(end - start);
+        flush->last_flush_us = flush_us;
+        if (flush_us > flush->max_flush_us)
+        {
+            flush->max_flush_us = flush_us;
+        }
+        flush->last_frame_interval_us = (uint32_t)(start - last_start);
+        flush->last_ret = ret;
+        os_mut_exit(&flush->mutex);
+        last_start = start;
+
+        // Hold on to the front buffer until this frame's slot is over, that paces presents to max_fps
+        os_frame_clock_wait(&flush->next_vsync_us, flush->frame_period_us);
+
+        // Anything presented in the meantime goes straight out, busy stays set so wait_vsync waits for it too
+        os_mut_entry_wait_indefinite((os_mut_t *)matrix->matrix_mut);
+        os_mut_entry_wait_indefinite(&flush->mutex);
+        bool again = flush->pending && (os_matrix_is_dirty(matrix) || matrix->clear_pending);
+        flush->pending = false;
+        flush->busy = false;
+        if (again)
+        {
+            os_matrix_flush_swap(matrix);
+        }
+        os_mut_exit(&flush->mutex);
+        os_mut_exit((os_mut_t *)matrix->matrix_mut);
+
+        if (again)
+        {
+            os_setbits_signal(&flush->frame_ready, 0);
+        }
+        else
+        {
+            os_setbits_signal(&flush->frame_done, 0);
+        }
+    }
+}
+
+int os_ledmatrix_present(os_ledmatrix_t *matrix)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_ledmatrix_flush *flush = matrix->flush;
+    if (flush == NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_mut_entry_wait_indefinite((os_mut_t *)matrix->matrix_mut);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    ret = os_mut_entry_wait_indefinite(&flush->mutex);
+    if (ret != OS_RET_OK)
+    {
+        os_mut_exit((os_mut_t *)matrix->matrix_mut);
+        return ret;
+    }
+
+    bool start = false;
+    if (flush->busy)
+    {
+        // Still pushing the last frame, this one goes out as soon as the flush thread's slot is over
+        if (flush->pending)
+        {
+            flush->frames_dropped++;
+        }
+        flush->pending = true;
+    }
+    else if (os_matrix_is_dirty(matrix) || matrix->clear_pending)
+    {
+        os_clearbits(&flush->frame_done, 0);
+        os_matrix_flush_swap(matrix);
+        start = true;
+    }
+
+    ret = os_mut_exit(&flush->mutex);
+    if (start)
+    {
+        os_setbits_signal(&flush->frame_ready, 0);
+    }
+    if (ret != OS_RET_OK)
+    {
+        os_mut_exit((os_mut_t *)matrix->matrix_mut);
+        return ret;
+    }
+    return os_mut_exit((os_mut_t *)matrix->matrix_mut);
+}
+
+int os_ledmatrix_wait_vsync(os_ledmatrix_t *matrix)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_ledmatrix_flush *flush = matrix->flush;
+    if (flush == NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    for (;;)
+    {
+        int ret = os_mut_entry_wait_indefinite(&flush->mutex);
+        if (ret != OS_RET_OK)
+        {
+            return ret;
+        }
+        bool busy = flush->busy;
+        int last_ret = flush->last_ret;
+        ret = os_mut_exit(&flush->mutex);
+        if (ret != OS_RET_OK)
+        {
+            return ret;
+        }
+
+        if (!busy)
+        {
+            return last_ret;
+        }
+        os_waitbits_indefinite(&flush->frame_done, 0);
+    }
+}
+
+int os_ledmatrix_get_frame_stats(os_ledmatrix_t *matrix, os_ledmatrix_frame_stats_t *stats)
+{
+    if (matrix == NULL || stats == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_ledmatrix_flush *flush = matrix->flush;
+    if (flush == NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&flush->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    stats->frames_presented = flush->frames_presented;
+    stats->frames_dropped = flush->frames_dropped;
+    stats->last_flush_us = flush->last_flush_us;
+    stats->max_flush_us = flush->max_flush_us;
+    stats->last_frame_interval_us = flush->last_frame_interval_us;
+
+    return os_mut_exit(&flush->mutex);
+}
+
+int os_setpixel_ledmatrix_hsv_image(os_ledmatrix_t *matrix, hsv_t *hsv_range)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (matrix->palette != NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_mut_entry_wait_indefinite((os_mut_t *)matrix->matrix_mut);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // Columns are converted a chunk at a time, then spread down the framebuffer
+    rgb_t chunk[32];
+    for (int x = 0; x < matrix->width; x++)
+    {
+        for (int y = 0; y < matrix->height; y += 32)
+        {
+            int len = matrix->height - y < 32 ? matrix->height - y : 32;
+            hsv2rgb_n(&hsv_range[x * matrix->height + y], chunk, len);
+            for (int n = 0; n < len; n++)
+            {
+                matrix->framebuffer[(y + n) * matrix->width + x] = chunk[n];
+            }
+        }
+    }
+    os_matrix_mark_dirty(matrix, 0, 0, matrix->width - 1, matrix->height - 1);
+
+    return os_mut_exit((os_mut_t *)matrix->matrix_mut);
+}
+
+// Even-odd scanline fill, every row is sampled through the pixel centers
+static int os_matrix_fill_polygon(os_ledmatrix_t *matrix, const os_2d_point_t *points, int num_points, rgb_t rgb)
+{
+    int ymin = points[0].y;
+    int ymax = points[0].y;
+    for (int n = 1; n < num_points; n++)
+    {
+        if (points[n].y < ymin)
+            ymin = points[n].y;
+        if (points[n].y > ymax)
+            ymax = points[n].y;
+    }
+
+    // Only bother with the rows that are actually on the panel
+    if (ymin < 0)
+        ymin = 0;
+    if (ymax > matrix->height)
+        ymax = matrix->height;
+
+    int crossings[OS_LEDMATRIX_MAX_POLYGON_POINTS];
+    for (int y = ymin; y < ymax; y++)
+    {
+        int num_crossings = 0;
+        for (int n = 0; n < num_points; n++)
+        {
+            os_2d_point_t a = points[n];
+            os_2d_point_t b = points[(n + 1) == num_points ? 0 : n + 1];
+            if (a.y > b.y)
+            {
+                os_2d_point_t tmp = a;
+                a = b;
+                b = tmp;
+            }
+
+            // Row center is at y + 0.5 so it can never land right on a vertex
+            if (y < a.y || y >= b.y)
+            {
+                continue;
+            }
+
+            // First pixel whose center is at or right of where the edge crosses this row
+            int64_t dy = b.y - a.y;
+            int64_t num = (int64_t)(2 * (y - a.y) + 1) * (b.x - a.x);
+            int x = a.x + (int)os_matrix_ceil_div(num - dy, 2 * dy);
+
+            // Insertion sort, there's only ever a handful of crossings
+            int pos = num_crossings++;
+            while (pos > 0 && crossings[pos - 1] > x)
+            {
+                crossings[pos] = crossings[pos - 1];
+                pos--;
+            }
+            crossings[pos] = x;
+        }
+
+        for (int n = 0; n + 1 < num_crossings; n += 2)
+        {
+            os_matrix_fill_span(matrix, y, crossings[n], crossings[n + 1] - 1, rgb);
+        }
+    }
+
+    return OS_RET_OK;
+}
+
+int os_drawrect_ledmatrix(os_ledmatrix_t *matrix, os_2d_rect_t rect, rgb_t rgb, os_ledmatrix_fill_type_t fill_type)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if ((rect.w < 0) | (rect.h < 0) | ((fill_type != MATRIX_2D_FILL_OUTLINE) & (fill_type != MATRIX_2D_FILL_FULL)))
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int x1 = rect.x + rect.w - 1;
+    int y1 = rect.y + rect.h - 1;
+    if (fill_type == MATRIX_2D_FILL_FULL)
+    {
+        int y0 = rect.y < 0 ? 0 : rect.y;
+        int y_end = y1 >= matrix->height ? matrix->height - 1 : y1;
+        for (int y = y0; y <= y_end; y++)
+        {
+            os_matrix_fill_span(matrix, y, rect.x, x1, rgb);
+        }
+    }
+    else if ((rect.w > 0) & (rect.h > 0))
+    {
+        os_matrix_fill_span(matrix, rect.y, rect.x, x1, rgb);
+        os_matrix_fill_span(matrix, y1, rect.x, x1, rgb);
+        for (int y = rect.y + 1; y < y1; y++)
+        {
+            os_matrix_fb_set(matrix, rect.x, y, rgb);
+            os_matrix_fb_set(matrix, x1, y, rgb);
+        }
+    }
+
+    return os_matrix_unlock(matrix);
+}
+
+int os_filltriangle_ledmatrix(os_ledmatrix_t *matrix, os_2d_point_t p1, os_2d_point_t p2, os_2d_point_t p3, rgb_t rgb)
+{
+    os_2d_point_t points[3] = {p1, p2, p3};
+    return os_fillpolygon_ledmatrix(matrix, points, 3, rgb);
+}
+
+int os_fillpolygon_ledmatrix(os_ledmatrix_t *matrix, const os_2d_point_t *points, int num_points, rgb_t rgb)
+{
+    if (matrix == NULL || points == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if ((num_points < 3) | (num_points > OS_LEDMATRIX_MAX_POLYGON_POINTS))
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int final_ret = os_matrix_fill_polygon(matrix, points, num_points, rgb);
+
+    ret = os_matrix_unlock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    return final_ret;
+}
+
+int os_fillellipse_ledmatrix(os_ledmatrix_t *matrix, os_2d_point_t center, int rx, int ry, rgb_t rgb)
+{
+    if (matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if ((rx < 0) | (ry < 0))
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // Half width of every row rounded to the nearest pixel, rows off the panel are skipped
+    int dy_min = -ry;
+    int dy_max = ry;
+    if (center.y + dy_min < 0)
+        dy_min = -center.y;
+    if (center.y + dy_max >= matrix->height)
+        dy_max = matrix->height - 1 - center.y;
+
+    uint64_t rx2 = (uint64_t)rx * rx;
+    uint64_t ry2 = (uint64_t)ry * ry;
+    for (int dy = dy_min; dy <= dy_max; dy++)
+    {
+        uint64_t rem = rx2 * (ry2 - (uint64_t)dy * dy);
+        int half = ry == 0 ? rx : (int)os_matrix_isqrt(rem / ry2);
+        if (ry != 0 && (uint64_t)(2 * half + 1) * (2 * half + 1) * ry2 <= 4 * rem)
+        {
+            half++;
+        }
+        os_matrix_fill_span(matrix, center.y + dy, center.x - half, center.x + half, rgb);
+    }
+
+    return os_matrix_unlock(matrix);
+}
+
+static_assert(sizeof(rgb_t) == 3, "Sprite rows are copied straight into the framebuffer");
+
+/**
+ * Row loops below work on plain byte pointers with no calls or branches on the pixel values
+ * (apart from the color key), so the compiler is free to vectorize them
+ */
+static inline void os_matrix_blit_row_rgba(uint8_t *dst, const uint8_t *src, int w)
+{
+    for (int x = 0; x < w; x++)
+    {
+        dst[3 * x + 0] = src[4 * x + 0];
+        dst[3 * x + 1] = src[4 * x + 1];
+        dst[3 * x + 2] = src[4 * x + 2];
+    }
+}
+
+static inline void os_matrix_blit_row_key(uint8_t *dst, const uint8_t *src, int w, int bpp, rgb_t key)
+{
+    for (int x = 0; x < w; x++)
+    {
+        const uint8_t *p = &src[bpp * x];
+        if (p[0] != key.r || p[1] != key.g || p[2] != key.b)
+        {
+            dst[3 * x + 0] = p[0];
+            dst[3 * x + 1] = p[1];
+            dst[3 * x + 2] = p[2];
+        }
+    }
+}
+
+static inline void os_matrix_blit_row_alpha(uint8_t *dst, const uint8_t *src, int w, int bpp, uint8_t opacity, const rgb_t *key)
+{
+    for (int x = 0; x < w; x++)
+    {
+        const uint8_t *p = &src[bpp * x];
+        if (key != NULL && p[0] == key->r && p[1] == key->g && p[2] == key->b)
+        {
+            continue;
+        }
+
+        uint32_t a = opacity;
+        if (bpp == 4)
+        {
+            uint32_t t = p[3] * opacity + 128;
+            a = (t + (t >> 8)) >> 8;
+        }
+
+        for (int c = 0; c < 3; c++)
+        {
+            uint32_t t = dst[3 * x + c] * (255 - a) + p[c] * a + 128;
+            dst[3 * x + c] = (uint8_t)((t + (t >> 8)) >> 8);
+        }
+    }
+}
+
+int os_blit_sprite_ledmatrix(os_ledmatrix_t *matrix, const os_ledmatrix_sprite_t *sprite, os_ledmatrix_blit_t blit)
+{
+    if (matrix == NULL || sprite == NULL || sprite->pixels == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    // Rows are copied and blended straight into the framebuffer
+    if (matrix->palette != NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int bpp = sprite->format == MATRIX_SPRITE_RGBA ? 4 : 3;
+    int stride = sprite->stride == 0 ? sprite->width * bpp : sprite->stride;
+
+    // Whole sprite by default, then clip the source rect to the sprite
+    os_2d_rect_t src = blit.src;
+    if (src.w == 0 || src.h == 0)
+    {
+        src = {0, 0, sprite->width, sprite->height};
+    }
+    int dst_x = blit.dst.x;
+    int dst_y = blit.dst.y;
+    if (src.x < 0)
+    {
+        src.w += src.x;
+        dst_x -= src.x;
+        src.x = 0;
+    }
+    if (src.y < 0)
+    {
+        src.h += src.y;
+        dst_y -= src.y;
+        src.y = 0;
+    }
+    if (src.x + src.w > sprite->width)
+        src.w = sprite->width - src.x;
+    if (src.y + src.h > sprite->height)
+        src.h = sprite->height - src.y;
+
+    // ...and then to the panel
+    if (dst_x < 0)
+    {
+        src.x -= dst_x;
+        src.w += dst_x;
+        dst_x = 0;
+    }
+    if (dst_y < 0)
+    {
+        src.y -= dst_y;
+        src.h += dst_y;
+        dst_y = 0;
+    }
+    if (dst_x + src.w > matrix->width)
+        src.w = matrix->width - dst_x;
+    if (dst_y + src.h > matrix->height)
+        src.h = matrix->height - dst_y;
+
+    if (src.w <= 0 || src.h <= 0)
+    {
+        return OS_RET_OK;
+    }
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    for (int y = 0; y < src.h; y++)
+    {
+        const uint8_t *src_row = &sprite->pixels[(src.y + y) * stride + src.x * bpp];
+        uint8_t *dst_row = (uint8_t *)&matrix->framebuffer[(dst_y + y) * matrix->width + dst_x];
+
+        if (blit.flags & MATRIX_BLIT_ALPHA)
+        {
+            os_matrix_blit_row_alpha(dst_row, src_row, src.w, bpp, blit.opacity,
+                                     (blit.flags & MATRIX_BLIT_COLOR_KEY) ? &blit.color_key : NULL);
+        }
+        else if (blit.flags & MATRIX_BLIT_COLOR_KEY)
+        {
+            os_matrix_blit_row_key(dst_row, src_row, src.w, bpp, blit.color_key);
+        }
+        else if (bpp == 3)
+        {
+            memcpy(dst_row, src_row, src.w * sizeof(rgb_t));
+        }
+        else
+        {
+            os_matrix_blit_row_rgba(dst_row, src_row, src.w);
+        }
+    }
+    os_matrix_mark_dirty(matrix, dst_x, dst_y, dst_x + src.w - 1, dst_y + src.h - 1);
+
+    return os_matrix_unlock(matrix);
+}
+
+int os_ledmatrix_transform_init(os_ledmatrix_transform_t *transform, os_2d_point_t src_center, os_2d_point_t dst_center,
+                                float scale_x, float scale_y, float angle)
+{
+    if (transform == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (scale_x == 0.0f || scale_y == 0.0f)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    // Inverse of rotate(angle) * scale(scale_x, scale_y)
+    float c = cosf(angle);
+    float s = sinf(angle);
+    float du_dx = c / scale_x;
+    float du_dy = s / scale_x;
+    float dv_dx = -s / scale_y;
+    float dv_dy = c / scale_y;
+
+    // Pixel centers sit half a pixel in, u and v count from the center of the first sprite pixel
+    float dx = 0.5f - dst_center.x;
+    float dy = 0.5f - dst_center.y;
+    float u0 = du_dx * dx + du_dy * dy + src_center.x - 0.5f;
+    float v0 = dv_dx * dx + dv_dy * dy + src_center.y - 0.5f;
+
+    transform->u0 = (int32_t)lrintf(u0 * 65536.0f);
+    transform->v0 = (int32_t)lrintf(v0 * 65536.0f);
+    transform->du_dx = (int32_t)lrintf(du_dx * 65536.0f);
+    transform->du_dy = (int32_t)lrintf(du_dy * 65536.0f);
+    transform->dv_dx = (int32_t)lrintf(dv_dx * 65536.0f);
+    transform->dv_dy = (int32_t)lrintf(dv_dy * 65536.0f);
+
+    return OS_RET_OK;
+}
+
+// Narrows x0..x1 down to the x where lo <= start + step * x < hi
+static inline void os_matrix_clip_step(int64_t start, int64_t step, int64_t lo, int64_t hi, int *x0, int *x1)
+{
+    int64_t first;
+    int64_t last;
+    if (step == 0)
+    {
+        if (start >= lo && start < hi)
+        {
+            return;
+        }
+        first = 1;
+        last = 0;
+    }
+    else if (step > 0)
+    {
+        first = os_matrix_ceil_div(lo - start, step);
+        last = os_matrix_ceil_div(hi - start, step) - 1;
+    }
+    else
+    {
+        first = 1 - os_matrix_ceil_div(start - hi, step);
+        last = -os_matrix_ceil_div(start - lo, step);
+    }
+
+    if (first > *x0)
+        *x0 = first > *x1 ? *x1 + 1 : (int)first;
+    if (last < *x1)
+        *x1 = last < *x0 ? *x0 - 1 : (int)last;
+}
+
+// Blends 4 neighbouring sprite pixels, fx and fy are 8 bit fractions towards the right and bottom ones
+static inline void os_matrix_sample_bilinear(const uint8_t *p00, const uint8_t *p10, const uint8_t *p01, const uint8_t *p11,
+                                             uint32_t fx, uint32_t fy, int channels, uint8_t *out)
+{
+    for (int n = 0; n < channels; n++)
+    {
+        uint32_t top = p00[n] * (256 - fx) + p10[n] * fx;
+        uint32_t bottom = p01[n] * (256 - fx) + p11[n] * fx;
+        out[n] = (uint8_t)((top * (256 - fy) + bottom * fy + 32768) >> 16);
+    }
+}
+
+int os_blit_sprite_transformed_ledmatrix(os_ledmatrix_t *matrix, const os_ledmatrix_sprite_t *sprite,
+                                         const os_ledmatrix_transform_t *transform, os_ledmatrix_sample_t sample, uint8_t flags)
+{
+    if (matrix == NULL || sprite == NULL || sprite->pixels == NULL || transform == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (sprite->width <= 0 || sprite->height <= 0 || matrix->palette != NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int bpp = sprite->format == MATRIX_SPRITE_RGBA ? 4 : 3;
+    int stride = sprite->stride == 0 ? sprite->width * bpp : sprite->stride;
+    bool blend = (flags & MATRIX_BLIT_ALPHA) && bpp == 4;
+
+    // A matrix pixel gets drawn when its sample point lands on a sprite pixel
+    int64_t u_lo = -0x8000;
+    int64_t u_hi = ((int64_t)sprite->width << 16) - 0x8000;
+    int64_t v_lo = -0x8000;
+    int64_t v_hi = ((int64_t)sprite->height << 16) - 0x8000;
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int dirty_x0 = matrix->width;
+    int dirty_x1 = -1;
+    int dirty_y0 = matrix->height;
+    int dirty_y1 = -1;
+    for (int y = 0; y < matrix->height; y++)
+    {
+        int64_t u_row = transform->u0 + (int64_t)y * transform->du_dy;
+        int64_t v_row = transform->v0 + (int64_t)y * transform->dv_dy;
+
+        // Work out which part of the row lands on the sprite up front, no bounds checks per pixel
+        int x0 = 0;
+        int x1 = matrix->width - 1;
+        os_matrix_clip_step(u_row, transform->du_dx, u_lo, u_hi, &x0, &x1);
+        os_matrix_clip_step(v_row, transform->dv_dx, v_lo, v_hi, &x0, &x1);
+        if (x0 > x1)
+        {
+            continue;
+        }
+
+        int32_t u = (int32_t)(u_row + x0 * (int64_t)transform->du_dx);
+        int32_t v = (int32_t)(v_row + x0 * (int64_t)transform->dv_dx);
+        uint8_t *dst = (uint8_t *)&matrix->framebuffer[y * matrix->width + x0];
+        for (int x = x0; x <= x1; x++, dst += 3, u += transform->du_dx, v += transform->dv_dx)
+        {
+            uint8_t px[4];
+            const uint8_t *src;
+            if (sample == MATRIX_SAMPLE_BILINEAR)
+            {
+                // Neighbours past the edge of the sprite repeat the edge
+                int ix = u >> 16;
+                int iy = v >> 16;
+                int ix1 = ix + 1 < sprite->width ? ix + 1 : sprite->width - 1;
+                int iy1 = iy + 1 < sprite->height ? iy + 1 : sprite->height - 1;
+                if (ix < 0)
+                    ix = 0;
+                if (iy < 0)
+                    iy = 0;
+                const uint8_t *row0 = &sprite->pixels[iy * stride];
+                const uint8_t *row1 = &sprite->pixels[iy1 * stride];
+                os_matrix_sample_bilinear(&row0[ix * bpp], &row0[ix1 * bpp], &row1[ix * bpp], &row1[ix1 * bpp],
+                                          (u >> 8) & 0xFF, (v >> 8) & 0xFF, bpp, px);
+                src = px;
+            }
+            else
+            {
+                src = &sprite->pixels[((v + 0x8000) >> 16) * stride + ((u + 0x8000) >> 16) * bpp];
+            }
+
+            if (blend)
+            {
+                dst[0] = os_matrix_blend_channel(dst[0], src[0], src[3]);
+                dst[1] = os_matrix_blend_channel(dst[1], src[1], src[3]);
+                dst[2] = os_matrix_blend_channel(dst[2], src[2], src[3]);
+            }
+            else
+            {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+            }
+        }
+
+        if (x0 < dirty_x0)
+            dirty_x0 = x0;
+        if (x1 > dirty_x1)
+            dirty_x1 = x1;
+        if (y < dirty_y0)
+            dirty_y0 = y;
+        dirty_y1 = y;
+    }
+
+    if (dirty_x0 <= dirty_x1)
+    {
+        os_matrix_mark_dirty(matrix, dirty_x0, dirty_y0, dirty_x1, dirty_y1);
+    }
+
+    return os_matrix_unlock(matrix);
+}
+
+// Index of a character in the font tables
+static inline int os_matrix_glyph(char c)
+{
+    unsigned char ch = (unsigned char)c;
+    if (ch < MATRIX_FONT_FIRST_CHAR || ch > MATRIX_FONT_LAST_CHAR)
+    {
+        ch = '?';
+    }
+    return ch - MATRIX_FONT_FIRST_CHAR;
+}
+
+// Draws one character as runs of lit pixels, one span per run per pixel row
+static void os_matrix_draw_glyph(os_ledmatrix_t *matrix, int x, int y, int glyph, rgb_t rgb, int scale)
+{
+    const uint8_t *rows = matrix_font_rows.rows[glyph];
+    for (int row = 0; row < MATRIX_FONT_HEIGHT; row++)
+    {
+        uint8_t mask = rows[row];
+        int col = 0;
+        while (mask)
+        {
+            while (!(mask & 1))
+            {
+                mask >>= 1;
+                col++;
+            }
+            int start = col;
+            while (mask & 1)
+            {
+                mask >>= 1;
+                col++;
+            }
+
+            for (int n = 0; n < scale; n++)
+            {
+                os_matrix_fill_span(matrix, y + row * scale + n, x + start * scale, x + col * scale - 1, rgb);
+            }
+        }
+    }
+}
+
+int os_drawtext_ledmatrix(os_ledmatrix_t *matrix, os_2d_point_t pos, const char *text, rgb_t rgb, int scale)
+{
+    if (matrix == NULL || text == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (scale < 1)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int x = pos.x;
+    int y = pos.y;
+    for (const char *c = text; *c != '\0'; c++)
+    {
+        if (*c == '\n')
+        {
+            x = pos.x;
+            y += MATRIX_FONT_LINE_HEIGHT * scale;
+            continue;
+        }
+
+        // Characters completely off the panel are skipped
+        if (x < matrix->width && x + MATRIX_FONT_WIDTH * scale > 0 &&
+            y < matrix->height && y + MATRIX_FONT_HEIGHT * scale > 0)
+        {
+            os_matrix_draw_glyph(matrix, x, y, os_matrix_glyph(*c), rgb, scale);
+        }
+        x += MATRIX_FONT_ADVANCE * scale;
+    }
+
+    return os_matrix_unlock(matrix);
+}
+
+int os_textwidth_ledmatrix(const char *text, int scale)
+{
+    if (text == NULL || scale < 1)
+    {
+        return 0;
+    }
+
+    int longest = 0;
+    int chars = 0;
+    for (const char *c = text;; c++)
+    {
+        if (*c == '\n' || *c == '\0')
+        {
+            if (chars > longest)
+                longest = chars;
+            chars = 0;
+            if (*c == '\0')
+                break;
+            continue;
+        }
+        chars++;
+    }
+
+    if (longest == 0)
+    {
+        return 0;
+    }
+    // No spacing after the last character
+    return (longest * MATRIX_FONT_ADVANCE - 1) * scale;
+}
+
+int os_ledmatrix_marquee_init(os_ledmatrix_marquee_t *marquee, const char *text, os_2d_rect_t region, rgb_t fg, rgb_t bg, int scale)
+{
+    if (marquee == NULL || text == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (scale < 1 || region.w <= 0 || region.h <= 0)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    marquee->text = text;
+    marquee->text_len = (int)strlen(text);
+    marquee->region = region;
+    marquee->fg = fg;
+    marquee->bg = bg;
+    marquee->scale = scale;
+
+    // A region wide gap after the text so it has fully scrolled out before it comes back in
+    int text_width = marquee->text_len * MATRIX_FONT_ADVANCE * scale;
+    marquee->period = text_width + region.w;
+    // Start on the gap so the text scrolls in from the right
+    marquee->offset = text_width;
+    marquee->primed = false;
+
+    return OS_RET_OK;
+}
+
+// Renders a single column of the marquee region, rows are clipped to y0..y1
+static void os_matrix_marquee_column(os_ledmatrix_t *matrix, const os_ledmatrix_marquee_t *marquee, int x, int y0, int y1)
+{
+    int scale = marquee->scale;
+    int text_col = (marquee->offset + x - marquee->region.x) % marquee->period;
+    int font_col = text_col / scale;
+    int char_idx = font_col / MATRIX_FONT_ADVANCE;
+    int glyph_col = font_col % MATRIX_FONT_ADVANCE;
+
+    uint8_t bits = 0;
+    if (char_idx < marquee->text_len && glyph_col < MATRIX_FONT_WIDTH)
+    {
+        bits = matrix_font_columns[os_matrix_glyph(marquee->text[char_idx]) * MATRIX_FONT_WIDTH + glyph_col];
+    }
+
+    // Text is centered vertically in the region
+    int top = marquee->region.y + (marquee->region.h - MATRIX_FONT_HEIGHT * scale) / 2;
+    rgb_t *col = &matrix->framebuffer[y0 * matrix->width + x];
+    for (int y = y0; y <= y1; y++, col += matrix->width)
+    {
+        int font_row = y >= top ? (y - top) / scale : MATRIX_FONT_HEIGHT;
+        bool lit = font_row < MATRIX_FONT_HEIGHT && (bits & (1 << font_row));
+        *col = lit ? marquee->fg : marquee->bg;
+    }
+}
+
+int os_ledmatrix_marquee_step(os_ledmatrix_t *matrix, os_ledmatrix_marquee_t *marquee, int columns)
+{
+    if (matrix == NULL || marquee == NULL || marquee->text == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (columns < 0 || marquee->period <= 0 || matrix->palette != NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    // Part of the region that is actually on the panel
+    int x0 = marquee->region.x < 0 ? 0 : marquee->region.x;
+    int y0 = marquee->region.y < 0 ? 0 : marquee->region.y;
+    int x1 = marquee->region.x + marquee->region.w - 1;
+    int y1 = marquee->region.y + marquee->region.h - 1;
+    if (x1 >= matrix->width)
+        x1 = matrix->width - 1;
+    if (y1 >= matrix->height)
+        y1 = matrix->height - 1;
+
+    int ret = os_matrix_lock(matrix);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    marquee->offset = (int)(((int64_t)marquee->offset + columns) % marquee->period);
+    if (x0 > x1 || y0 > y1)
+    {
+        return os_matrix_unlock(matrix);
+    }
+
+    int visible = x1 - x0 + 1;
+    int first_new = x0;
+    if (marquee->primed && columns < visible)
+    {
+        // Everything already on screen just moves left, only the columns coming in on the right get drawn
+        first_new = x1 - columns + 1;
+        if (columns > 0)
+        {
+            for (int y = y0; y <= y1; y++)
+            {
+                rgb_t *row = &matrix->framebuffer[y * matrix->width];
+                memmove(&row[x0], &row[x0 + columns], (visible - columns) * sizeof(rgb_t));
+            }
+        }
+    }
+
+    for (int x = first_new; x <= x1; x++)
+    {
+        os_matrix_marquee_column(matrix, marquee, x, y0, y1);
+    }
+    marquee->primed = true;
+
+    if (columns > 0 || first_new == x0)
+    {
+        os_matrix_mark_dirty(matrix, x0, y0, x1, y1);
+    }
+
+    return os_matrix_unlock(matrix);
+}
+
+// Matrix with no backend behind it, used as a layer canvas
+static int os_matrix_init_offscreen(os_ledmatrix_t *matrix, int width, int height)
+{
+    memset(matrix, 0, sizeof(os_ledmatrix_t));
+    matrix->width = width;
+    matrix->height = height;
+
+    matrix->framebuffer = (rgb_t *)calloc(width * height, sizeof(rgb_t));
+    if (matrix->framebuffer == NULL)
+    {
+        return OS_RET_LOW_MEM_ERROR;
+    }
+    os_matrix_clear_dirty(matrix);
+
+    matrix->matrix_mut = malloc(sizeof(os_mut_t));
+    if (matrix->matrix_mut == NULL)
+    {
+        free(matrix->framebuffer);
+        return OS_RET_LOW_MEM_ERROR;
+    }
+    return os_mut_init((os_mut_t *)matrix->matrix_mut);
+}
+
+static inline int os_comp_lock(os_ledmatrix_compositor_t *comp)
+{
+    return os_mut_entry_wait_indefinite((os_mut_t *)comp->comp_mut);
+}
+
+static inline int os_comp_unlock(os_ledmatrix_compositor_t *comp)
+{
+    return os_mut_exit((os_mut_t *)comp->comp_mut);
+}
+
+static inline void os_comp_mark_dirty(os_ledmatrix_compositor_t *comp, int x0, int y0, int x1, int y1)
+{
+    if (x0 < comp->dirty_x0)
+        comp->dirty_x0 = x0;
+    if (y0 < comp->dirty_y0)
+        comp->dirty_y0 = y0;
+    if (x1 > comp->dirty_x1)
+        comp->dirty_x1 = x1;
+    if (y1 > comp->dirty_y1)
+        comp->dirty_y1 = y1;
+}
+
+static inline void os_comp_mark_all_dirty(os_ledmatrix_compositor_t *comp)
+{
+    os_comp_mark_dirty(comp, 0, 0, comp->output->width - 1, comp->output->height - 1);
+}
+
+// Puts a layer into the stack above every layer with the same or lower z
+static void os_comp_insert_layer(os_ledmatrix_compositor_t *comp, os_ledmatrix_layer_t *layer)
+{
+    os_ledmatrix_layer_t **link = &comp->layers;
+    while (*link != NULL && (*link)->z <= layer->z)
+    {
+        link = &(*link)->next;
+    }
+    layer->next = *link;
+    *link = layer;
+}
+
+static void os_comp_remove_layer(os_ledmatrix_compositor_t *comp, os_ledmatrix_layer_t *layer)
+{
+    os_ledmatrix_layer_t **link = &comp->layers;
+    while (*link != NULL && *link != layer)
+    {
+        link = &(*link)->next;
+    }
+    if (*link != NULL)
+    {
+        *link = layer->next;
+    }
+    layer->next = NULL;
+}
+
+int os_ledmatrix_compositor_init(os_ledmatrix_compositor_t *comp, os_ledmatrix_t *output)
+{
+    if (comp == NULL || output == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    comp->output = output;
+    comp->layers = NULL;
+    comp->dirty_x0 = output->width;
+    comp->dirty_y0 = output->height;
+    comp->dirty_x1 = -1;
+    comp->dirty_y1 = -1;
+
+    comp->comp_mut = malloc(sizeof(os_mut_t));
+    if (comp->comp_mut == NULL)
+    {
+        return OS_RET_LOW_MEM_ERROR;
+    }
+    return os_mut_init((os_mut_t *)comp->comp_mut);
+}
+
+int os_ledmatrix_layer_init(os_ledmatrix_compositor_t *comp, os_ledmatrix_layer_t *layer, int z)
+{
+    if (comp == NULL || layer == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_matrix_init_offscreen(&layer->canvas, comp->output->width, comp->output->height);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    layer->z = z;
+    layer->opacity = 255;
+    layer->visible = true;
+    layer->keyed = false;
+    layer->color_key = {0, 0, 0};
+    layer->next = NULL;
+
+    ret = os_comp_lock(comp);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // A fresh layer is all black and opaque, so it covers everything beneath it
+    os_comp_insert_layer(comp, layer);
+    os_comp_mark_all_dirty(comp);
+
+    return os_comp_unlock(comp);
+}
+
+int os_ledmatrix_layer_deinit(os_ledmatrix_compositor_t *comp, os_ledmatrix_layer_t *layer)
+{
+    if (comp == NULL || layer == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_comp_lock(comp);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // Whatever it covered has to be recomposited without it
+    os_comp_remove_layer(comp, layer);
+    if (layer->visible && layer->opacity > 0)
+    {
+        os_comp_mark_all_dirty(comp);
+    }
+
+    ret = os_comp_unlock(comp);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // Waits out anyone still drawing into it
+    os_ledmatrix_t *canvas = &layer->canvas;
+    ret = os_matrix_lock(canvas);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    ret = os_matrix_unlock(canvas);
+
+    free(canvas->framebuffer);
+    free(canvas->matrix_mut);
+    canvas->framebuffer = NULL;
+    canvas->matrix_mut = NULL;
+    return ret;
+}
+
+int os_ledmatrix_layer_set_z(os_ledmatrix_compositor_t *comp, os_ledmatrix_layer_t *layer, int z)
+{
+    if (comp == NULL || layer == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_comp_lock(comp);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    os_comp_remove_layer(comp, layer);
+    layer->z = z;
+    os_comp_insert_layer(comp, layer);
+    os_comp_mark_all_dirty(comp);
+
+    return os_comp_unlock(comp);
+}
+
+int os_ledmatrix_layer_set_opacity(os_ledmatrix_compositor_t *comp, os_ledmatrix_layer_t *layer, uint8_t opacity)
+{
+    if (comp == NULL || layer == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_comp_lock(comp);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    if (layer->opacity != opacity)
+    {
+        layer->opacity = opacity;
+        os_comp_mark_all_dirty(comp);
+    }
+
+    return os_comp_unlock(comp);
+}
+
+int os_ledmatrix_layer_set_visible(os_ledmatrix_compositor_t *comp, os_ledmatrix_layer_t *layer, bool visible)
+{
+    if (comp == NULL || layer == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_comp_lock(comp);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    if (layer->visible != visible)
+    {
+        layer->visible = visible;
+        os_comp_mark_all_dirty(comp);
+    }
+
+    return os_comp_unlock(comp);
+}
+
+int os_ledmatrix_layer_set_color_key(os_ledmatrix_compositor_t *comp, os_ledmatrix_layer_t *layer, bool keyed, rgb_t color_key)
+{
+    if (comp == NULL || layer == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_comp_lock(comp);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    layer->keyed = keyed;
+    layer->color_key = color_key;
+    os_comp_mark_all_dirty(comp);
+
+    return os_comp_unlock(comp);
+}
+
+// Puts a row of a layer over the row beneath it
+static void os_comp_blend_row(rgb_t *dst, const rgb_t *src, int w, const os_ledmatrix_layer_t *layer)
+{
+    if (!layer->keyed && layer->opacity == 255)
+    {
+        memcpy(dst, src, w * sizeof(rgb_t));
+        return;
+    }
+
+    rgb_t key = layer->color_key;
+    for (int x = 0; x < w; x++)
+    {
+        if (layer->keyed && src[x].r == key.r && src[x].g == key.g && src[x].b == key.b)
+        {
+            continue;
+        }
+
+        if (layer->opacity == 255)
+        {
+            dst[x] = src[x];
+        }
+        else
+        {
+            dst[x].r = os_matrix_blend_channel(dst[x].r, src[x].r, layer->opacity);
+            dst[x].g = os_matrix_blend_channel(dst[x].g, src[x].g, layer->opacity);
+            dst[x].b = os_matrix_blend_channel(dst[x].b, src[x].b, layer->opacity);
+        }
+    }
+}
+
+int os_ledmatrix_compose(os_ledmatrix_compositor_t *comp)
+{
+    if (comp == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    // Layers are blended straight into the output's framebuffer
+    if (comp->output->palette != NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_comp_lock(comp);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // Gather up everything the layers had drawn on, each layer is only locked long enough to take its dirty region
+    for (os_ledmatrix_layer_t *layer = comp->layers; layer != NULL; layer = layer->next)
+    {
+        os_ledmatrix_t *canvas = &layer->canvas;
+        ret = os_matrix_lock(canvas);
+        if (ret != OS_RET_OK)
+        {
+            os_comp_unlock(comp);
+            return ret;
+        }
+
+        if (os_matrix_is_dirty(canvas) && layer->visible && layer->opacity > 0)
+        {
+            os_comp_mark_dirty(comp, canvas->dirty_x0, canvas->dirty_y0, canvas->dirty_x1, canvas->dirty_y1);
+        }
+        os_matrix_clear_dirty(canvas);
+        canvas->clear_pending = false;
+        os_matrix_unlock(canvas);
+    }
+
+    int x0 = comp->dirty_x0;
+    int y0 = comp->dirty_y0;
+    int x1 = comp->dirty_x1;
+    int y1 = comp->dirty_y1;
+    comp->dirty_x0 = comp->output->width;
+    comp->dirty_y0 = comp->output->height;
+    comp->dirty_x1 = -1;
+    comp->dirty_y1 = -1;
+
+    // Nothing changed, nothing to send
+    if (x0 > x1 || y0 > y1)
+    {
+        return os_comp_unlock(comp);
+    }
+
+    os_ledmatrix_t *output = comp->output;
+    ret = os_matrix_lock(output);
+    if (ret != OS_RET_OK)
+    {
+        os_comp_unlock(comp);
+        return ret;
+    }
+
+    int w = x1 - x0 + 1;
+    for (int y = y0; y <= y1; y++)
+    {
+        memset(&output->framebuffer[y * output->width + x0], 0, w * sizeof(rgb_t));
+    }
+
+    // Bottom up, only the dirty region of each layer
+    for (os_ledmatrix_layer_t *layer = comp->layers; layer != NULL && ret == OS_RET_OK; layer = layer->next)
+    {
+        if (!layer->visible || layer->opacity == 0)
+        {
+            continue;
+        }
+
+        os_ledmatrix_t *canvas = &layer->canvas;
+        ret = os_matrix_lock(canvas);
+        if (ret != OS_RET_OK)
+        {
+            break;
+        }
+        for (int y = y0; y <= y1; y++)
+        {
+            os_comp_blend_row(&output->framebuffer[y * output->width + x0], &canvas->framebuffer[y * canvas->width + x0], w, layer);
+        }
+        ret = os_matrix_unlock(canvas);
+    }
+    os_matrix_mark_dirty(output, x0, y0, x1, y1);
+
+    os_matrix_unlock(output);
+    os_comp_unlock(comp);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    return os_ledmatrix_update(output);
+}
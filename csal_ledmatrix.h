@@ -27,6 +27,80 @@ typedef int (*os_matrix_setpixel_ptr)(void *ptr, int x, int y, uint8_t r, uint8_
  */
 typedef int (*os_matrix_update_ptr)(void *ptr);
 
+/**
+ * @brief Function pointer to push a rectangular region of pixels to the led matrix in one call
+ * @param void *ptr to whatever data struct holding the actual ledmatrix implementation data
+ * @param int x pos of the top left corner of the region
+ * @param int y pos of the top left corner of the region
+ * @param int w width of the region
+ * @param int h height of the region
+ * @param const rgb_t *buf pointer to the top left pixel of the region
+ * @param int stride number of pixels between the start of consecutive rows in buf
+ */
+typedef int (*os_matrix_blit_ptr)(void *ptr, int x, int y, int w, int h, const rgb_t *buf, int stride);
+
+/**
+ * @brief Function pointer to push full width rows of pixels to the led matrix in one call
+ * @param void *ptr to whatever data struct holding the actual ledmatrix implementation data
+ * @param int y first row to write
+ * @param int rows number of rows to write
+ * @param const rgb_t *buf rows * width contiguous pixels
+ */
+typedef int (*os_matrix_blit_rows_ptr)(void *ptr, int y, int rows, const rgb_t *buf);
+
+/**
+ * @brief Function pointer to fill a rectangular region of the led matrix with one color
+ * @param void *ptr to whatever data struct holding the actual ledmatrix implementation data
+ * @param int x pos of the top left corner of the region
+ * @param int y pos of the top left corner of the region
+ * @param int w width of the region
+ * @param int h height of the region
+ */
+typedef int (*os_matrix_fill_rect_ptr)(void *ptr, int x, int y, int w, int h, uint8_t r, uint8_t g, uint8_t b);
+
+/**
+ * @brief Function pointer to set the whole led matrix to zero
+ * @param void *ptr to whatever data struct holding the actual ledmatrix implementation data
+ */
+typedef int (*os_matrix_clear_ptr)(void *ptr);
+
+typedef enum os_ledmatrix_rotation
+{
+    MATRIX_ROTATE_0,
+    MATRIX_ROTATE_90, /**< Clockwise */
+    MATRIX_ROTATE_180,
+    MATRIX_ROTATE_270
+} os_ledmatrix_rotation_t;
+
+/**
+ * @brief How the logical display is laid out on the physical chain of LEDs
+ * @note With a mapping the backend gets pixels in chain order, pixel y * width + x is the
+ * (y * width + x)th LED down the chain
+ * @param int panel_width width of a single panel, 0 along with panel_height for one panel covering the whole display
+ * @param int panel_height height of a single panel
+ * @param int tiles_x panels across in the tile grid, 0 is the same as 1
+ * @param int tiles_y panels down in the tile grid, 0 is the same as 1
+ * @param bool serpentine every other row(or column) of a panel is wired back the other way
+ * @param bool column_major panels are wired column by column instead of row by row
+ * @param bool tile_serpentine every other row of panels is chained back the other way
+ * @param os_ledmatrix_rotation_t rotation rotation of the logical display on the panels
+ * @param bool mirror_x flips the logical display left to right
+ * @param bool mirror_y flips the logical display top to bottom
+ */
+typedef struct os_ledmatrix_mapping
+{
+    int panel_width;
+    int panel_height;
+    int tiles_x;
+    int tiles_y;
+    bool serpentine;
+    bool column_major;
+    bool tile_serpentine;
+    os_ledmatrix_rotation_t rotation;
+    bool mirror_x;
+    bool mirror_y;
+} os_ledmatrix_mapping_t;
+
 /**
  * @brief Populate these with the relevant matrix update commands
  * @param os_init_ledmatrix_ptr init_func: pointer to function that will initialize the led matrix
@@ -35,6 +109,11 @@ typedef int (*os_matrix_update_ptr)(void *ptr);
  * @param int width width of led matrix
  * @param int height height of led matrix
  * @param void *matrix_ptr pointer to data structure used for whatever eld matrix
+ * @param os_matrix_blit_ptr blit_func: (optional)pushes a whole region at once, setpixel_func is used when NULL
+ * @param os_matrix_blit_rows_ptr blit_rows_func: (optional)pushes full rows at once, used when there's no blit_func
+ * @param os_matrix_fill_rect_ptr fill_rect_func: (optional)fills a region with one color, used for runs of the same color when neither blit is there
+ * @param os_matrix_clear_ptr clear_func: (optional)clears the whole matrix, used after os_clear_ledmatrix
+ * @param const os_ledmatrix_mapping_t *mapping: (optional)panel layout, see os_ledmatrix_set_mapping()
  */
 typedef struct os_ledmatrix_init
 {
@@ -45,35 +124,231 @@ typedef struct os_ledmatrix_init
     int width;
     int height;
     void *matrix_ptr;
+
+    os_matrix_blit_ptr blit_func;
+    os_matrix_blit_rows_ptr blit_rows_func;
+    os_matrix_fill_rect_ptr fill_rect_func;
+    os_matrix_clear_ptr clear_func;
+    const os_ledmatrix_mapping_t *mapping;
 } os_ledmatrix_init_t;
 
+// Most corners os_fillpolygon_ledmatrix() will take
+#define OS_LEDMATRIX_MAX_POLYGON_POINTS 32
+
 typedef enum os_ledmatrix_fill_type
 {
     MATRIX_2D_FILL_OUTLINE,
     MATRIX_2D_FILL_FULL
 } os_ledmatrix_fill_type_t;
 
+typedef struct os_2d_point_t
+{
+    int x;
+    int y;
+} os_2d_point_t;
+
+typedef struct os_2d_rect_t
+{
+    int x;
+    int y;
+    int w;
+    int h;
+} os_2d_rect_t;
+
+typedef enum os_ledmatrix_sprite_format
+{
+    MATRIX_SPRITE_RGB, /**< 3 bytes per pixel, r g b */
+    MATRIX_SPRITE_RGBA /**< 4 bytes per pixel, r g b alpha */
+} os_ledmatrix_sprite_format_t;
+
+/**
+ * @brief Image that can be drawn onto the matrix
+ * @param const uint8_t *pixels row major pixel data
+ * @param os_ledmatrix_sprite_format_t format layout of each pixel
+ * @param int width width of the image in pixels
+ * @param int height height of the image in pixels
+ * @param int stride bytes between the start of each row, 0 if rows are tightly packed
+ */
+typedef struct os_ledmatrix_sprite
+{
+    const uint8_t *pixels;
+    os_ledmatrix_sprite_format_t format;
+    int width;
+    int height;
+    int stride;
+} os_ledmatrix_sprite_t;
+
+// Skip sprite pixels matching color_key
+#define MATRIX_BLIT_COLOR_KEY (1 << 0)
+// Blend the sprite over the matrix using its alpha channel(RGBA only) and opacity
+#define MATRIX_BLIT_ALPHA (1 << 1)
+
+/**
+ * @brief How a sprite gets drawn, zero initialized draws the whole sprite as is at 0,0
+ * @param os_2d_rect_t src region of the sprite to draw, a w or h of 0 draws all of it
+ * @param os_2d_point_t dst where the top left of src lands on the matrix
+ * @param uint8_t flags MATRIX_BLIT_ flags
+ * @param rgb_t color_key color left out with MATRIX_BLIT_COLOR_KEY
+ * @param uint8_t opacity of the whole sprite with MATRIX_BLIT_ALPHA, 255 for fully opaque
+ */
+typedef struct os_ledmatrix_blit
+{
+    os_2d_rect_t src;
+    os_2d_point_t dst;
+    uint8_t flags;
+    rgb_t color_key;
+    uint8_t opacity;
+} os_ledmatrix_blit_t;
+
+typedef enum os_ledmatrix_sample
+{
+    MATRIX_SAMPLE_NEAREST,
+    MATRIX_SAMPLE_BILINEAR
+} os_ledmatrix_sample_t;
+
+/**
+ * @brief Inverse affine transform in 16.16 fixed point, takes matrix pixels back to sprite pixels
+ * @note Fill in with os_ledmatrix_transform_init(), or directly for transforms it can't describe.
+ * Sprite pixel u, v(in pixels, 16.16) sampled for matrix pixel x, y is
+ * u = u0 + x * du_dx + y * du_dy
+ * v = v0 + x * dv_dx + y * dv_dy
+ */
+typedef struct os_ledmatrix_transform
+{
+    int32_t u0;
+    int32_t v0;
+    int32_t du_dx;
+    int32_t du_dy;
+    int32_t dv_dx;
+    int32_t dv_dy;
+} os_ledmatrix_transform_t;
+
+/**
+ * @brief Frame pacing and timing information for a double buffered matrix
+ */
+typedef struct os_ledmatrix_frame_stats
+{
+    uint32_t frames_presented;       /**< Frames handed over to the flush thread */
+    uint32_t frames_dropped;         /**< Presents overtaken by a later one before the flush thread got to them */
+    uint32_t last_flush_us;          /**< Time it took to push the last frame to the backend */
+    uint32_t max_flush_us;           /**< Longest time it took to push a frame to the backend */
+    uint32_t last_frame_interval_us; /**< Time between the last two frames pushed to the backend */
+} os_ledmatrix_frame_stats_t;
+
+// Size of a glyph in the built in font, before scaling
+#define MATRIX_FONT_WIDTH 5
+#define MATRIX_FONT_HEIGHT 7
+// Distance from one character to the next, and from one line of text to the next
+#define MATRIX_FONT_ADVANCE (MATRIX_FONT_WIDTH + 1)
+#define MATRIX_FONT_LINE_HEIGHT (MATRIX_FONT_HEIGHT + 1)
+
+/**
+ * @brief Text scrolling right to left through a region of the matrix, set up with os_ledmatrix_marquee_init()
+ * @note The marquee owns the region, whatever else is drawn there gets scrolled away with the text
+ */
+typedef struct os_ledmatrix_marquee
+{
+    const char *text;
+    int text_len;
+    os_2d_rect_t region;
+    rgb_t fg;
+    rgb_t bg;
+    int scale;
+
+    // Pixel columns in one pass of the text, blank gap included
+    int period;
+    // Column of the text that is at the left edge of the region
+    int offset;
+    // Whether the region has been drawn yet
+    bool primed;
+} os_ledmatrix_marquee_t;
+
+struct os_ledmatrix_flush;
+struct os_ledmatrix_palette;
+
 /**
  * @brief LED matrix handler
+ * @note All drawing goes into the framebuffer, only the dirty region is pushed to the backend on update
  */
 typedef struct os_ledmatrix
 {
     os_init_ledmatrix_ptr init_func;
     os_matrix_setpixel_ptr setpixel_func;
     os_matrix_update_ptr update_fun;
+    os_matrix_blit_ptr blit_func;
+    os_matrix_blit_rows_ptr blit_rows_func;
+    os_matrix_fill_rect_ptr fill_rect_func;
+    os_matrix_clear_ptr clear_func;
 
     void *data_ptr;
     int width;
     int height;
 
+    // Row major width * height pixels, NULL in palette mode
+    rgb_t *framebuffer;
+
+    // 4 or 8 bit palette indices standing in for the framebuffer, NULL unless os_ledmatrix_enable_palette() was called
+    struct os_ledmatrix_palette *palette;
+
+    // Inclusive bounds of everything drawn since the last update, empty when dirty_x0 > dirty_x1
+    int dirty_x0;
+    int dirty_y0;
+    int dirty_x1;
+    int dirty_y1;
+
+    // Framebuffer was cleared and the backend still needs its clear_func called
+    bool clear_pending;
+
+    // Front buffer and flush thread state, NULL unless double buffered
+    struct os_ledmatrix_flush *flush;
+
+    // Chain index of each framebuffer pixel, and the frame in chain order as the backend sees it, NULL unless mapped
+    uint32_t *map_lut;
+    rgb_t *map_buffer;
+
     void *matrix_mut;
 } os_ledmatrix_t;
 
-typedef struct os_2d_point_t
+/**
+ * @brief Layer of a compositor, draw into canvas with the usual os_ledmatrix functions
+ * @note Each canvas has its own mutex, so tasks drawing into different layers never wait on each other.
+ * Change z/opacity/visibility/color key through the os_ledmatrix_layer_set functions, not directly
+ */
+typedef struct os_ledmatrix_layer
 {
-    int x;
-    int y;
-} os_2d_point_t;
+    // Offscreen matrix the size of the output, never pushed to a backend itself
+    os_ledmatrix_t canvas;
+
+    int z;
+    uint8_t opacity;
+    bool visible;
+
+    // Pixels matching color_key let the layers underneath through
+    bool keyed;
+    rgb_t color_key;
+
+    // Next layer up
+    struct os_ledmatrix_layer *next;
+} os_ledmatrix_layer_t;
+
+/**
+ * @brief Stacks layers on top of each other into an output matrix
+ */
+typedef struct os_ledmatrix_compositor
+{
+    os_ledmatrix_t *output;
+
+    // Sorted from the bottom(lowest z) up
+    os_ledmatrix_layer_t *layers;
+
+    // Region that has to be recomposited no matter what the layers say, inclusive bounds, empty when x0 > x1
+    int dirty_x0;
+    int dirty_y0;
+    int dirty_x1;
+    int dirty_y1;
+
+    void *comp_mut;
+} os_ledmatrix_compositor_t;
 
 typedef struct os_2d_line_t
 {
@@ -104,13 +379,30 @@ int os_init_ledmatrix(os_ledmatrix_init_t matrix_init, os_ledmatrix_t *matrix);
 int os_setpixel_ledmatrix(os_ledmatrix_t *matrix, int x, int y, rgb_t rgb);
 
 /**
- * @brief Renders a line on the matrix
+ * @brief Renders a line on the matrix, in any direction and clipped to the panel
  * @param os_2d_line_t line
  * @param rgb_t line
  * @return successful
  */
 int os_drawline_ledmatrix(os_ledmatrix_t *matrix, os_2d_line_t line, rgb_t rgb);
 
+/**
+ * @brief Renders a line thickness pixels wide on the matrix, clipped to the panel
+ * @param os_2d_line_t line
+ * @param int thickness width of the line in pixels measured across it
+ * @param rgb_t line
+ * @return successful
+ */
+int os_drawline_ledmatrix_thick(os_ledmatrix_t *matrix, os_2d_line_t line, int thickness, rgb_t rgb);
+
+/**
+ * @brief Renders an anti-aliased line on the matrix, blended over what's already there
+ * @param os_2d_line_t line
+ * @param rgb_t line
+ * @return successful
+ */
+int os_drawline_ledmatrix_aa(os_ledmatrix_t *matrix, os_2d_line_t line, rgb_t rgb);
+
 /**
  * @brief Renders a line on the matrix
  * @param os_2d_line_t line
@@ -128,6 +420,47 @@ int os_drawline_ledmatrix_hsv(os_ledmatrix_t *matrix, os_2d_line_t line, hsv_t h
  */
 int os_drawcircle_ledmatrix(os_ledmatrix_t *matrix, os_2d_circle_t circle, rgb_t rgb, os_ledmatrix_fill_type_t fill_type);
 
+/**
+ * @brief Renders a rectangle on the matrix, clipped to the panel
+ * @param os_ledmatrix_t *matrix
+ * @param os_2d_rect_t rect top left corner and size in pixels
+ * @param rgb_t rgb color structure
+ * @returns os return status
+ */
+int os_drawrect_ledmatrix(os_ledmatrix_t *matrix, os_2d_rect_t rect, rgb_t rgb, os_ledmatrix_fill_type_t fill_type);
+
+/**
+ * @brief Fills a triangle on the matrix, see os_fillpolygon_ledmatrix()
+ * @param os_ledmatrix_t *matrix
+ * @param os_2d_point_t p1, p2, p3 corners of the triangle
+ * @param rgb_t rgb color structure
+ * @returns os return status
+ */
+int os_filltriangle_ledmatrix(os_ledmatrix_t *matrix, os_2d_point_t p1, os_2d_point_t p2, os_2d_point_t p3, rgb_t rgb);
+
+/**
+ * @brief Fills a convex or concave polygon on the matrix using the even-odd rule, clipped to the panel
+ * @note Corners sit on pixel corners and pixels are filled when their center is inside, so
+ * (0,0) (4,0) (4,4) (0,4) covers 4x4 pixels and polygons sharing an edge never overlap
+ * @param os_ledmatrix_t *matrix
+ * @param const os_2d_point_t *points corners of the polygon, in order
+ * @param int num_points between 3 and OS_LEDMATRIX_MAX_POLYGON_POINTS
+ * @param rgb_t rgb color structure
+ * @returns os return status
+ */
+int os_fillpolygon_ledmatrix(os_ledmatrix_t *matrix, const os_2d_point_t *points, int num_points, rgb_t rgb);
+
+/**
+ * @brief Fills an ellipse on the matrix, clipped to the panel
+ * @param os_ledmatrix_t *matrix
+ * @param os_2d_point_t center pixel
+ * @param int rx horizontal radius in pixels
+ * @param int ry vertical radius in pixels
+ * @param rgb_t rgb color structure
+ * @returns os return status
+ */
+int os_fillellipse_ledmatrix(os_ledmatrix_t *matrix, os_2d_point_t center, int rx, int ry, rgb_t rgb);
+
 /**
  * @brief Checks if line flows from left to right
  * @param os_2d_line_t line
@@ -151,21 +484,259 @@ int os_setpixel_ledmatrix_hsv(os_ledmatrix_t *matrix, int x, int y, hsv_t hsv);
 /**
  * @brief Set pixel ledmatrix all in one(prevents too much wasted time spent unlocking and locking mutexes)
  * @param os_ledmatrix_t *matrix that we want to initialize
- * @param int x pos
- * @param int y pos
- * @param hsv_t col color
+ * @param hsv_t *hsv_range width * height colors, column major so pixel x,y is at x * height + y
  */
 int os_setpixel_ledmatrix_hsv_image(os_ledmatrix_t *matrix, hsv_t *hsv_range);
 
 /**
- * @brief Updates the ledmatrix
+ * @brief Draws a sprite onto the matrix, clipped to both the sprite and the panel
+ * @param os_ledmatrix_t *matrix that we are drawing on
+ * @param const os_ledmatrix_sprite_t *sprite image we are drawing
+ * @param os_ledmatrix_blit_t blit which part of the sprite goes where, and how it's mixed in
+ */
+int os_blit_sprite_ledmatrix(os_ledmatrix_t *matrix, const os_ledmatrix_sprite_t *sprite, os_ledmatrix_blit_t blit);
+
+/**
+ * @brief Sets up a transform that scales then rotates a sprite around a point and puts that point somewhere on the matrix
+ * @note Only this setup uses floating point, drawing with the transform is all fixed point
+ * @param os_ledmatrix_transform_t *transform that we are setting up
+ * @param os_2d_point_t src_center point of the sprite everything happens around, in pixels from its top left corner
+ * @param os_2d_point_t dst_center where src_center lands on the matrix, in pixels from its top left corner
+ * @param float scale_x horizontal scale, can't be 0
+ * @param float scale_y vertical scale, can't be 0
+ * @param float angle clockwise rotation in radians
+ */
+int os_ledmatrix_transform_init(os_ledmatrix_transform_t *transform, os_2d_point_t src_center, os_2d_point_t dst_center,
+                                float scale_x, float scale_y, float angle);
+
+/**
+ * @brief Draws a sprite scaled/rotated/translated onto the matrix
+ * @note Only the matrix pixels landing on the sprite are touched
+ * @param os_ledmatrix_t *matrix that we are drawing on
+ * @param const os_ledmatrix_sprite_t *sprite image we are drawing
+ * @param const os_ledmatrix_transform_t *transform where each matrix pixel samples the sprite
+ * @param os_ledmatrix_sample_t sample how the sprite is sampled
+ * @param uint8_t flags MATRIX_BLIT_ALPHA blends RGBA sprites using their alpha channel, the rest are ignored
+ */
+int os_blit_sprite_transformed_ledmatrix(os_ledmatrix_t *matrix, const os_ledmatrix_sprite_t *sprite,
+                                         const os_ledmatrix_transform_t *transform, os_ledmatrix_sample_t sample, uint8_t flags);
+
+/**
+ * @brief Draws text with the built in 5x7 font, '\n' starts a new line
+ * @note Only lit pixels are drawn, characters outside printable ascii show up as '?'
+ * @param os_ledmatrix_t *matrix that we are drawing on
+ * @param os_2d_point_t pos top left of the first character
+ * @param const char *text null terminated string
+ * @param rgb_t rgb color
+ * @param int scale each font pixel becomes a scale x scale block
+ */
+int os_drawtext_ledmatrix(os_ledmatrix_t *matrix, os_2d_point_t pos, const char *text, rgb_t rgb, int scale);
+
+/**
+ * @brief Width in pixels of the longest line of text, as drawn by os_drawtext_ledmatrix()
+ * @param const char *text null terminated string
+ * @param int scale same scale passed to os_drawtext_ledmatrix()
+ */
+int os_textwidth_ledmatrix(const char *text, int scale);
+
+/**
+ * @brief Sets up a marquee, the text has to stay around for as long as the marquee is used
+ * @param os_ledmatrix_marquee_t *marquee that we are setting up
+ * @param const char *text single line of text to scroll
+ * @param os_2d_rect_t region of the matrix the text scrolls through
+ * @param rgb_t fg text color
+ * @param rgb_t bg background color
+ * @param int scale each font pixel becomes a scale x scale block
+ */
+int os_ledmatrix_marquee_init(os_ledmatrix_marquee_t *marquee, const char *text, os_2d_rect_t region, rgb_t fg, rgb_t bg, int scale);
+
+/**
+ * @brief Scrolls the marquee left, the first step draws the whole region
+ * @note Only the columns scrolling into the region are rendered, the rest of the region is shifted over
+ * @param os_ledmatrix_t *matrix that the marquee is drawn on
+ * @param os_ledmatrix_marquee_t *marquee that we are scrolling
+ * @param int columns how many pixel columns to scroll by
+ */
+int os_ledmatrix_marquee_step(os_ledmatrix_t *matrix, os_ledmatrix_marquee_t *marquee, int columns);
+
+/**
+ * @brief Builds the lookup table from logical pixels to their place on the physical chain
+ * @note Has to be set before os_ledmatrix_enable_double_buffer(), NULL goes back to unmapped
+ * @param os_ledmatrix_t *matrix that we are mapping
+ * @param const os_ledmatrix_mapping_t *mapping panel layout, tiles * panel size(rotated) has to match the matrix size
+ */
+int os_ledmatrix_set_mapping(os_ledmatrix_t *matrix, const os_ledmatrix_mapping_t *mapping);
+
+/**
+ * @brief Updates the ledmatrix, only pixels changed since the last update are sent to the backend
+ * @note Same as os_ledmatrix_present() once the matrix is double buffered
  * @param os_ledmatrix_t *matrix that we want to initialize
  */
 int os_ledmatrix_update(os_ledmatrix_t *matrix);
 
+/**
+ * @brief Gives the matrix a front buffer so drawing the next frame never waits on pushing the current one
+ * @note os_ledmatrix_flush_thread() needs to be running for frames to reach the backend
+ * @param os_ledmatrix_t *matrix that we want to double buffer
+ * @param uint32_t max_fps frames pushed per second at most, 0 to push frames as soon as they are presented
+ */
+int os_ledmatrix_enable_double_buffer(os_ledmatrix_t *matrix, uint32_t max_fps);
+
+/**
+ * @brief Flush thread! Waits for presented frames and pushes them to the backend, paced to max_fps
+ * @param void *params pointer to the double buffered os_ledmatrix_t
+ */
+void os_ledmatrix_flush_thread(void *params);
+
+/**
+ * @brief Swaps the finished back buffer to the front and hands it to the flush thread
+ * @note Doesn't block, if the previous frame is still being pushed this one goes out as soon as it's done.
+ * Presenting again before then folds both into one frame and counts the earlier one as dropped
+ * @param os_ledmatrix_t *matrix that we want to present
+ */
+int os_ledmatrix_present(os_ledmatrix_t *matrix);
+
+/**
+ * @brief Blocks until the last presented frame has been pushed and its frame slot is over
+ * @param os_ledmatrix_t *matrix that we are waiting on
+ * @return return value of pushing the last frame to the backend
+ */
+int os_ledmatrix_wait_vsync(os_ledmatrix_t *matrix);
+
+/**
+ * @brief Gets the frame timing of a double buffered matrix
+ * @param os_ledmatrix_t *matrix that we want the timing of
+ * @param os_ledmatrix_frame_stats_t *stats filled in with the current timing
+ */
+int os_ledmatrix_get_frame_stats(os_ledmatrix_t *matrix, os_ledmatrix_frame_stats_t *stats);
+
+/**
+ * @brief Sets up a compositor drawing into output, it's the only thing that should draw on output from now on
+ * @param os_ledmatrix_compositor_t *comp that we are setting up
+ * @param os_ledmatrix_t *output initialized matrix the layers end up on
+ */
+int os_ledmatrix_compositor_init(os_ledmatrix_compositor_t *comp, os_ledmatrix_t *output);
+
+/**
+ * @brief Gives the layer a canvas the size of the output and adds it to the compositor, visible and fully opaque
+ * @note Layers with the same z stack in the order they were added
+ * @param os_ledmatrix_compositor_t *comp that we are adding to
+ * @param os_ledmatrix_layer_t *layer that we are adding, has to stay around until os_ledmatrix_layer_deinit
+ * @param int z higher z goes on top
+ */
+int os_ledmatrix_layer_init(os_ledmatrix_compositor_t *comp, os_ledmatrix_layer_t *layer, int z);
+
+/**
+ * @brief Takes the layer out of the compositor and frees its canvas
+ * @note Nothing may draw into the canvas from here on, call os_ledmatrix_layer_init again to reuse the layer
+ * @param os_ledmatrix_compositor_t *comp the layer is in
+ * @param os_ledmatrix_layer_t *layer that we are removing
+ */
+int os_ledmatrix_layer_deinit(os_ledmatrix_compositor_t *comp, os_ledmatrix_layer_t *layer);
+
+/**
+ * @brief Moves a layer up or down the stack
+ * @param os_ledmatrix_compositor_t *comp the layer is in
+ * @param os_ledmatrix_layer_t *layer that we are moving
+ * @param int z higher z goes on top
+ */
+int os_ledmatrix_layer_set_z(os_ledmatrix_compositor_t *comp, os_ledmatrix_layer_t *layer, int z);
+
+/**
+ * @brief Sets how much of a layer shows over the ones beneath it
+ * @param os_ledmatrix_compositor_t *comp the layer is in
+ * @param os_ledmatrix_layer_t *layer that we are changing
+ * @param uint8_t opacity 255 for fully opaque, 0 for invisible
+ */
+int os_ledmatrix_layer_set_opacity(os_ledmatrix_compositor_t *comp, os_ledmatrix_layer_t *layer, uint8_t opacity);
+
+/**
+ * @brief Shows or hides a layer
+ * @param os_ledmatrix_compositor_t *comp the layer is in
+ * @param os_ledmatrix_layer_t *layer that we are changing
+ * @param bool visible
+ */
+int os_ledmatrix_layer_set_visible(os_ledmatrix_compositor_t *comp, os_ledmatrix_layer_t *layer, bool visible);
+
+/**
+ * @brief Makes pixels of one color in the layer see through
+ * @param os_ledmatrix_compositor_t *comp the layer is in
+ * @param os_ledmatrix_layer_t *layer that we are changing
+ * @param bool keyed whether color_key is see through
+ * @param rgb_t color_key the see through color, usually black
+ */
+int os_ledmatrix_layer_set_color_key(os_ledmatrix_compositor_t *comp, os_ledmatrix_layer_t *layer, bool keyed, rgb_t color_key);
+
+/**
+ * @brief Composites everything that changed since the last call into the output, then updates the output
+ * @note Only the regions drawn on since the last call get recomposited, nothing at all happens when no layer changed
+ * @param os_ledmatrix_compositor_t *comp that we are compositing
+ */
+int os_ledmatrix_compose(os_ledmatrix_compositor_t *comp);
+
 /**
  * @brief Clears the ledmatrix or sets it to zero
+ * @note In palette mode pixels get the palette entry closest to black
  * @param os_ledmatrix_t *matrix that we want to initialize
  */
 int os_clear_ledmatrix(os_ledmatrix_t *matrix);
+
+/**
+ * @brief Replaces the framebuffer with a palette index per pixel, 4 bits for up to 16 colors or 8 bits for up to 256.
+ * Indices only become colors a row at a time as the dirty region goes out on update
+ * @note Whatever was drawn so far is carried over as the closest palette colors. Lines, shapes, text and
+ * pixels keep working with any color and get the closest palette entry. Antialiased lines, sprites,
+ * marquees, hsv images and compositing need real colors and return OS_RET_INVALID_PARAM from here on.
+ * Can't be double buffered or a layer canvas, a mapped matrix still keeps its full size chain order buffer
+ * @param os_ledmatrix_t *matrix that we are switching over
+ * @param uint8_t bits per pixel, 4 or 8
+ * @param const rgb_t *colors starting palette
+ * @param int num_colors number of colors, at most 16 for 4 bits. Entries past these start out black
+ */
+int os_ledmatrix_enable_palette(os_ledmatrix_t *matrix, uint8_t bits, const rgb_t *colors, int num_colors);
+
+/**
+ * @brief Replaces a run of palette entries, the whole matrix is sent again on the next update
+ * @param os_ledmatrix_t *matrix in palette mode
+ * @param uint8_t first entry to replace
+ * @param const rgb_t *colors new colors
+ * @param int count number of entries to replace
+ */
+int os_ledmatrix_set_palette(os_ledmatrix_t *matrix, uint8_t first, const rgb_t *colors, int count);
+
+/**
+ * @brief Same as os_ledmatrix_set_palette() but from hsv colors
+ * @param os_ledmatrix_t *matrix in palette mode
+ * @param uint8_t first entry to replace
+ * @param const hsv_t *colors new colors
+ * @param int count number of entries to replace
+ */
+int os_ledmatrix_set_palette_hsv(os_ledmatrix_t *matrix, uint8_t first, const hsv_t *colors, int count);
+
+/**
+ * @brief Rotates a run of palette entries, steps entries up(negative for down) with wraparound,
+ * so plasma and color cycling effects animate without redrawing a single pixel
+ * @param os_ledmatrix_t *matrix in palette mode
+ * @param uint8_t first entry of the run
+ * @param int count number of entries in the run
+ * @param int steps how far to rotate, entry first + n gets the color of first + (n - steps) mod count
+ */
+int os_ledmatrix_rotate_palette(os_ledmatrix_t *matrix, uint8_t first, int count, int steps);
+
+/**
+ * @brief Sets a pixel to a palette entry
+ * @param os_ledmatrix_t *matrix in palette mode
+ * @param int x pos
+ * @param int y pos
+ * @param uint8_t index palette entry to use
+ */
+int os_setpixel_ledmatrix_index(os_ledmatrix_t *matrix, int x, int y, uint8_t index);
+
+/**
+ * @brief Fills a rectangle with a palette entry, clipped to the panel
+ * @param os_ledmatrix_t *matrix in palette mode
+ * @param os_2d_rect_t rect area to fill
+ * @param uint8_t index palette entry to use
+ */
+int os_fillrect_ledmatrix_index(os_ledmatrix_t *matrix, os_2d_rect_t rect, uint8_t index);
 #endif
\ No newline at end of file
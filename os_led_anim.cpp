@@ -0,0 +1,525 @@
+#include "os_led_anim.h"
+#include "global_includes.h"
+#include "string.h"
+#include "os_time.h"
+
+// Pixels rendered at a time before being handed to the strip or matrix
+#define LED_ANIM_CHUNK 64
+
+/**
+ * One stretch between two keyframes, times in 16.16 fixed point ms
+ * recip turns a distance into the stretch into a 16 bit blend factor with a multiply instead of a divide
+ */
+typedef struct os_led_anim_seg
+{
+    int index;
+    uint64_t start;
+    uint64_t end;
+    uint64_t recip;
+    rgb_t from;
+    rgb_t to;
+} os_led_anim_seg_t;
+
+static void os_led_anim_seg_load(const os_led_anim_t *anim, int index, os_led_anim_seg_t *seg)
+{
+    const os_led_keyframe_t *keyframes = anim->keyframes;
+    bool last = index == anim->num_keyframes - 1;
+    uint32_t start = keyframes[index].time_ms;
+    uint32_t end = last ? anim->duration_ms : keyframes[index + 1].time_ms;
+
+    seg->index = index;
+    seg->start = (uint64_t)start << 16;
+    seg->end = (uint64_t)end << 16;
+    seg->recip = end > start ? ((uint64_t)1 << 32) / (end - start) : 0;
+    seg->from = keyframes[index].color;
+    // Looping blends back into the first keyframe, otherwise the last one is held
+    seg->to = !last ? keyframes[index + 1].color : anim->loop ? keyframes[0].color : seg->from;
+}
+
+static inline rgb_t os_led_anim_lerp(rgb_t a, rgb_t b, int32_t frac)
+{
+    rgb_t col;
+    col.r = (uint8_t)(a.r + ((((int32_t)b.r - a.r) * frac) >> 16));
+    col.g = (uint8_t)(a.g + ((((int32_t)b.g - a.g) * frac) >> 16));
+    col.b = (uint8_t)(a.b + ((((int32_t)b.b - a.b) * frac) >> 16));
+    return col;
+}
+
+static inline rgb_t os_led_anim_seg_color(const os_led_anim_seg_t *seg, uint64_t pos)
+{
+    uint64_t frac = ((pos - seg->start) * seg->recip) >> 32;
+    return os_led_anim_lerp(seg->from, seg->to, frac > 0xFFFF ? 0xFFFF : (int32_t)frac);
+}
+
+// Animation time with looping and holding at the end sorted out
+static uint32_t os_led_anim_local_time(const os_led_anim_t *anim, uint32_t time_ms)
+{
+    if (anim->loop)
+    {
+        return time_ms % anim->duration_ms;
+    }
+    return time_ms < anim->duration_ms ? time_ms : anim->duration_ms - 1;
+}
+
+// Finds the stretch pos(16.16 ms) lands in
+static void os_led_anim_seg_find(const os_led_anim_t *anim, uint64_t pos, os_led_anim_seg_t *seg)
+{
+    int index = 0;
+    while (index + 1 < anim->num_keyframes && ((uint64_t)anim->keyframes[index + 1].time_ms << 16) <= pos)
+    {
+        index++;
+    }
+    os_led_anim_seg_load(anim, index, seg);
+}
+
+/**
+ * Walks along the palette for gradients, one pixel after another
+ * Palette position of pixel p is p * step back from the current time, so the pattern flows away from the first pixel
+ */
+typedef struct os_led_anim_walk
+{
+    os_led_anim_seg_t seg;
+    uint64_t pos;
+    uint64_t step;
+    uint64_t total;
+} os_led_anim_walk_t;
+
+static void os_led_anim_walk_init(const os_led_anim_t *anim, uint32_t time_ms, uint32_t count, os_led_anim_walk_t *walk)
+{
+    walk->total = (uint64_t)anim->duration_ms << 16;
+    walk->step = walk->total / count;
+    walk->pos = (walk->total - ((uint64_t)os_led_anim_local_time(anim, time_ms) << 16)) % walk->total;
+    os_led_anim_seg_find(anim, walk->pos, &walk->seg);
+}
+
+static void os_led_anim_walk(const os_led_anim_t *anim, os_led_anim_walk_t *walk, rgb_t *out, uint32_t len)
+{
+    for (uint32_t n = 0; n < len; n++)
+    {
+        // Empty stretches get skipped right over
+        while (walk->pos >= walk->seg.end)
+        {
+            if (walk->seg.index == anim->num_keyframes - 1)
+            {
+                walk->pos -= walk->total;
+                os_led_anim_seg_load(anim, 0, &walk->seg);
+            }
+            else
+            {
+                os_led_anim_seg_load(anim, walk->seg.index + 1, &walk->seg);
+            }
+        }
+
+        out[n] = os_led_anim_seg_color(&walk->seg, walk->pos);
+        walk->pos += walk->step;
+    }
+}
+
+static int os_led_anim_check(const os_led_anim_t *anim)
+{
+    if (anim->keyframes == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (anim->num_keyframes < 1 || anim->duration_ms == 0 || anim->keyframes[0].time_ms != 0 ||
+        (anim->mode != LED_ANIM_FILL && anim->mode != LED_ANIM_GRADIENT))
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    for (int n = 1; n < anim->num_keyframes; n++)
+    {
+        if (anim->keyframes[n].time_ms < anim->keyframes[n - 1].time_ms)
+        {
+            return OS_RET_INVALID_PARAM;
+        }
+    }
+
+    if (anim->keyframes[anim->num_keyframes - 1].time_ms >= anim->duration_ms)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+    return OS_RET_OK;
+}
+
+static void os_led_anim_init(os_led_anim_t *anim, const os_led_keyframe_t *keyframes, int num_keyframes, uint32_t duration_ms,
+                             os_led_anim_mode_t mode)
+{
+    memset(anim, 0, sizeof(os_led_anim_t));
+    anim->keyframes = keyframes;
+    anim->num_keyframes = num_keyframes;
+    anim->duration_ms = duration_ms;
+    anim->mode = mode;
+    anim->loop = true;
+}
+
+#ifdef OS_LED_STRIP
+int os_led_anim_init_strip(os_led_anim_t *anim, const os_led_keyframe_t *keyframes, int num_keyframes, uint32_t duration_ms,
+                           os_led_anim_mode_t mode, os_led_strip_t *strip, uint32_t offset, uint32_t count)
+{
+    if (anim == NULL || strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_led_anim_init(anim, keyframes, num_keyframes, duration_ms, mode);
+    anim->target_type = LED_ANIM_TARGET_STRIP;
+    anim->strip = strip;
+    anim->offset = offset;
+    anim->count = count;
+
+    if (count == 0 || offset > (uint32_t)strip->numpixel || count > (uint32_t)strip->numpixel - offset)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+    return os_led_anim_check(anim);
+}
+#endif
+
+int os_led_anim_init_matrix(os_led_anim_t *anim, const os_led_keyframe_t *keyframes, int num_keyframes, uint32_t duration_ms,
+                            os_led_anim_mode_t mode, os_ledmatrix_t *matrix, os_2d_rect_t rect)
+{
+    if (anim == NULL || matrix == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_led_anim_init(anim, keyframes, num_keyframes, duration_ms, mode);
+    anim->target_type = LED_ANIM_TARGET_MATRIX;
+    anim->matrix = matrix;
+    anim->rect = rect;
+
+    if (rect.w <= 0 || rect.h <= 0)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+    return os_led_anim_check(anim);
+}
+
+int os_led_anim_render(os_led_anim_t *anim, uint32_t time_ms)
+{
+    if (anim == NULL || anim->keyframes == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    // One color for the whole target, let the strip/matrix fill it
+    if (anim->mode == LED_ANIM_FILL)
+    {
+        os_led_anim_seg_t seg;
+        uint64_t pos = (uint64_t)os_led_anim_local_time(anim, time_ms) << 16;
+        os_led_anim_seg_find(anim, pos, &seg);
+        rgb_t col = os_led_anim_seg_color(&seg, pos);
+
+#ifdef OS_LED_STRIP
+        if (anim->target_type == LED_ANIM_TARGET_STRIP)
+        {
+            if (anim->count == 1)
+            {
+                return os_led_strip_set_rgb(anim->strip, anim->offset, col);
+            }
+            return os_led_strip_fill_rgb_range(anim->strip, anim->offset, anim->offset + anim->count - 1, col);
+        }
+#endif
+        return os_drawrect_ledmatrix(anim->matrix, anim->rect, col, MATRIX_2D_FILL_FULL);
+    }
+
+    rgb_t chunk[LED_ANIM_CHUNK];
+    os_led_anim_walk_t walk;
+
+#ifdef OS_LED_STRIP
+    if (anim->target_type == LED_ANIM_TARGET_STRIP)
+    {
+        os_led_anim_walk_init(anim, time_ms, anim->count, &walk);
+        for (uint32_t done = 0; done < anim->count;)
+        {
+            uint32_t len = anim->count - done < LED_ANIM_CHUNK ? anim->count - done : LED_ANIM_CHUNK;
+            os_led_anim_walk(anim, &walk, chunk, len);
+            int ret = os_led_strip_write(anim->strip, anim->offset + done, chunk, len);
+            if (ret != OS_RET_OK)
+            {
+                return ret;
+            }
+            done += len;
+        }
+        return OS_RET_OK;
+    }
+#endif
+
+    // Every row of the rectangle is the same, so each chunk of columns is worked out once and blitted down the rows
+    os_led_anim_walk_init(anim, time_ms, anim->rect.w, &walk);
+    os_ledmatrix_sprite_t sprite = {(const uint8_t *)chunk, MATRIX_SPRITE_RGB, 0, 1, 0};
+    for (int done = 0; done < anim->rect.w;)
+    {
+        int len = anim->rect.w - done < LED_ANIM_CHUNK ? anim->rect.w - done : LED_ANIM_CHUNK;
+        os_led_anim_walk(anim, &walk, chunk, len);
+        sprite.width = len;
+
+        os_ledmatrix_blit_t blit;
+        memset(&blit, 0, sizeof(blit));
+        for (int y = 0; y < anim->rect.h; y++)
+        {
+            blit.dst = {anim->rect.x + done, anim->rect.y + y};
+            int ret = os_blit_sprite_ledmatrix(anim->matrix, &sprite, blit);
+            if (ret != OS_RET_OK)
+            {
+                return ret;
+            }
+        }
+        done += len;
+    }
+    return OS_RET_OK;
+}
+
+int os_led_anim_scheduler_init(os_led_anim_scheduler_t *sched, uint32_t fps)
+{
+    if (sched == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (fps == 0)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    sched->anims = NULL;
+    sched->frame_period_us = 1000000 / fps;
+    sched->start_us = os_time_us();
+    sched->next_frame_us = sched->start_us;
+    sched->now_ms = 0;
+    sched->running = true;
+    memset(&sched->stats, 0, sizeof(sched->stats));
+
+    return os_mut_init(&sched->mutex);
+}
+
+int os_led_anim_add(os_led_anim_scheduler_t *sched, os_led_anim_t *anim)
+{
+    if (sched == NULL || anim == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&sched->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // Added last so it's drawn over anything already running on the same pixels
+    int final_ret = OS_RET_OK;
+    os_led_anim_t **tail = &sched->anims;
+    while (*tail != NULL && *tail != anim)
+    {
+        tail = &(*tail)->next;
+    }
+    if (*tail == anim)
+    {
+        final_ret = OS_RET_INVALID_PARAM;
+    }
+    else
+    {
+        anim->start_ms = sched->now_ms;
+        anim->next = NULL;
+        *tail = anim;
+    }
+
+    ret = os_mut_exit(&sched->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+int os_led_anim_remove(os_led_anim_scheduler_t *sched, os_led_anim_t *anim)
+{
+    if (sched == NULL || anim == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&sched->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int final_ret = OS_RET_INVALID_PARAM;
+    for (os_led_anim_t **link = &sched->anims; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == anim)
+        {
+            *link = anim->next;
+            anim->next = NULL;
+            final_ret = OS_RET_OK;
+            break;
+        }
+    }
+
+    ret = os_mut_exit(&sched->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+// Whether an animation earlier in the list already draws on the same strip or matrix
+static bool os_led_anim_target_seen(const os_led_anim_scheduler_t *sched, const os_led_anim_t *anim)
+{
+    for (const os_led_anim_t *other = sched->anims; other != anim; other = other->next)
+    {
+        if (other->target_type != anim->target_type)
+        {
+            continue;
+        }
+#ifdef OS_LED_STRIP
+        if (anim->target_type == LED_ANIM_TARGET_STRIP && other->strip == anim->strip)
+        {
+            return true;
+        }
+#endif
+        if (anim->target_type == LED_ANIM_TARGET_MATRIX && other->matrix == anim->matrix)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int os_led_anim_scheduler_step(os_led_anim_scheduler_t *sched, uint32_t now_ms)
+{
+    if (sched == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&sched->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int final_ret = OS_RET_OK;
+    int64_t start = os_time_us();
+    for (os_led_anim_t *anim = sched->anims; anim != NULL; anim = anim->next)
+    {
+        ret = os_led_anim_render(anim, now_ms - anim->start_ms);
+        if (ret != OS_RET_OK && final_ret == OS_RET_OK)
+        {
+            final_ret = ret;
+        }
+    }
+    int64_t rendered = os_time_us();
+
+    // Each target once, no matter how many animations are on it
+    for (os_led_anim_t *anim = sched->anims; anim != NULL; anim = anim->next)
+    {
+        if (os_led_anim_target_seen(sched, anim))
+        {
+            continue;
+        }
+#ifdef OS_LED_STRIP
+        if (anim->target_type == LED_ANIM_TARGET_STRIP)
+        {
+            ret = anim->strip->async != NULL ? os_led_strip_show_async(anim->strip) : os_led_strip_show(anim->strip);
+        }
+        else
+#endif
+        {
+            ret = os_ledmatrix_update(anim->matrix);
+        }
+        if (ret != OS_RET_OK && final_ret == OS_RET_OK)
+        {
+            final_ret = ret;
+        }
+    }
+
+    sched->now_ms = now_ms;
+    sched->stats.frames++;
+    sched->stats.last_render_us = (uint32_t)(rendered - start);
+    if (sched->stats.last_render_us > sched->stats.max_render_us)
+    {
+        sched->stats.max_render_us = sched->stats.last_render_us;
+    }
+    sched->stats.last_frame_us = (uint32_t)(os_time_us() - start);
+
+    ret = os_mut_exit(&sched->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+void os_led_anim_scheduler_thread(void *params)
+{
+    os_led_anim_scheduler_t *sched = (os_led_anim_scheduler_t *)params;
+    if (sched == NULL)
+    {
+        return;
+    }
+
+    bool first = true;
+    for (;;)
+    {
+        bool late = os_frame_clock_wait(&sched->next_frame_us, sched->frame_period_us) && !first;
+        first = false;
+
+        if (os_mut_entry_wait_indefinite(&sched->mutex) != OS_RET_OK)
+        {
+            return;
+        }
+        bool running = sched->running;
+        if (late)
+        {
+            sched->stats.late_frames++;
+        }
+        os_mut_exit(&sched->mutex);
+
+        if (!running)
+        {
+            return;
+        }
+        os_led_anim_scheduler_step(sched, (uint32_t)((os_time_us() - sched->start_us) / 1000));
+    }
+}
+
+int os_led_anim_scheduler_stop(os_led_anim_scheduler_t *sched)
+{
+    if (sched == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&sched->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    sched->running = false;
+
+    return os_mut_exit(&sched->mutex);
+}
+
+int os_led_anim_get_stats(os_led_anim_scheduler_t *sched, os_led_anim_stats_t *stats)
+{
+    if (sched == NULL || stats == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&sched->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    *stats = sched->stats;
+
+    return os_mut_exit(&sched->mutex);
+}
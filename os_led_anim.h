@@ -0,0 +1,177 @@
+#ifndef _OS_LED_ANIM_H
+#define _OS_LED_ANIM_H
+#include "platform_cshal.h"
+#include "color_conv.h"
+#include "csal_ledmatrix.h"
+#include "os_led_strip.h"
+
+/**
+ * @brief Color at a point in an animation
+ * @param uint32_t time_ms when the animation reaches color, first keyframe is at 0 and the rest go up from there
+ * @param rgb_t color
+ */
+typedef struct os_led_keyframe
+{
+    uint32_t time_ms;
+    rgb_t color;
+} os_led_keyframe_t;
+
+typedef enum os_led_anim_mode
+{
+    LED_ANIM_FILL,     /**< Whole target is the keyframes' color at the current time */
+    LED_ANIM_GRADIENT, /**< Keyframes laid out along the target as a palette, scrolling one full length every duration */
+} os_led_anim_mode_t;
+
+typedef enum os_led_anim_target_type
+{
+#ifdef OS_LED_STRIP
+    LED_ANIM_TARGET_STRIP,
+#endif
+    LED_ANIM_TARGET_MATRIX,
+} os_led_anim_target_type_t;
+
+/**
+ * @brief Keyframed animation of a run of strip pixels or a rectangle of a matrix
+ * @note Set up with os_led_anim_init_strip()/os_led_anim_init_matrix(), keyframes are used in place so keep them around.
+ * On a matrix gradients run left to right, every row the same
+ */
+typedef struct os_led_anim
+{
+    const os_led_keyframe_t *keyframes;
+    int num_keyframes;
+    // Length of the whole animation, when looping the last keyframe blends back into the first over what's left of it
+    uint32_t duration_ms;
+    os_led_anim_mode_t mode;
+    // Start over once duration_ms is up, otherwise the last keyframe is held from its time on. On by default
+    bool loop;
+
+    os_led_anim_target_type_t target_type;
+#ifdef OS_LED_STRIP
+    os_led_strip_t *strip;
+    uint32_t offset;
+    uint32_t count;
+#endif
+    os_ledmatrix_t *matrix;
+    os_2d_rect_t rect;
+
+    // Scheduler time the animation was added at, and the next one it runs
+    uint32_t start_ms;
+    struct os_led_anim *next;
+} os_led_anim_t;
+
+#ifdef OS_LED_STRIP
+/**
+ * @brief Sets up an animation of a run of strip pixels
+ * @param os_led_anim_t *anim that we are setting up
+ * @param const os_led_keyframe_t *keyframes colors to go through, in time order
+ * @param int num_keyframes number of keyframes, at least 1
+ * @param uint32_t duration_ms length of the animation, past the last keyframe's time
+ * @param os_led_anim_mode_t mode how the keyframes are used
+ * @param os_led_strip_t *strip that we are drawing on
+ * @param uint32_t offset first pixel of the run
+ * @param uint32_t count number of pixels in the run
+ */
+int os_led_anim_init_strip(os_led_anim_t *anim, const os_led_keyframe_t *keyframes, int num_keyframes, uint32_t duration_ms,
+                           os_led_anim_mode_t mode, os_led_strip_t *strip, uint32_t offset, uint32_t count);
+#endif
+
+/**
+ * @brief Sets up an animation of a rectangle of a matrix
+ * @param os_led_anim_t *anim that we are setting up
+ * @param const os_led_keyframe_t *keyframes colors to go through, in time order
+ * @param int num_keyframes number of keyframes, at least 1
+ * @param uint32_t duration_ms length of the animation, past the last keyframe's time
+ * @param os_led_anim_mode_t mode how the keyframes are used
+ * @param os_ledmatrix_t *matrix that we are drawing on
+ * @param os_2d_rect_t rect region of the matrix to draw
+ */
+int os_led_anim_init_matrix(os_led_anim_t *anim, const os_led_keyframe_t *keyframes, int num_keyframes, uint32_t duration_ms,
+                            os_led_anim_mode_t mode, os_ledmatrix_t *matrix, os_2d_rect_t rect);
+
+/**
+ * @brief Draws an animation as it is time_ms in, without showing it
+ * @param os_led_anim_t *anim to draw
+ * @param uint32_t time_ms time since the animation started
+ */
+int os_led_anim_render(os_led_anim_t *anim, uint32_t time_ms);
+
+/**
+ * @brief Render timing of an animation scheduler
+ */
+typedef struct os_led_anim_stats
+{
+    uint32_t frames;         /**< Frames rendered */
+    uint32_t late_frames;    /**< Frames that missed their frame clock tick */
+    uint32_t last_render_us; /**< Time it took to draw every animation for the last frame */
+    uint32_t max_render_us;  /**< Longest last_render_us so far */
+    uint32_t last_frame_us;  /**< Drawing plus showing every target for the last frame */
+} os_led_anim_stats_t;
+
+/**
+ * @brief Runs any number of animations off one frame clock, showing each strip and matrix once a frame
+ */
+typedef struct os_led_anim_scheduler
+{
+    os_led_anim_t *anims;
+    os_mut_t mutex;
+
+    // Frame clock, in microseconds of os_time_us()
+    uint32_t frame_period_us;
+    int64_t start_us;
+    int64_t next_frame_us;
+    // Time of the last frame, new animations start from here
+    uint32_t now_ms;
+    bool running;
+
+    os_led_anim_stats_t stats;
+} os_led_anim_scheduler_t;
+
+/**
+ * @brief Sets up a scheduler with no animations
+ * @param os_led_anim_scheduler_t *sched that we are setting up
+ * @param uint32_t fps frames per second os_led_anim_scheduler_thread() runs at
+ */
+int os_led_anim_scheduler_init(os_led_anim_scheduler_t *sched, uint32_t fps);
+
+/**
+ * @brief Adds an animation to the scheduler, it starts from its beginning on the next frame
+ * @param os_led_anim_scheduler_t *sched that we are adding to
+ * @param os_led_anim_t *anim set up animation, can't be in another scheduler
+ */
+int os_led_anim_add(os_led_anim_scheduler_t *sched, os_led_anim_t *anim);
+
+/**
+ * @brief Takes an animation out of the scheduler, whatever it drew last stays up
+ * @param os_led_anim_scheduler_t *sched that we are removing from
+ * @param os_led_anim_t *anim to remove
+ */
+int os_led_anim_remove(os_led_anim_scheduler_t *sched, os_led_anim_t *anim);
+
+/**
+ * @brief Draws every animation at a given scheduler time, then shows each target they drew on
+ * @note What os_led_anim_scheduler_thread() does every frame, for running the scheduler off some other clock
+ * @param os_led_anim_scheduler_t *sched to run
+ * @param uint32_t now_ms time since the scheduler started
+ */
+int os_led_anim_scheduler_step(os_led_anim_scheduler_t *sched, uint32_t now_ms);
+
+/**
+ * @brief Scheduler thread! Steps the scheduler at its frame rate until os_led_anim_scheduler_stop() is called
+ * @param void *params pointer to the os_led_anim_scheduler_t
+ */
+void os_led_anim_scheduler_thread(void *params);
+
+/**
+ * @brief Has os_led_anim_scheduler_thread() return after the frame it's on
+ * @param os_led_anim_scheduler_t *sched to stop
+ */
+int os_led_anim_scheduler_stop(os_led_anim_scheduler_t *sched);
+
+/**
+ * @brief Gets the render timing of a scheduler
+ * @param os_led_anim_scheduler_t *sched that we want the timing of
+ * @param os_led_anim_stats_t *stats filled in with the current timing
+ */
+int os_led_anim_get_stats(os_led_anim_scheduler_t *sched, os_led_anim_stats_t *stats);
+
+#endif
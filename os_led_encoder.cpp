@@ -0,0 +1,368 @@
+#include "os_led_encoder.h"
+#include "global_includes.h"
+#include "string.h"
+
+#ifdef OS_LED_STRIP
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define OS_LED_ENCODER_SSSE3
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define OS_LED_ENCODER_NEON
+#endif
+
+// Wire bits of a single data bit, and how many of them there are
+static uint32_t os_led_encoder_bit(os_led_encoding_t encoding, int bit)
+{
+    if (encoding == LED_ENCODING_SPI_3BIT)
+    {
+        return bit ? 0x6 : 0x4;
+    }
+    return bit ? 0xE : 0x8;
+}
+
+int os_led_encoder_init(os_led_encoder_t *encoder, os_led_encoding_t encoding, const os_led_timing_t *timing, uint32_t tick_ns)
+{
+    if (encoder == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (encoding > LED_ENCODING_RMT || (encoding == LED_ENCODING_RMT && tick_ns == 0))
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    encoder->encoding = encoding;
+
+    // Every encoding gets the byte table, the SIMD paths pull their smaller tables out of it
+    int width = encoding == LED_ENCODING_SPI_3BIT ? 3 : 4;
+    for (int byte = 0; byte < 256; byte++)
+    {
+        uint32_t bits = 0;
+        for (int n = 7; n >= 0; n--)
+        {
+            bits = (bits << width) | os_led_encoder_bit(encoding, (byte >> n) & 1);
+        }
+        encoder->byte_lut[byte] = bits;
+    }
+
+    if (encoding == LED_ENCODING_RMT)
+    {
+        const os_led_timing_t ws2812 = LED_TIMING_WS2812;
+        if (timing == NULL)
+        {
+            timing = &ws2812;
+        }
+
+        // High for the first duration, low for the second, durations are 15 bits of ticks
+        uint32_t ticks[4] = {timing->t0h_ns, timing->t0l_ns, timing->t1h_ns, timing->t1l_ns};
+        for (int n = 0; n < 4; n++)
+        {
+            ticks[n] = (ticks[n] + tick_ns / 2) / tick_ns;
+            ticks[n] = ticks[n] > 0x7FFF ? 0x7FFF : ticks[n];
+        }
+        uint32_t zero = ticks[0] | (1 << 15) | (ticks[1] << 16);
+        uint32_t one = ticks[2] | (1 << 15) | (ticks[3] << 16);
+
+        for (int nibble = 0; nibble < 16; nibble++)
+        {
+            for (int n = 0; n < 4; n++)
+            {
+                encoder->rmt_lut[nibble][n] = (nibble >> (3 - n)) & 1 ? one : zero;
+            }
+        }
+    }
+
+    return OS_RET_OK;
+}
+
+size_t os_led_encoder_size(const os_led_encoder_t *encoder, uint32_t len)
+{
+    if (encoder == NULL)
+    {
+        return 0;
+    }
+
+    switch (encoder->encoding)
+    {
+    case LED_ENCODING_SPI_3BIT:
+        return (size_t)len * 3;
+    case LED_ENCODING_SPI_4BIT:
+    case LED_ENCODING_I2S_4BIT:
+        return (size_t)len * 4;
+    case LED_ENCODING_RMT:
+        return (size_t)len * 8 * sizeof(uint32_t);
+    }
+    return 0;
+}
+
+#if defined(OS_LED_ENCODER_SSSE3) || defined(OS_LED_ENCODER_NEON)
+/**
+ * Small tables for the vector paths, each indexed by a few bits of the data byte
+ * 4 bit encodings: every output byte is 2 data bits, looked up by the nibble they're in
+ * 3 bit encoding: output byte 0 is data bits 7-5, byte 1 bits 4-3 and byte 2 bits 2-0
+ */
+static void os_led_encoder_tables(const os_led_encoder_t *encoder, uint8_t upper[16], uint8_t lower[16], uint8_t third[16])
+{
+    for (int n = 0; n < 16; n++)
+    {
+        if (encoder->encoding == LED_ENCODING_SPI_3BIT)
+        {
+            upper[n] = (uint8_t)(encoder->byte_lut[(n & 7) << 5] >> 16);
+            lower[n] = (uint8_t)(encoder->byte_lut[(n & 3) << 3] >> 8);
+            third[n] = (uint8_t)encoder->byte_lut[n & 7];
+        }
+        else
+        {
+            upper[n] = (uint8_t)(encoder->byte_lut[n] >> 8);
+            lower[n] = (uint8_t)encoder->byte_lut[n];
+            third[n] = 0;
+        }
+    }
+}
+#endif
+
+#ifdef OS_LED_ENCODER_SSSE3
+// Shuffles spreading three registers of bytes a, b, c out into a0 b0 c0 a1 b1 c1..., 0x80 zeroes a byte
+struct os_led_encoder_interleave3_t
+{
+    int8_t mask[3][3][16];
+
+    constexpr os_led_encoder_interleave3_t() : mask()
+    {
+        for (int out = 0; out < 3; out++)
+        {
+            for (int src = 0; src < 3; src++)
+            {
+                for (int n = 0; n < 16; n++)
+                {
+                    int pos = out * 16 + n;
+                    mask[out][src][n] = pos % 3 == src ? (int8_t)(pos / 3) : (int8_t)0x80;
+                }
+            }
+        }
+    }
+};
+
+static constexpr os_led_encoder_interleave3_t os_led_encoder_interleave3;
+
+// Encodes 16 bytes a loop, returns how many bytes it got through
+static uint32_t os_led_encode_simd(const os_led_encoder_t *encoder, const uint8_t *data, uint32_t len, uint8_t *out)
+{
+    uint8_t upper[16], lower[16], third[16];
+    os_led_encoder_tables(encoder, upper, lower, third);
+
+    const __m128i lut_upper = _mm_loadu_si128((const __m128i *)upper);
+    const __m128i lut_lower = _mm_loadu_si128((const __m128i *)lower);
+    const __m128i lut_third = _mm_loadu_si128((const __m128i *)third);
+    const __m128i low_nibble = _mm_set1_epi8(0x0F);
+    bool i2s = encoder->encoding == LED_ENCODING_I2S_4BIT;
+
+    uint32_t n = 0;
+    if (encoder->encoding == LED_ENCODING_SPI_3BIT)
+    {
+        __m128i mask[3][3];
+        for (int o = 0; o < 3; o++)
+        {
+            for (int s = 0; s < 3; s++)
+            {
+                mask[o][s] = _mm_loadu_si128((const __m128i *)os_led_encoder_interleave3.mask[o][s]);
+            }
+        }
+
+        for (; n + 16 <= len; n += 16)
+        {
+            __m128i in = _mm_loadu_si128((const __m128i *)&data[n]);
+            __m128i a = _mm_shuffle_epi8(lut_upper, _mm_and_si128(_mm_srli_epi16(in, 5), _mm_set1_epi8(0x07)));
+            __m128i b = _mm_shuffle_epi8(lut_lower, _mm_and_si128(_mm_srli_epi16(in, 3), _mm_set1_epi8(0x03)));
+            __m128i c = _mm_shuffle_epi8(lut_third, _mm_and_si128(in, _mm_set1_epi8(0x07)));
+
+            for (int o = 0; o < 3; o++)
+            {
+                __m128i v = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, mask[o][0]), _mm_shuffle_epi8(b, mask[o][1])),
+                                         _mm_shuffle_epi8(c, mask[o][2]));
+                _mm_storeu_si128((__m128i *)&out[n * 3 + o * 16], v);
+            }
+        }
+        return n;
+    }
+
+    for (; n + 16 <= len; n += 16)
+    {
+        __m128i in = _mm_loadu_si128((const __m128i *)&data[n]);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(in, 4), low_nibble);
+        __m128i lo = _mm_and_si128(in, low_nibble);
+        __m128i hi_a = _mm_shuffle_epi8(lut_upper, hi);
+        __m128i hi_b = _mm_shuffle_epi8(lut_lower, hi);
+        __m128i lo_a = _mm_shuffle_epi8(lut_upper, lo);
+        __m128i lo_b = _mm_shuffle_epi8(lut_lower, lo);
+
+        // I2S sends each 16 bit sample high byte first out of little endian memory
+        __m128i hi_0 = i2s ? _mm_unpacklo_epi8(hi_b, hi_a) : _mm_unpacklo_epi8(hi_a, hi_b);
+        __m128i hi_1 = i2s ? _mm_unpackhi_epi8(hi_b, hi_a) : _mm_unpackhi_epi8(hi_a, hi_b);
+        __m128i lo_0 = i2s ? _mm_unpacklo_epi8(lo_b, lo_a) : _mm_unpacklo_epi8(lo_a, lo_b);
+        __m128i lo_1 = i2s ? _mm_unpackhi_epi8(lo_b, lo_a) : _mm_unpackhi_epi8(lo_a, lo_b);
+
+        _mm_storeu_si128((__m128i *)&out[n * 4], _mm_unpacklo_epi16(hi_0, lo_0));
+        _mm_storeu_si128((__m128i *)&out[n * 4 + 16], _mm_unpackhi_epi16(hi_0, lo_0));
+        _mm_storeu_si128((__m128i *)&out[n * 4 + 32], _mm_unpacklo_epi16(hi_1, lo_1));
+        _mm_storeu_si128((__m128i *)&out[n * 4 + 48], _mm_unpackhi_epi16(hi_1, lo_1));
+    }
+    return n;
+}
+#endif
+
+#ifdef OS_LED_ENCODER_NEON
+// Encodes 16 bytes a loop, returns how many bytes it got through
+static uint32_t os_led_encode_simd(const os_led_encoder_t *encoder, const uint8_t *data, uint32_t len, uint8_t *out)
+{
+    uint8_t upper[16], lower[16], third[16];
+    os_led_encoder_tables(encoder, upper, lower, third);
+
+    const uint8x16_t lut_upper = vld1q_u8(upper);
+    const uint8x16_t lut_lower = vld1q_u8(lower);
+    const uint8x16_t lut_third = vld1q_u8(third);
+    bool i2s = encoder->encoding == LED_ENCODING_I2S_4BIT;
+
+    uint32_t n = 0;
+    if (encoder->encoding == LED_ENCODING_SPI_3BIT)
+    {
+        for (; n + 16 <= len; n += 16)
+        {
+            uint8x16_t in = vld1q_u8(&data[n]);
+            uint8x16x3_t v;
+            v.val[0] = vqtbl1q_u8(lut_upper, vshrq_n_u8(in, 5));
+            v.val[1] = vqtbl1q_u8(lut_lower, vandq_u8(vshrq_n_u8(in, 3), vdupq_n_u8(0x03)));
+            v.val[2] = vqtbl1q_u8(lut_third, vandq_u8(in, vdupq_n_u8(0x07)));
+            vst3q_u8(&out[n * 3], v);
+        }
+        return n;
+    }
+
+    for (; n + 16 <= len; n += 16)
+    {
+        uint8x16_t in = vld1q_u8(&data[n]);
+        uint8x16_t hi = vshrq_n_u8(in, 4);
+        uint8x16_t lo = vandq_u8(in, vdupq_n_u8(0x0F));
+
+        // I2S sends each 16 bit sample high byte first out of little endian memory
+        uint8x16x4_t v;
+        v.val[i2s ? 1 : 0] = vqtbl1q_u8(lut_upper, hi);
+        v.val[i2s ? 0 : 1] = vqtbl1q_u8(lut_lower, hi);
+        v.val[i2s ? 3 : 2] = vqtbl1q_u8(lut_upper, lo);
+        v.val[i2s ? 2 : 3] = vqtbl1q_u8(lut_lower, lo);
+        vst4q_u8(&out[n * 4], v);
+    }
+    return n;
+}
+#endif
+
+int os_led_encode(const os_led_encoder_t *encoder, const uint8_t *data, uint32_t len, void *out)
+{
+    if (encoder == NULL || data == NULL || out == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    uint8_t *bytes = (uint8_t *)out;
+    uint32_t n = 0;
+
+    if (encoder->encoding == LED_ENCODING_RMT)
+    {
+        uint32_t *items = (uint32_t *)out;
+        for (; n < len; n++)
+        {
+            memcpy(&items[n * 8], encoder->rmt_lut[data[n] >> 4], 4 * sizeof(uint32_t));
+            memcpy(&items[n * 8 + 4], encoder->rmt_lut[data[n] & 0x0F], 4 * sizeof(uint32_t));
+        }
+        return OS_RET_OK;
+    }
+
+#if defined(OS_LED_ENCODER_SSSE3) || defined(OS_LED_ENCODER_NEON)
+    n = os_led_encode_simd(encoder, data, len, bytes);
+#endif
+
+    // Whatever the vector loop left over, or all of it without one. SPI goes out MSB first
+    switch (encoder->encoding)
+    {
+    case LED_ENCODING_SPI_3BIT:
+        for (; n < len; n++)
+        {
+            uint32_t bits = encoder->byte_lut[data[n]];
+            bytes[n * 3] = (uint8_t)(bits >> 16);
+            bytes[n * 3 + 1] = (uint8_t)(bits >> 8);
+            bytes[n * 3 + 2] = (uint8_t)bits;
+        }
+        break;
+    case LED_ENCODING_SPI_4BIT:
+        for (; n < len; n++)
+        {
+            uint32_t bits = encoder->byte_lut[data[n]];
+            bytes[n * 4] = (uint8_t)(bits >> 24);
+            bytes[n * 4 + 1] = (uint8_t)(bits >> 16);
+            bytes[n * 4 + 2] = (uint8_t)(bits >> 8);
+            bytes[n * 4 + 3] = (uint8_t)bits;
+        }
+        break;
+    case LED_ENCODING_I2S_4BIT:
+        for (; n < len; n++)
+        {
+            uint32_t bits = encoder->byte_lut[data[n]];
+            bytes[n * 4] = (uint8_t)(bits >> 16);
+            bytes[n * 4 + 1] = (uint8_t)(bits >> 24);
+            bytes[n * 4 + 2] = (uint8_t)bits;
+            bytes[n * 4 + 3] = (uint8_t)(bits >> 8);
+        }
+        break;
+    default:
+        break;
+    }
+
+    return OS_RET_OK;
+}
+
+int os_led_encode_rgb(const os_led_encoder_t *encoder, const rgb_t *frame, uint32_t numpixel, os_led_color_order_t order, void *out)
+{
+    if (encoder == NULL || frame == NULL || out == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if ((unsigned)order > LED_ORDER_BGR)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    // rgb_t is already in wire order
+    if (order == LED_ORDER_RGB)
+    {
+        return os_led_encode(encoder, (const uint8_t *)frame, numpixel * sizeof(rgb_t), out);
+    }
+
+    // Reorder a chunk at a time so the encoder still gets long runs
+    uint8_t chunk[64 * 3];
+    uint8_t pos_r = os_led_color_order_pos[order][0];
+    uint8_t pos_g = os_led_color_order_pos[order][1];
+    uint8_t pos_b = os_led_color_order_pos[order][2];
+    for (uint32_t done = 0; done < numpixel;)
+    {
+        uint32_t len = numpixel - done < 64 ? numpixel - done : 64;
+        for (uint32_t n = 0; n < len; n++)
+        {
+            chunk[n * 3 + pos_r] = frame[done + n].r;
+            chunk[n * 3 + pos_g] = frame[done + n].g;
+            chunk[n * 3 + pos_b] = frame[done + n].b;
+        }
+
+        int ret = os_led_encode(encoder, chunk, len * 3, (uint8_t *)out + os_led_encoder_size(encoder, done * 3));
+        if (ret != OS_RET_OK)
+        {
+            return ret;
+        }
+        done += len;
+    }
+
+    return OS_RET_OK;
+}
+#endif
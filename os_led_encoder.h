@@ -0,0 +1,85 @@
+#ifndef _OS_LED_ENCODER_H
+#define _OS_LED_ENCODER_H
+#include "os_led_strip.h"
+#ifdef OS_LED_STRIP
+#include "stddef.h"
+
+/**
+ * Shared encoder turning pixel bytes into what the SPI, I2S or RMT peripheral clocks out
+ * to a WS2812/SK6812 style one wire strip, so backends don't each do it a bit at a time
+ * None of the formats include the reset/latch time, backends append that themselves
+ */
+typedef enum
+{
+    LED_ENCODING_SPI_3BIT, /**< 3 SPI bits a data bit(1 -> 110, 0 -> 100), SPI clocked at 2.4MHz */
+    LED_ENCODING_SPI_4BIT, /**< 4 SPI bits a data bit(1 -> 1110, 0 -> 1000), SPI clocked at 3.2MHz */
+    LED_ENCODING_I2S_4BIT, /**< Same bits as LED_ENCODING_SPI_4BIT, as little endian 16 bit samples for I2S at 3.2MHz */
+    LED_ENCODING_RMT,      /**< One 32 bit RMT item(duration0:15, level0:1, duration1:15, level1:1) a data bit */
+} os_led_encoding_t;
+
+/**
+ * @brief High and low times of a 0 and a 1 bit in nanoseconds, only used by LED_ENCODING_RMT
+ */
+typedef struct os_led_timing
+{
+    uint16_t t0h_ns;
+    uint16_t t0l_ns;
+    uint16_t t1h_ns;
+    uint16_t t1l_ns;
+} os_led_timing_t;
+
+#define LED_TIMING_WS2812 {400, 850, 800, 450}
+#define LED_TIMING_SK6812 {300, 900, 600, 600}
+
+/**
+ * @brief Lookup tables for one encoding, built once by os_led_encoder_init()
+ */
+typedef struct os_led_encoder
+{
+    os_led_encoding_t encoding;
+
+    // Wire bits for a whole byte, 24 or 32 of them depending on the encoding
+    uint32_t byte_lut[256];
+    // RMT items for a nibble
+    uint32_t rmt_lut[16][4];
+} os_led_encoder_t;
+
+/**
+ * @brief Builds the lookup tables for an encoding
+ * @param os_led_encoder_t *encoder that we are setting up
+ * @param os_led_encoding_t encoding what the backend's peripheral wants
+ * @param const os_led_timing_t *timing (optional)bit timing for LED_ENCODING_RMT, WS2812 if NULL
+ * @param uint32_t tick_ns length of an RMT tick(ie 25 for 80MHz with a divider of 2), ignored by the other encodings
+ */
+int os_led_encoder_init(os_led_encoder_t *encoder, os_led_encoding_t encoding, const os_led_timing_t *timing, uint32_t tick_ns);
+
+/**
+ * @brief Size of the encoded output for some number of data bytes
+ * @param const os_led_encoder_t *encoder to use
+ * @param uint32_t len data bytes, 3 a pixel for RGB strips and 4 for RGBW
+ * @return bytes needed, 0 if encoder is NULL
+ */
+size_t os_led_encoder_size(const os_led_encoder_t *encoder, uint32_t len);
+
+/**
+ * @brief Encodes bytes that are already in wire order, ie what os_led_strip_set_pipeline() hands a raw backend
+ * @note Uses SSSE3 or NEON for the SPI and I2S encodings when built for them
+ * @param const os_led_encoder_t *encoder to use
+ * @param const uint8_t *data bytes to send out
+ * @param uint32_t len number of bytes
+ * @param void *out os_led_encoder_size() bytes to encode into
+ */
+int os_led_encode(const os_led_encoder_t *encoder, const uint8_t *data, uint32_t len, void *out);
+
+/**
+ * @brief Encodes an RGB framebuffer, putting the colors in the strip's order on the way
+ * @param const os_led_encoder_t *encoder to use
+ * @param const rgb_t *frame pixels to send out
+ * @param uint32_t numpixel number of pixels
+ * @param os_led_color_order_t order the strip wants the colors in
+ * @param void *out os_led_encoder_size(encoder, numpixel * 3) bytes to encode into
+ */
+int os_led_encode_rgb(const os_led_encoder_t *encoder, const rgb_t *frame, uint32_t numpixel, os_led_color_order_t order, void *out);
+
+#endif
+#endif
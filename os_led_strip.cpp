@@ -1,7 +1,88 @@
 #include "os_led_strip.h"
 #include "global_includes.h"
+#include "string.h"
+#include "math.h"
+#include "os_time.h"
+#include <atomic>
 
 #ifdef OS_LED_STRIP
+// Everything needed to send frames in the background, owned by an async strip
+struct os_led_strip_async
+{
+    // Snapshot of the frame going out, room for 4 bytes a pixel so it can hold the pipeline's output
+    uint8_t *front;
+    // What the show thread still has to hand the backend, NULL when it's already in the backend's buffer
+    const void *staged;
+
+    // Set from show_async until the frame is out on the strip
+    std::atomic<bool> busy;
+    os_setbits_t frame_ready;
+    os_setbits_t frame_done;
+    int last_ret;
+    // When the last frame finished going out, for group frame timing
+    int64_t done_us;
+
+    os_led_strip_done_cb_t callback;
+    void *callback_arg;
+};
+
+// Output pipeline of a strip, tables are rebuilt whenever the config changes
+struct os_led_strip_pipeline
+{
+    os_led_strip_pipeline_config_t config;
+
+    // Gamma with brightness already multiplied in, one table per channel
+    uint8_t lut[4][256];
+    // Where r, g, b and w land within a pixel on the wire
+    uint8_t pos[4];
+    int bytes_per_pixel;
+
+    // Output for when the backend has no buffer of its own to write into
+    uint8_t *out;
+
+    // HDR only, same tables at 16.8 bits sampled every 256 steps, and what dithering hasn't shown yet of each channel
+    uint32_t lut16[4][257];
+    uint8_t *error;
+};
+
+// Palette mode of a strip, pixels are indices into colors and only become colors on show
+struct os_led_strip_palette
+{
+    uint8_t bits;
+    // 16 or 256, whatever fits in bits
+    int num_colors;
+    rgb_t *colors;
+    // Colors already through the pipeline, 3 or 4 bytes each, so showing is just a copy per pixel
+    uint8_t *wire;
+    // Two pixels a byte at 4 bits, even pixels in the low nibble
+    uint8_t *indices;
+
+    // Last color looked up, so runs of one color only search the palette once
+    rgb_t last_col;
+    uint8_t last_index;
+    bool last_valid;
+};
+
+// Set alongside a buffer index in ready when the producer published it after show last looked
+#define OS_LED_STRIP_SEGMENT_FRESH 0x4
+
+// Triple buffered run of pixels, the producer and show each own one buffer and swap the third between them
+struct os_led_strip_segment
+{
+    uint32_t offset;
+    uint32_t count;
+    rgb_t *buffers[3];
+
+    // Only touched by the producer
+    uint8_t back;
+    // Latest published buffer
+    std::atomic<uint8_t> ready;
+    // Only touched by show, under the strip mutex
+    uint8_t front;
+
+    struct os_led_strip_segment *next;
+};
+
 int os_led_strip_init(os_led_strip_t *strip, led_strip_type_t type, int bus, int gpio, uint32_t numpixels)
 {
     if (strip == NULL)
@@ -18,6 +99,20 @@ int os_led_strip_init(os_led_strip_t *strip, led_strip_type_t type, int bus, int
         return ret;
     }
 
+    // Backends that have them fill these in below
+    strip->strip_write_func = NULL;
+    strip->strip_get_buffer_func = NULL;
+    strip->strip_show_async_func = NULL;
+    strip->strip_write_raw_func = NULL;
+    strip->buffer = NULL;
+    strip->buffer_native = false;
+    strip->backend_buffer = NULL;
+    strip->pipeline = NULL;
+    strip->buffer16 = NULL;
+    strip->palette = NULL;
+    strip->async = NULL;
+    strip->segments = NULL;
+
     switch (type)
     {
 #ifdef NEOPIXEL_LED_STRIP
@@ -73,6 +168,19 @@ int os_led_strip_init(os_led_strip_t *strip, led_strip_type_t type, int bus, int
         break;
     }
 #endif
+
+#ifdef LED_STRIP_SIMULATED
+    case STRIP_SIMULATED_RGB:
+    {
+        strip->strip = _sim_os_led_strip_init(bus, gpio, numpixels);
+        strip->strip_set_func = _sim_os_led_strip_set;
+        strip->strip_show_func = _sim_os_led_strip_show;
+        strip->strip_update_brightness_func = _sim_led_strip_set_brightness;
+        strip->strip_get_buffer_func = _sim_os_led_strip_get_buffer;
+        strip->strip_show_async_func = _sim_os_led_strip_show_async;
+        break;
+    }
+#endif
     }
 
     if (strip->strip == NULL)
@@ -80,206 +188,464 @@ int os_led_strip_init(os_led_strip_t *strip, led_strip_type_t type, int bus, int
         return OS_RET_LOW_MEM_ERROR;
     }
 
+    // Render straight into the backend's own buffer when it lets us
+    if (strip->strip_get_buffer_func != NULL)
+    {
+        strip->backend_buffer = strip->strip_get_buffer_func(strip->strip);
+        strip->buffer = strip->backend_buffer;
+        strip->buffer_native = strip->buffer != NULL;
+    }
+
     return OS_RET_OK;
 }
 
-// These are essentially wrapper functions since we can change the type of LED strip we want to use
-int os_led_strip_set(os_led_strip_t *strip, uint32_t pixel, uint8_t r, uint8_t g, uint8_t b)
+static inline void os_led_strip_palette_put(os_led_strip_palette *palette, uint32_t pixel, uint8_t index)
 {
-    if (strip == NULL)
+    if (palette->bits == 8)
     {
-        return OS_RET_NULL_PTR;
+        palette->indices[pixel] = index;
+        return;
     }
 
-    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
-    if (ret != OS_RET_OK)
+    uint8_t *byte = &palette->indices[pixel >> 1];
+    int shift = (pixel & 1) * 4;
+    *byte = (uint8_t)((*byte & ~(0x0F << shift)) | ((index & 0x0F) << shift));
+}
+
+static inline void os_led_strip_palette_fill(os_led_strip_palette *palette, uint32_t offset, uint32_t count, uint8_t index)
+{
+    if (palette->bits == 8)
     {
-        return ret;
+        memset(&palette->indices[offset], index, count);
+        return;
     }
-    int final_ret = strip->strip_set_func(strip->strip, pixel, r, g, b);
-    ret = os_mut_exit(&strip->mutex);
-    if (ret != OS_RET_OK)
+
+    for (uint32_t n = offset; n < offset + count; n++)
     {
-        return ret;
+        os_led_strip_palette_put(palette, n, index);
     }
-    return final_ret;
 }
 
-int os_led_strip_show(os_led_strip_t *strip)
+// Palette entry to draw a color with
+static inline uint8_t os_led_strip_palette_lookup(os_led_strip_palette *palette, rgb_t col)
 {
-
-    if (strip == NULL)
+    if (!palette->last_valid || palette->last_col.r != col.r || palette->last_col.g != col.g || palette->last_col.b != col.b)
     {
-        return OS_RET_NULL_PTR;
+        palette->last_col = col;
+        palette->last_index = rgb_palette_nearest(palette->colors, palette->num_colors, col);
+        palette->last_valid = true;
     }
+    return palette->last_index;
+}
 
-    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
-    if (ret != OS_RET_OK)
+// Turns a run of indices into what goes out on the wire, bpp bytes a pixel
+static void os_led_strip_palette_expand(const os_led_strip_palette *palette, int bpp, uint32_t offset, uint32_t count, uint8_t *out)
+{
+    const uint8_t *wire = palette->wire;
+    if (palette->bits == 8)
     {
-        return ret;
+        const uint8_t *indices = &palette->indices[offset];
+        if (bpp == 3)
+        {
+            for (uint32_t n = 0; n < count; n++)
+            {
+                const uint8_t *col = &wire[indices[n] * 3];
+                out[0] = col[0];
+                out[1] = col[1];
+                out[2] = col[2];
+                out += 3;
+            }
+            return;
+        }
+
+        for (uint32_t n = 0; n < count; n++)
+        {
+            memcpy(out, &wire[indices[n] * 4], 4);
+            out += 4;
+        }
+        return;
     }
-    int final_ret = strip->strip_show_func(strip->strip);
-    ret = os_mut_exit(&strip->mutex);
-    if (ret != OS_RET_OK)
+
+    for (uint32_t n = offset; n < offset + count; n++)
     {
-        return ret;
+        uint8_t index = (palette->indices[n >> 1] >> ((n & 1) * 4)) & 0x0F;
+        memcpy(out, &wire[index * bpp], bpp);
+        out += bpp;
     }
-    return final_ret;
 }
 
-int os_led_strip_set_rgb(os_led_strip_t *strip, uint32_t pixel, rgb_t col)
+// Copies a run of colors to wherever pixels live for this strip, mutex has to be held
+static int os_led_strip_write_locked(os_led_strip_t *strip, uint32_t offset, const rgb_t *col, uint32_t count)
 {
-    return os_led_strip_set(strip, pixel, col.r, col.g, col.b);
-}
+    if (strip->palette != NULL)
+    {
+        for (uint32_t n = 0; n < count; n++)
+        {
+            os_led_strip_palette_put(strip->palette, offset + n, os_led_strip_palette_lookup(strip->palette, col[n]));
+        }
+        return OS_RET_OK;
+    }
 
-int os_led_strip_set_brightness(os_led_strip_t *strip, uint8_t brightness)
-{
-    return strip->strip_update_brightness_func(strip->strip, brightness);
+    if (strip->buffer16 != NULL)
+    {
+        for (uint32_t n = 0; n < count; n++)
+        {
+            strip->buffer16[offset + n] = {(uint16_t)(col[n].r * 257), (uint16_t)(col[n].g * 257), (uint16_t)(col[n].b * 257)};
+        }
+        return OS_RET_OK;
+    }
+
+    if (strip->buffer != NULL)
+    {
+        memcpy(&strip->buffer[offset], col, count * sizeof(rgb_t));
+        return OS_RET_OK;
+    }
+
+    if (strip->strip_write_func != NULL)
+    {
+        return strip->strip_write_func(strip->strip, offset, col, count);
+    }
+
+    for (uint32_t n = 0; n < count; n++)
+    {
+        int ret = strip->strip_set_func(strip->strip, offset + n, col[n].r, col[n].g, col[n].b);
+        if (ret != OS_RET_OK)
+        {
+            return ret;
+        }
+    }
+    return OS_RET_OK;
 }
 
-int os_led_strip_set_rgb_range(os_led_strip_t *strip, uint32_t lower_range, uint32_t upper_range, rgb_t *col)
+// Copies in whatever the producers published since the last show, mutex has to be held
+static int os_led_strip_collect_segments(os_led_strip_t *strip)
 {
-    // Bounds check!
-    if ((lower_range >= strip->numpixel) | (upper_range >= strip->numpixel))
+    int final_ret = OS_RET_OK;
+    for (os_led_strip_segment *segment = strip->segments; segment != NULL; segment = segment->next)
     {
-        return OS_RET_INVALID_PARAM;
+        if (!(segment->ready.load(std::memory_order_relaxed) & OS_LED_STRIP_SEGMENT_FRESH))
+        {
+            continue;
+        }
+
+        // Acquire pairs with the producer's release, so the whole frame is there before we read it
+        segment->front = segment->ready.exchange(segment->front, std::memory_order_acq_rel) & ~OS_LED_STRIP_SEGMENT_FRESH;
+        int ret = os_led_strip_write_locked(strip, segment->offset, segment->buffers[segment->front], segment->count);
+        if (ret != OS_RET_OK && final_ret == OS_RET_OK)
+        {
+            final_ret = ret;
+        }
     }
+    return final_ret;
+}
 
-    if (lower_range >= upper_range)
+// Gamma, brightness, order and white extraction in a single pass, no branching on the config inside the loops
+static void os_led_strip_pipeline_run(const os_led_strip_pipeline *pipeline, const rgb_t *frame, uint8_t *out, int numpixel)
+{
+    const uint8_t *lut_r = pipeline->lut[0];
+    const uint8_t *lut_g = pipeline->lut[1];
+    const uint8_t *lut_b = pipeline->lut[2];
+    const uint8_t pos_r = pipeline->pos[0];
+    const uint8_t pos_g = pipeline->pos[1];
+    const uint8_t pos_b = pipeline->pos[2];
+
+    if (pipeline->bytes_per_pixel == 3)
     {
-        return OS_RET_INVALID_PARAM;
+        for (int n = 0; n < numpixel; n++)
+        {
+            out[pos_r] = lut_r[frame[n].r];
+            out[pos_g] = lut_g[frame[n].g];
+            out[pos_b] = lut_b[frame[n].b];
+            out += 3;
+        }
+        return;
     }
 
-    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
-    if (ret != OS_RET_OK)
+    // Whatever all three channels share goes to the white led instead
+    const uint8_t *lut_w = pipeline->lut[3];
+    for (int n = 0; n < numpixel; n++)
     {
-        return ret;
+        uint8_t r = frame[n].r;
+        uint8_t g = frame[n].g;
+        uint8_t b = frame[n].b;
+        uint8_t w = r < g ? r : g;
+        w = w < b ? w : b;
+
+        out[pos_r] = lut_r[r - w];
+        out[pos_g] = lut_g[g - w];
+        out[pos_b] = lut_b[b - w];
+        out[3] = lut_w[w];
+        out += 4;
     }
+}
+
+// Gamma and brightness for a 16 bit value, interpolating between table entries
+// Tables only ever go up, and keep 8 extra bits so 8 bit colors come out exact
+static inline uint32_t os_led_strip_lut16(const uint32_t *lut, uint32_t v)
+{
+    uint32_t idx = v >> 8;
+    uint32_t step = lut[idx + 1] - lut[idx];
+    return (lut[idx] + ((step * (v & 0xFF)) >> 8) + 0x80) >> 8;
+}
+
+// Top byte of a 16 bit value, plus one whenever the bits dropped on earlier frames add up to a whole step
+static inline uint8_t os_led_strip_dither(uint32_t v, uint8_t *error)
+{
+    uint32_t acc = *error + (v & 0xFF);
+    uint32_t out = (v >> 8) + (acc >> 8);
+    *error = (uint8_t)acc;
+    // 255 plus a carry would wrap
+    return (uint8_t)(out - (out >> 8));
+}
+
+// Same as os_led_strip_pipeline_run() but from the 16 bit frame, dithered down to 8 bits
+static void os_led_strip_pipeline_run16(const os_led_strip_pipeline *pipeline, const rgb16_t *frame, uint8_t *out, int numpixel)
+{
+    const uint32_t *lut_r = pipeline->lut16[0];
+    const uint32_t *lut_g = pipeline->lut16[1];
+    const uint32_t *lut_b = pipeline->lut16[2];
+    const uint8_t pos_r = pipeline->pos[0];
+    const uint8_t pos_g = pipeline->pos[1];
+    const uint8_t pos_b = pipeline->pos[2];
+    uint8_t *error = pipeline->error;
 
-    // Iterate through range of pixels to set in range
-    for (int n = lower_range; n <= upper_range; n++)
+    if (pipeline->bytes_per_pixel == 3)
     {
-        ret = strip->strip_set_func(strip->strip, n, col[lower_range + n].r, col[lower_range + n].g, col[lower_range + n].b);
-        if (ret != OS_RET_OK)
+        for (int n = 0; n < numpixel; n++)
         {
-            // Failiure somewhere, exit out!
-            int final_ret = os_mut_exit(&strip->mutex);
-            if (final_ret != OS_RET_OK)
-            {
-                return final_ret;
-            }
-            return ret;
+            out[pos_r] = os_led_strip_dither(os_led_strip_lut16(lut_r, frame[n].r), &error[0]);
+            out[pos_g] = os_led_strip_dither(os_led_strip_lut16(lut_g, frame[n].g), &error[1]);
+            out[pos_b] = os_led_strip_dither(os_led_strip_lut16(lut_b, frame[n].b), &error[2]);
+            out += 3;
+            error += 4;
         }
+        return;
     }
 
-    ret = os_mut_exit(&strip->mutex);
-    if (ret != OS_RET_OK)
+    const uint32_t *lut_w = pipeline->lut16[3];
+    for (int n = 0; n < numpixel; n++)
     {
-        return ret;
+        uint32_t r = frame[n].r;
+        uint32_t g = frame[n].g;
+        uint32_t b = frame[n].b;
+        uint32_t w = r < g ? r : g;
+        w = w < b ? w : b;
+
+        out[pos_r] = os_led_strip_dither(os_led_strip_lut16(lut_r, r - w), &error[0]);
+        out[pos_g] = os_led_strip_dither(os_led_strip_lut16(lut_g, g - w), &error[1]);
+        out[pos_b] = os_led_strip_dither(os_led_strip_lut16(lut_b, b - w), &error[2]);
+        out[3] = os_led_strip_dither(os_led_strip_lut16(lut_w, w), &error[3]);
+        out += 4;
+        error += 4;
     }
-    return ret;
 }
 
-int os_led_strip_set_hsv_range(os_led_strip_t *strip, uint32_t lower_range, uint32_t upper_range, hsv_t *col)
+// The backend wants the pipeline's raw bytes rather than rgb_t
+static bool os_led_strip_sends_raw(os_led_strip_t *strip)
 {
-    // Bounds check!
-    if ((lower_range >= strip->numpixel) | (upper_range >= strip->numpixel))
+    return strip->pipeline != NULL && strip->strip_write_raw_func != NULL;
+}
+
+/**
+ * Gets a frame ready for the backend, through the pipeline if there is one, straight into the backend's own
+ * buffer when it has one and otherwise into scratch(which may be the frame itself when nothing has to change)
+ * In HDR mode the frame comes from buffer16 instead, and in palette mode from the indices
+ * Returns what still has to go through os_led_strip_send(), NULL if it's already in the backend's buffer
+ */
+static const void *os_led_strip_stage(os_led_strip_t *strip, const rgb_t *frame, void *scratch)
+{
+    void *target = scratch;
+    if (strip->backend_buffer != NULL && !os_led_strip_sends_raw(strip))
     {
-        return OS_RET_INVALID_PARAM;
+        target = strip->backend_buffer;
     }
 
-    if (lower_range >= upper_range)
+    if (strip->palette != NULL)
     {
-        return OS_RET_INVALID_PARAM;
+        int bpp = strip->pipeline != NULL ? strip->pipeline->bytes_per_pixel : 3;
+        os_led_strip_palette_expand(strip->palette, bpp, 0, strip->numpixel, (uint8_t *)target);
+    }
+    else if (strip->buffer16 != NULL)
+    {
+        os_led_strip_pipeline_run16(strip->pipeline, strip->buffer16, (uint8_t *)target, strip->numpixel);
+    }
+    else if (strip->pipeline != NULL)
+    {
+        os_led_strip_pipeline_run(strip->pipeline, frame, (uint8_t *)target, strip->numpixel);
+    }
+    else if (target != frame)
+    {
+        memcpy(target, frame, strip->numpixel * sizeof(rgb_t));
     }
 
-    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
-    if (ret != OS_RET_OK)
+    if (target == strip->backend_buffer)
     {
-        return ret;
+        return NULL;
+    }
+    return target;
+}
+
+// Sends a frame staged by os_led_strip_stage() to the backend
+static int os_led_strip_send(os_led_strip_t *strip, const void *data)
+{
+    if (os_led_strip_sends_raw(strip))
+    {
+        return strip->strip_write_raw_func(strip->strip, (const uint8_t *)data,
+                                           strip->numpixel * strip->pipeline->bytes_per_pixel);
     }
 
-    // Iterate through range of pixels to set in range
-    for (int n = lower_range; n <= upper_range; n++)
+    const rgb_t *frame = (const rgb_t *)data;
+    if (strip->strip_write_func != NULL)
     {
-        rgb_t col_rgb = hsv2rgb(col[lower_range + n]);
+        return strip->strip_write_func(strip->strip, 0, frame, strip->numpixel);
+    }
 
-        ret = strip->strip_set_func(strip->strip, n, col_rgb.r, col_rgb.g, col_rgb.b);
+    for (int n = 0; n < strip->numpixel; n++)
+    {
+        int ret = strip->strip_set_func(strip->strip, n, frame[n].r, frame[n].g, frame[n].b);
         if (ret != OS_RET_OK)
         {
-            // Failiure somewhere, exit out!
-            int final_ret = os_mut_exit(&strip->mutex);
-            if (final_ret != OS_RET_OK)
-            {
-                return final_ret;
-            }
             return ret;
         }
     }
+    return OS_RET_OK;
+}
 
-    ret = os_mut_exit(&strip->mutex);
-    if (ret != OS_RET_OK)
+// Sends the indices out, never expanding the whole frame into memory of its own unless a raw backend needs it in one go
+static int os_led_strip_palette_send(os_led_strip_t *strip)
+{
+    if (strip->backend_buffer != NULL || os_led_strip_sends_raw(strip))
     {
-        return ret;
+        void *scratch = strip->pipeline != NULL ? (void *)strip->pipeline->out : NULL;
+        const void *data = os_led_strip_stage(strip, NULL, scratch);
+        return data == NULL ? OS_RET_OK : os_led_strip_send(strip, data);
+    }
+
+    // Pipeline output is packed into rgb_t here, so it's always 3 bytes a pixel
+    rgb_t chunk[64];
+    for (uint32_t done = 0; done < (uint32_t)strip->numpixel;)
+    {
+        uint32_t len = strip->numpixel - done < 64 ? strip->numpixel - done : 64;
+        os_led_strip_palette_expand(strip->palette, 3, done, len, (uint8_t *)chunk);
+
+        if (strip->strip_write_func != NULL)
+        {
+            int ret = strip->strip_write_func(strip->strip, done, chunk, len);
+            if (ret != OS_RET_OK)
+            {
+                return ret;
+            }
+        }
+        else
+        {
+            for (uint32_t n = 0; n < len; n++)
+            {
+                int ret = strip->strip_set_func(strip->strip, done + n, chunk[n].r, chunk[n].g, chunk[n].b);
+                if (ret != OS_RET_OK)
+                {
+                    return ret;
+                }
+            }
+        }
+        done += len;
     }
-    return ret;
+    return OS_RET_OK;
 }
 
-int os_led_strip_fill_rgb_range(os_led_strip_t *strip, uint32_t lower_range, uint32_t upper_range, rgb_t col)
+// Sets a run of pixels to one color, mutex has to be held
+static int os_led_strip_fill_locked(os_led_strip_t *strip, uint32_t offset, rgb_t col, uint32_t count)
 {
-    // Bounds check!
-    if ((lower_range >= strip->numpixel) | (upper_range >= strip->numpixel))
+    if (strip->palette != NULL)
     {
-        return OS_RET_INVALID_PARAM;
+        os_led_strip_palette_fill(strip->palette, offset, count, os_led_strip_palette_lookup(strip->palette, col));
+        return OS_RET_OK;
     }
 
-    if (lower_range >= upper_range)
+    if (strip->buffer16 != NULL)
     {
-        return OS_RET_INVALID_PARAM;
+        rgb16_t col16 = {(uint16_t)(col.r * 257), (uint16_t)(col.g * 257), (uint16_t)(col.b * 257)};
+        for (uint32_t n = 0; n < count; n++)
+        {
+            strip->buffer16[offset + n] = col16;
+        }
+        return OS_RET_OK;
     }
 
-    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
-    if (ret != OS_RET_OK)
+    if (strip->buffer != NULL)
     {
-        return ret;
+        for (uint32_t n = 0; n < count; n++)
+        {
+            strip->buffer[offset + n] = col;
+        }
+        return OS_RET_OK;
     }
 
-    // Iterate through range of pixels to set in range
-    for (int n = lower_range; n <= upper_range; n++)
+    for (uint32_t n = 0; n < count; n++)
     {
-
-        ret = strip->strip_set_func(strip->strip, n, col.r, col.g, col.b);
+        int ret = strip->strip_set_func(strip->strip, offset + n, col.r, col.g, col.b);
         if (ret != OS_RET_OK)
         {
-            // Failiure somewhere, exit out!
-            int final_ret = os_mut_exit(&strip->mutex);
-            if (final_ret != OS_RET_OK)
-            {
-                return final_ret;
-            }
             return ret;
         }
     }
+    return OS_RET_OK;
+}
+
+// These are essentially wrapper functions since we can change the type of LED strip we want to use
+int os_led_strip_set(os_led_strip_t *strip, uint32_t pixel, uint8_t r, uint8_t g, uint8_t b)
+{
+    if (strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
 
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    int final_ret;
+    if (strip->buffer != NULL || strip->palette != NULL)
+    {
+        final_ret = OS_RET_OK;
+        if (pixel < (uint32_t)strip->numpixel)
+        {
+            rgb_t col = {r, g, b};
+            os_led_strip_write_locked(strip, pixel, &col, 1);
+        }
+        else
+        {
+            final_ret = OS_RET_INVALID_PARAM;
+        }
+    }
+    else
+    {
+        final_ret = strip->strip_set_func(strip->strip, pixel, r, g, b);
+    }
     ret = os_mut_exit(&strip->mutex);
     if (ret != OS_RET_OK)
     {
         return ret;
     }
-    return ret;
+    return final_ret;
 }
 
-int os_led_strip_fill_hsv_range(os_led_strip_t *strip, uint32_t lower_range, uint32_t upper_range, hsv_t col)
+int os_led_strip_show(os_led_strip_t *strip)
 {
-    // Bounds check!
-    if ((lower_range >= strip->numpixel) | (upper_range >= strip->numpixel))
+
+    if (strip == NULL)
     {
-        return OS_RET_INVALID_PARAM;
+        return OS_RET_NULL_PTR;
     }
 
-    if (lower_range >= upper_range)
+    if (strip->async != NULL)
     {
-        return OS_RET_INVALID_PARAM;
+        int ret = os_led_strip_show_async(strip);
+        if (ret != OS_RET_OK)
+        {
+            return ret;
+        }
+        return os_led_strip_wait_show(strip);
     }
 
     int ret = os_mut_entry_wait_indefinite(&strip->mutex);
@@ -287,35 +653,1299 @@ int os_led_strip_fill_hsv_range(os_led_strip_t *strip, uint32_t lower_range, uin
     {
         return ret;
     }
-    rgb_t col_rgb = hsv2rgb(col);
-
-    // Iterate through range of pixels to set in range
-    for (int n = lower_range; n <= upper_range; n++)
+    int final_ret = os_led_strip_collect_segments(strip);
+    // The shadow buffer is the only up to date copy, so it all goes out first
+    if (final_ret == OS_RET_OK && strip->palette != NULL)
     {
-        ret = strip->strip_set_func(strip->strip, n, col_rgb.r, col_rgb.g, col_rgb.b);
-        if (ret != OS_RET_OK)
+        final_ret = os_led_strip_palette_send(strip);
+    }
+    else if (final_ret == OS_RET_OK && strip->buffer != NULL && !strip->buffer_native)
+    {
+        void *scratch = strip->pipeline != NULL ? (void *)strip->pipeline->out : (void *)strip->buffer;
+        const void *data = os_led_strip_stage(strip, strip->buffer, scratch);
+        if (data != NULL)
         {
-            // Failiure somewhere, exit out!
-            int final_ret = os_mut_exit(&strip->mutex);
-            if (final_ret != OS_RET_OK)
-            {
-                return final_ret;
-            }
-            return ret;
+            final_ret = os_led_strip_send(strip, data);
         }
     }
-
+    if (final_ret == OS_RET_OK)
+    {
+        final_ret = strip->strip_show_func(strip->strip);
+    }
     ret = os_mut_exit(&strip->mutex);
     if (ret != OS_RET_OK)
     {
         return ret;
     }
-    return ret;
+    return final_ret;
 }
 
-int os_led_strip_set_hsv(os_led_strip_t *strip, uint32_t pixel, hsv_t col)
+int os_led_strip_set_rgb(os_led_strip_t *strip, uint32_t pixel, rgb_t col)
 {
-    rgb_t col_rgb = hsv2rgb(col);
-    return os_led_strip_set(strip, pixel, col_rgb.r, col_rgb.g, col_rgb.b);
+    return os_led_strip_set(strip, pixel, col.r, col.g, col.b);
 }
-#endif
\ No newline at end of file
+
+const uint8_t os_led_color_order_pos[6][3] = {
+    {0, 1, 2}, // RGB
+    {0, 2, 1}, // RBG
+    {1, 0, 2}, // GRB
+    {2, 0, 1}, // GBR
+    {1, 2, 0}, // BRG
+    {2, 1, 0}, // BGR
+};
+
+// Rebuilds the pipeline's tables from its config
+static void os_led_strip_pipeline_build(os_led_strip_pipeline *pipeline)
+{
+    const os_led_strip_pipeline_config_t *config = &pipeline->config;
+    for (int ch = 0; ch < 4; ch++)
+    {
+        float gamma = config->gamma[ch] > 0.0f ? config->gamma[ch] : 1.0f;
+        for (int v = 0; v < 256; v++)
+        {
+            pipeline->lut[ch][v] = (uint8_t)lrintf(powf(v / 255.0f, gamma) * config->brightness);
+        }
+    }
+
+    // HDR tables are indexed by the top 8 bits of a 16 bit value, entry 256 is just past 65535 to interpolate towards
+    if (pipeline->error != NULL)
+    {
+        for (int ch = 0; ch < 4; ch++)
+        {
+            float gamma = config->gamma[ch] > 0.0f ? config->gamma[ch] : 1.0f;
+            for (int v = 0; v <= 256; v++)
+            {
+                pipeline->lut16[ch][v] = (uint32_t)lrintf(powf(v * 256 / 65535.0f, gamma) * config->brightness * 65536.0f);
+            }
+        }
+    }
+
+    for (int ch = 0; ch < 3; ch++)
+    {
+        pipeline->pos[ch] = os_led_color_order_pos[config->order][ch];
+    }
+    pipeline->pos[3] = 3;
+    pipeline->bytes_per_pixel = config->rgbw ? 4 : 3;
+}
+
+// Puts a run of palette entries through the pipeline, needs redoing whenever either changes
+static void os_led_strip_palette_build(os_led_strip_t *strip, int first, int count)
+{
+    os_led_strip_palette *palette = strip->palette;
+    if (strip->pipeline != NULL)
+    {
+        int bpp = strip->pipeline->bytes_per_pixel;
+        os_led_strip_pipeline_run(strip->pipeline, &palette->colors[first], &palette->wire[first * bpp], count);
+    }
+    else
+    {
+        memcpy(&palette->wire[first * 3], &palette->colors[first], count * sizeof(rgb_t));
+    }
+    palette->last_valid = false;
+}
+
+/**
+ * Takes the strip mutex once no frame is going out, for anything that touches what the show thread uses
+ * Waits for the frame without holding the mutex so drawing isn't held up
+ */
+static int os_led_strip_lock_idle(os_led_strip_t *strip)
+{
+    os_led_strip_async *async = strip->async;
+    for (;;)
+    {
+        while (async != NULL && async->busy.load(std::memory_order_acquire))
+        {
+            os_waitbits_indefinite(&async->frame_done, 0);
+        }
+
+        int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+        if (ret != OS_RET_OK)
+        {
+            return ret;
+        }
+        if (async == NULL || !async->busy.load(std::memory_order_acquire))
+        {
+            return OS_RET_OK;
+        }
+        os_mut_exit(&strip->mutex);
+    }
+}
+
+int os_led_strip_set_brightness(os_led_strip_t *strip, uint8_t brightness)
+{
+    if (strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    // The backend's brightness can't change under a frame that's still going out
+    int ret = os_led_strip_lock_idle(strip);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // Pipeline does brightness itself, the backend stays at full
+    int final_ret = OS_RET_OK;
+    if (strip->pipeline != NULL)
+    {
+        strip->pipeline->config.brightness = brightness;
+        os_led_strip_pipeline_build(strip->pipeline);
+        if (strip->palette != NULL)
+        {
+            os_led_strip_palette_build(strip, 0, strip->palette->num_colors);
+        }
+    }
+    else
+    {
+        final_ret = strip->strip_update_brightness_func(strip->strip, brightness);
+    }
+
+    ret = os_mut_exit(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+int os_led_strip_set_rgb_range(os_led_strip_t *strip, uint32_t lower_range, uint32_t upper_range, rgb_t *col)
+{
+    if (strip == NULL || col == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    // Bounds check!
+    if ((lower_range >= strip->numpixel) | (upper_range >= strip->numpixel))
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    if (lower_range >= upper_range)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // col[0] goes to lower_range
+    int final_ret = os_led_strip_write_locked(strip, lower_range, col, upper_range - lower_range + 1);
+
+    ret = os_mut_exit(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+int os_led_strip_set_hsv_range(os_led_strip_t *strip, uint32_t lower_range, uint32_t upper_range, hsv_t *col)
+{
+    if (strip == NULL || col == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    // Bounds check!
+    if ((lower_range >= strip->numpixel) | (upper_range >= strip->numpixel))
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    if (lower_range >= upper_range)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // Convert a chunk at a time so the strip still gets bulk writes
+    rgb_t chunk[32];
+    uint32_t count = upper_range - lower_range + 1;
+    int final_ret = OS_RET_OK;
+    for (uint32_t done = 0; done < count && final_ret == OS_RET_OK;)
+    {
+        uint32_t len = count - done < 32 ? count - done : 32;
+        hsv2rgb_n(&col[done], chunk, len);
+        final_ret = os_led_strip_write_locked(strip, lower_range + done, chunk, len);
+        done += len;
+    }
+
+    ret = os_mut_exit(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+int os_led_strip_fill_rgb_range(os_led_strip_t *strip, uint32_t lower_range, uint32_t upper_range, rgb_t col)
+{
+    if (strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    // Bounds check!
+    if ((lower_range >= strip->numpixel) | (upper_range >= strip->numpixel))
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    if (lower_range >= upper_range)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int final_ret = os_led_strip_fill_locked(strip, lower_range, col, upper_range - lower_range + 1);
+
+    ret = os_mut_exit(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+int os_led_strip_fill_hsv_range(os_led_strip_t *strip, uint32_t lower_range, uint32_t upper_range, hsv_t col)
+{
+    return os_led_strip_fill_rgb_range(strip, lower_range, upper_range, hsv2rgb(col));
+}
+
+int os_led_strip_write(os_led_strip_t *strip, uint32_t offset, const rgb_t *col, uint32_t count)
+{
+    if (strip == NULL || col == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (offset > (uint32_t)strip->numpixel || count > (uint32_t)strip->numpixel - offset)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    if (count == 0)
+    {
+        return OS_RET_OK;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int final_ret = os_led_strip_write_locked(strip, offset, col, count);
+
+    ret = os_mut_exit(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+/**
+ * Moves drawing off the backend's own buffer(copying what's been drawn so far) or out of nothing into a shadow buffer,
+ * the strip is left untouched if we run out of memory. Nothing to do in palette mode, drawing goes into the indices.
+ * Mutex has to be held
+ */
+static int os_led_strip_use_shadow(os_led_strip_t *strip)
+{
+    if (strip->palette != NULL || (strip->buffer != NULL && !strip->buffer_native))
+    {
+        return OS_RET_OK;
+    }
+
+    rgb_t *shadow = (rgb_t *)malloc(strip->numpixel * sizeof(rgb_t));
+    if (shadow == NULL)
+    {
+        return OS_RET_LOW_MEM_ERROR;
+    }
+    if (strip->buffer != NULL)
+    {
+        memcpy(shadow, strip->buffer, strip->numpixel * sizeof(rgb_t));
+    }
+    else
+    {
+        memset(shadow, 0, strip->numpixel * sizeof(rgb_t));
+    }
+
+    strip->buffer = shadow;
+    strip->buffer_native = false;
+    return OS_RET_OK;
+}
+
+rgb_t *os_led_strip_get_buffer(os_led_strip_t *strip)
+{
+    if (strip == NULL)
+    {
+        return NULL;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return NULL;
+    }
+
+    if (strip->buffer == NULL)
+    {
+        os_led_strip_use_shadow(strip);
+    }
+    // Drawing into the 8 bit buffer would never show up
+    rgb_t *buffer = strip->buffer16 == NULL ? strip->buffer : NULL;
+
+    os_mut_exit(&strip->mutex);
+    return buffer;
+}
+
+int os_led_strip_enable_async(os_led_strip_t *strip, os_led_strip_done_cb_t callback, void *arg)
+{
+    if (strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (strip->async != NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    os_led_strip_async *async = new os_led_strip_async;
+    async->front = NULL;
+    async->staged = NULL;
+    async->busy = false;
+    async->last_ret = OS_RET_OK;
+    async->done_us = 0;
+    async->callback = callback;
+    async->callback_arg = arg;
+    os_setbits_init(&async->frame_ready);
+    os_setbits_init(&async->frame_done);
+
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        delete async;
+        return ret;
+    }
+
+    // Frame gets snapshotted here whenever it can't go straight into the backend's buffer
+    async->front = (uint8_t *)malloc(strip->numpixel * 4);
+
+    // Drawing has to go somewhere other than the frame on the wire, so we always need a shadow buffer
+    if (async->front == NULL || os_led_strip_use_shadow(strip) != OS_RET_OK)
+    {
+        free(async->front);
+        delete async;
+        os_mut_exit(&strip->mutex);
+        return OS_RET_LOW_MEM_ERROR;
+    }
+
+    strip->async = async;
+
+    return os_mut_exit(&strip->mutex);
+}
+
+// Frame is out on the strip, called by the show thread or the backend
+static void os_led_strip_async_done(void *arg, int ret)
+{
+    os_led_strip_t *strip = (os_led_strip_t *)arg;
+    os_led_strip_async *async = strip->async;
+
+    async->last_ret = ret;
+    async->done_us = os_time_us();
+    async->busy.store(false, std::memory_order_release);
+    os_setbits_signal(&async->frame_done, 0);
+
+    if (async->callback != NULL)
+    {
+        async->callback(strip, ret, async->callback_arg);
+    }
+}
+
+void os_led_strip_show_thread(void *params)
+{
+    os_led_strip_t *strip = (os_led_strip_t *)params;
+    if (strip == NULL || strip->async == NULL)
+    {
+        return;
+    }
+
+    os_led_strip_async *async = strip->async;
+    for (;;)
+    {
+        os_waitbits_indefinite(&async->frame_ready, 0);
+        os_clearbits(&async->frame_ready, 0);
+
+        // Drawing only touches the shadow buffer, so the backend is ours without the mutex until the frame is out
+        int ret = OS_RET_OK;
+        if (async->staged != NULL)
+        {
+            ret = os_led_strip_send(strip, async->staged);
+        }
+        if (ret == OS_RET_OK)
+        {
+            ret = strip->strip_show_func(strip->strip);
+        }
+
+        os_led_strip_async_done(strip, ret);
+    }
+}
+
+int os_led_strip_show_async(os_led_strip_t *strip)
+{
+    if (strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_led_strip_async *async = strip->async;
+    if (async == NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    // Previous frame has to be out before its buffer is reused
+    int ret = os_led_strip_lock_idle(strip);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // Latest frames from the producers, async strips always draw into a shadow buffer or indices so this can't fail
+    os_led_strip_collect_segments(strip);
+
+    // Snapshot, after this drawing can carry on into the shadow buffer. Async backends take the frame before
+    // starting, so unless it has to be changed on the way there's no need to copy it first
+    void *scratch = async->front;
+    if (strip->pipeline == NULL && strip->palette == NULL && strip->strip_show_async_func != NULL)
+    {
+        scratch = strip->buffer;
+    }
+    async->staged = os_led_strip_stage(strip, strip->buffer, scratch);
+
+    int final_ret = OS_RET_OK;
+    if (strip->strip_show_async_func != NULL && async->staged != NULL)
+    {
+        final_ret = os_led_strip_send(strip, async->staged);
+    }
+
+    if (final_ret == OS_RET_OK)
+    {
+        os_clearbits(&async->frame_done, 0);
+        async->busy.store(true, std::memory_order_release);
+        if (strip->strip_show_async_func != NULL)
+        {
+            final_ret = strip->strip_show_async_func(strip->strip, os_led_strip_async_done, strip);
+            if (final_ret != OS_RET_OK)
+            {
+                async->busy.store(false, std::memory_order_release);
+                os_setbits_signal(&async->frame_done, 0);
+            }
+        }
+        else
+        {
+            os_setbits_signal(&async->frame_ready, 0);
+        }
+    }
+
+    ret = os_mut_exit(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+int os_led_strip_wait_show(os_led_strip_t *strip)
+{
+    if (strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_led_strip_async *async = strip->async;
+    if (async == NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    while (async->busy.load(std::memory_order_acquire))
+    {
+        os_waitbits_indefinite(&async->frame_done, 0);
+    }
+
+    return async->last_ret;
+}
+
+int os_led_strip_set_pipeline(os_led_strip_t *strip, const os_led_strip_pipeline_config_t *config)
+{
+    if (strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (config != NULL)
+    {
+        if ((unsigned)config->order > LED_ORDER_BGR)
+        {
+            return OS_RET_INVALID_PARAM;
+        }
+        // rgb_t can't carry a fourth channel
+        if (config->rgbw && strip->strip_write_raw_func == NULL)
+        {
+            return OS_RET_INVALID_PARAM;
+        }
+    }
+
+    // The show thread reads the pipeline while sending a frame
+    int ret = os_led_strip_lock_idle(strip);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int final_ret = OS_RET_OK;
+    os_led_strip_pipeline *pipeline = strip->pipeline;
+    if (config == NULL)
+    {
+        // HDR can't do without it
+        if (strip->buffer16 != NULL)
+        {
+            final_ret = OS_RET_INVALID_PARAM;
+        }
+        else if (pipeline != NULL)
+        {
+            strip->pipeline = NULL;
+            final_ret = strip->strip_update_brightness_func(strip->strip, pipeline->config.brightness);
+            free(pipeline->out);
+            delete pipeline;
+            if (strip->palette != NULL)
+            {
+                os_led_strip_palette_build(strip, 0, strip->palette->num_colors);
+            }
+        }
+        ret = os_mut_exit(&strip->mutex);
+        if (ret != OS_RET_OK)
+        {
+            return ret;
+        }
+        return final_ret;
+    }
+
+    if (pipeline == NULL)
+    {
+        pipeline = new os_led_strip_pipeline;
+        pipeline->out = (uint8_t *)malloc(strip->numpixel * 4);
+        pipeline->error = NULL;
+    }
+
+    // The pipeline reads what was drawn and writes what gets sent, those can't be the same buffer.
+    // Palette indices get their colors through the pipeline ahead of time, so they don't need one
+    if (pipeline->out == NULL || os_led_strip_use_shadow(strip) != OS_RET_OK)
+    {
+        if (pipeline != strip->pipeline)
+        {
+            free(pipeline->out);
+            delete pipeline;
+        }
+        os_mut_exit(&strip->mutex);
+        return OS_RET_LOW_MEM_ERROR;
+    }
+
+    pipeline->config = *config;
+    os_led_strip_pipeline_build(pipeline);
+    if (strip->pipeline == NULL)
+    {
+        strip->pipeline = pipeline;
+        final_ret = strip->strip_update_brightness_func(strip->strip, 255);
+    }
+    if (strip->palette != NULL)
+    {
+        os_led_strip_palette_build(strip, 0, strip->palette->num_colors);
+    }
+
+    ret = os_mut_exit(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+int os_led_strip_enable_hdr(os_led_strip_t *strip)
+{
+    if (strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    // Indices can't hold anything in between palette colors
+    if (strip->palette != NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    if (strip->pipeline == NULL)
+    {
+        os_led_strip_pipeline_config_t config = {{0, 0, 0, 0}, 255, LED_ORDER_RGB, false};
+        int ret = os_led_strip_set_pipeline(strip, &config);
+        if (ret != OS_RET_OK)
+        {
+            return ret;
+        }
+    }
+
+    int ret = os_led_strip_lock_idle(strip);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int final_ret = OS_RET_OK;
+    if (strip->buffer16 == NULL)
+    {
+        os_led_strip_pipeline *pipeline = strip->pipeline;
+        rgb16_t *buffer16 = (rgb16_t *)malloc(strip->numpixel * sizeof(rgb16_t));
+        pipeline->error = (uint8_t *)malloc(strip->numpixel * 4);
+        if (buffer16 == NULL || pipeline->error == NULL)
+        {
+            free(buffer16);
+            free(pipeline->error);
+            pipeline->error = NULL;
+            final_ret = OS_RET_LOW_MEM_ERROR;
+        }
+        else
+        {
+            // Starting halfway rounds the first frame instead of truncating it
+            memset(pipeline->error, 0x80, strip->numpixel * 4);
+
+            // Carry on from whatever was drawn so far
+            for (int n = 0; n < strip->numpixel; n++)
+            {
+                buffer16[n] = {(uint16_t)(strip->buffer[n].r * 257), (uint16_t)(strip->buffer[n].g * 257),
+                               (uint16_t)(strip->buffer[n].b * 257)};
+            }
+            os_led_strip_pipeline_build(pipeline);
+            strip->buffer16 = buffer16;
+        }
+    }
+
+    ret = os_mut_exit(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+rgb16_t *os_led_strip_get_buffer16(os_led_strip_t *strip)
+{
+    if (strip == NULL)
+    {
+        return NULL;
+    }
+
+    return strip->buffer16;
+}
+
+int os_led_strip_write16(os_led_strip_t *strip, uint32_t offset, const rgb16_t *col, uint32_t count)
+{
+    if (strip == NULL || col == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (strip->buffer16 == NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    if (offset > (uint32_t)strip->numpixel || count > (uint32_t)strip->numpixel - offset)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    memcpy(&strip->buffer16[offset], col, count * sizeof(rgb16_t));
+
+    return os_mut_exit(&strip->mutex);
+}
+
+static void os_led_strip_palette_free(os_led_strip_palette *palette)
+{
+    free(palette->colors);
+    free(palette->wire);
+    free(palette->indices);
+    delete palette;
+}
+
+int os_led_strip_enable_palette(os_led_strip_t *strip, uint8_t bits, const rgb_t *colors, int num_colors)
+{
+    if (strip == NULL || colors == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if ((bits != 4 && bits != 8) || num_colors < 1 || num_colors > (1 << bits))
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    os_led_strip_palette *palette = new os_led_strip_palette;
+    palette->bits = bits;
+    palette->num_colors = 1 << bits;
+    palette->colors = (rgb_t *)calloc(palette->num_colors, sizeof(rgb_t));
+    palette->wire = (uint8_t *)malloc(palette->num_colors * 4);
+    palette->indices = (uint8_t *)calloc((strip->numpixel * bits + 7) / 8, 1);
+    palette->last_valid = false;
+    if (palette->colors == NULL || palette->wire == NULL || palette->indices == NULL)
+    {
+        os_led_strip_palette_free(palette);
+        return OS_RET_LOW_MEM_ERROR;
+    }
+    memcpy(palette->colors, colors, num_colors * sizeof(rgb_t));
+
+    // Swapping out the buffer under a frame that's going out would be bad
+    int ret = os_led_strip_lock_idle(strip);
+    if (ret != OS_RET_OK)
+    {
+        os_led_strip_palette_free(palette);
+        return ret;
+    }
+
+    int final_ret = OS_RET_OK;
+    if (strip->palette != NULL || strip->buffer16 != NULL)
+    {
+        os_led_strip_palette_free(palette);
+        final_ret = OS_RET_INVALID_PARAM;
+    }
+    else
+    {
+        // Carry on from whatever was drawn so far
+        if (strip->buffer != NULL)
+        {
+            for (int n = 0; n < strip->numpixel; n++)
+            {
+                os_led_strip_palette_put(palette, n, os_led_strip_palette_lookup(palette, strip->buffer[n]));
+            }
+        }
+
+        // The point is to not have numpixel colors around anymore, the backend's own buffer stays its own
+        if (!strip->buffer_native)
+        {
+            free(strip->buffer);
+        }
+        strip->buffer = NULL;
+        strip->buffer_native = false;
+        strip->palette = palette;
+        os_led_strip_palette_build(strip, 0, palette->num_colors);
+    }
+
+    ret = os_mut_exit(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+int os_led_strip_set_palette(os_led_strip_t *strip, uint8_t first, const rgb_t *colors, int count)
+{
+    if (strip == NULL || colors == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_led_strip_palette *palette = strip->palette;
+    if (palette == NULL || count < 1 || first + count > palette->num_colors)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    memcpy(&palette->colors[first], colors, count * sizeof(rgb_t));
+    os_led_strip_palette_build(strip, first, count);
+
+    return os_mut_exit(&strip->mutex);
+}
+
+int os_led_strip_set_palette_hsv(os_led_strip_t *strip, uint8_t first, const hsv_t *colors, int count)
+{
+    if (strip == NULL || colors == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_led_strip_palette *palette = strip->palette;
+    if (palette == NULL || count < 1 || first + count > palette->num_colors)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    hsv2rgb_n(colors, &palette->colors[first], count);
+    os_led_strip_palette_build(strip, first, count);
+
+    return os_mut_exit(&strip->mutex);
+}
+
+int os_led_strip_rotate_palette(os_led_strip_t *strip, uint8_t first, int count, int steps)
+{
+    if (strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_led_strip_palette *palette = strip->palette;
+    if (palette == NULL || count < 1 || first + count > palette->num_colors)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    steps %= count;
+    if (steps < 0)
+    {
+        steps += count;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    rgb_t rotated[256];
+    for (int n = 0; n < count; n++)
+    {
+        int from = n - steps;
+        rotated[n] = palette->colors[first + (from < 0 ? from + count : from)];
+    }
+    memcpy(&palette->colors[first], rotated, count * sizeof(rgb_t));
+    os_led_strip_palette_build(strip, first, count);
+
+    return os_mut_exit(&strip->mutex);
+}
+
+int os_led_strip_set_index(os_led_strip_t *strip, uint32_t pixel, uint8_t index)
+{
+    return os_led_strip_fill_index(strip, pixel, 1, index);
+}
+
+int os_led_strip_fill_index(os_led_strip_t *strip, uint32_t offset, uint32_t count, uint8_t index)
+{
+    if (strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_led_strip_palette *palette = strip->palette;
+    if (palette == NULL || index >= palette->num_colors)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    if (offset > (uint32_t)strip->numpixel || count > (uint32_t)strip->numpixel - offset)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    os_led_strip_palette_fill(palette, offset, count, index);
+
+    return os_mut_exit(&strip->mutex);
+}
+
+int os_led_strip_write_index(os_led_strip_t *strip, uint32_t offset, const uint8_t *indices, uint32_t count)
+{
+    if (strip == NULL || indices == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_led_strip_palette *palette = strip->palette;
+    if (palette == NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    if (offset > (uint32_t)strip->numpixel || count > (uint32_t)strip->numpixel - offset)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    if (palette->bits == 8)
+    {
+        memcpy(&palette->indices[offset], indices, count);
+    }
+    else
+    {
+        for (uint32_t n = 0; n < count; n++)
+        {
+            os_led_strip_palette_put(palette, offset + n, indices[n]);
+        }
+    }
+
+    return os_mut_exit(&strip->mutex);
+}
+
+static void os_led_strip_segment_free(os_led_strip_segment *seg)
+{
+    for (int n = 0; n < 3; n++)
+    {
+        free(seg->buffers[n]);
+    }
+    delete seg;
+}
+
+int os_led_strip_add_segment(os_led_strip_t *strip, uint32_t offset, uint32_t count, os_led_strip_segment_t **segment)
+{
+    if (strip == NULL || segment == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (count == 0 || offset > (uint32_t)strip->numpixel || count > (uint32_t)strip->numpixel - offset)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    os_led_strip_segment *seg = new os_led_strip_segment;
+    seg->offset = offset;
+    seg->count = count;
+    seg->back = 0;
+    seg->ready = 1;
+    seg->front = 2;
+    seg->next = NULL;
+    bool low_mem = false;
+    for (int n = 0; n < 3; n++)
+    {
+        seg->buffers[n] = (rgb_t *)calloc(count, sizeof(rgb_t));
+        low_mem |= seg->buffers[n] == NULL;
+    }
+    if (low_mem)
+    {
+        os_led_strip_segment_free(seg);
+        return OS_RET_LOW_MEM_ERROR;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        os_led_strip_segment_free(seg);
+        return ret;
+    }
+
+    int final_ret = OS_RET_OK;
+    for (os_led_strip_segment *other = strip->segments; other != NULL; other = other->next)
+    {
+        if (offset < other->offset + other->count && other->offset < offset + count)
+        {
+            final_ret = OS_RET_INVALID_PARAM;
+            break;
+        }
+    }
+
+    if (final_ret == OS_RET_OK)
+    {
+        seg->next = strip->segments;
+        strip->segments = seg;
+        *segment = seg;
+    }
+    else
+    {
+        os_led_strip_segment_free(seg);
+    }
+
+    ret = os_mut_exit(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+int os_led_strip_remove_segment(os_led_strip_t *strip, os_led_strip_segment_t *segment)
+{
+    if (strip == NULL || segment == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&strip->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int final_ret = OS_RET_INVALID_PARAM;
+    for (os_led_strip_segment **link = &strip->segments; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == segment)
+        {
+            *link = segment->next;
+            final_ret = OS_RET_OK;
+            break;
+        }
+    }
+
+    ret = os_mut_exit(&strip->mutex);
+    if (final_ret == OS_RET_OK)
+    {
+        os_led_strip_segment_free(segment);
+    }
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+rgb_t *os_led_strip_segment_buffer(os_led_strip_segment_t *segment)
+{
+    if (segment == NULL)
+    {
+        return NULL;
+    }
+
+    return segment->buffers[segment->back];
+}
+
+rgb_t *os_led_strip_segment_publish(os_led_strip_segment_t *segment)
+{
+    if (segment == NULL)
+    {
+        return NULL;
+    }
+
+    // Release so show sees the whole frame once it sees the swap, whatever was published before and never shown comes back
+    uint8_t published = segment->back | OS_LED_STRIP_SEGMENT_FRESH;
+    segment->back = segment->ready.exchange(published, std::memory_order_acq_rel) & ~OS_LED_STRIP_SEGMENT_FRESH;
+    return segment->buffers[segment->back];
+}
+
+int os_led_strip_set_hsv(os_led_strip_t *strip, uint32_t pixel, hsv_t col)
+{
+    rgb_t col_rgb = hsv2rgb(col);
+    return os_led_strip_set(strip, pixel, col_rgb.r, col_rgb.g, col_rgb.b);
+}
+
+int os_led_strip_group_init(os_led_strip_group_t *group, uint32_t fps)
+{
+    if (group == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    group->num_strips = 0;
+    group->frame_period_us = fps == 0 ? 0 : 1000000 / fps;
+    group->next_frame_us = 0;
+    group->in_flight = false;
+    group->frame_start_us = 0;
+    memset(&group->stats, 0, sizeof(group->stats));
+
+    return os_mut_init(&group->mutex);
+}
+
+int os_led_strip_group_add(os_led_strip_group_t *group, os_led_strip_t *strip)
+{
+    if (group == NULL || strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    // Showing without waiting on each strip is what lets them all go out at once
+    if (strip->async == NULL)
+    {
+        int ret = os_led_strip_enable_async(strip, NULL, NULL);
+        if (ret != OS_RET_OK)
+        {
+            return ret;
+        }
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&group->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int final_ret = OS_RET_OK;
+    if (group->num_strips < OS_LED_STRIP_GROUP_MAX_STRIPS)
+    {
+        group->strips[group->num_strips++] = strip;
+    }
+    else
+    {
+        final_ret = OS_RET_INVALID_PARAM;
+    }
+
+    ret = os_mut_exit(&group->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+// Waits for every strip to finish the frame in flight, group mutex has to be held
+static int os_led_strip_group_finish(os_led_strip_group_t *group)
+{
+    if (!group->in_flight)
+    {
+        return OS_RET_OK;
+    }
+
+    // Timed off when the slowest strip finished, not when we got around to checking
+    int final_ret = OS_RET_OK;
+    int64_t frame_end_us = group->frame_start_us;
+    for (int n = 0; n < group->num_strips; n++)
+    {
+        int ret = os_led_strip_wait_show(group->strips[n]);
+        if (ret != OS_RET_OK && final_ret == OS_RET_OK)
+        {
+            final_ret = ret;
+        }
+        if (group->strips[n]->async->done_us > frame_end_us)
+        {
+            frame_end_us = group->strips[n]->async->done_us;
+        }
+    }
+
+    uint32_t frame_us = (uint32_t)(frame_end_us - group->frame_start_us);
+    group->stats.last_frame_us = frame_us;
+    if (frame_us > group->stats.max_frame_us)
+    {
+        group->stats.max_frame_us = frame_us;
+    }
+    group->in_flight = false;
+
+    return final_ret;
+}
+
+int os_led_strip_group_show(os_led_strip_group_t *group)
+{
+    if (group == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&group->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    // Every strip has to be done with the last frame before any of them get the next one
+    int final_ret = os_led_strip_group_finish(group);
+
+    if (os_frame_clock_wait(&group->next_frame_us, group->frame_period_us) && group->stats.frames_shown > 0)
+    {
+        group->stats.late_frames++;
+    }
+
+    // Snapshot and start each strip, the transfers themselves all run side by side
+    group->frame_start_us = os_time_us();
+    for (int n = 0; n < group->num_strips; n++)
+    {
+        ret = os_led_strip_show_async(group->strips[n]);
+        if (ret != OS_RET_OK && final_ret == OS_RET_OK)
+        {
+            final_ret = ret;
+        }
+    }
+    group->stats.last_start_skew_us = (uint32_t)(os_time_us() - group->frame_start_us);
+    group->stats.frames_shown++;
+    group->in_flight = true;
+
+    ret = os_mut_exit(&group->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+int os_led_strip_group_wait(os_led_strip_group_t *group)
+{
+    if (group == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&group->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int final_ret = os_led_strip_group_finish(group);
+
+    ret = os_mut_exit(&group->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return final_ret;
+}
+
+int os_led_strip_group_get_stats(os_led_strip_group_t *group, os_led_strip_group_stats_t *stats)
+{
+    if (group == NULL || stats == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    int ret = os_mut_entry_wait_indefinite(&group->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    *stats = group->stats;
+
+    return os_mut_exit(&group->mutex);
+}
+#endif
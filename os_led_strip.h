@@ -262,6 +262,72 @@ int _spi_dma_os_led_strip_show(_os_led_strip_t *strip);
 int _spi_dma_os_led_strip_set_brightness(_os_led_strip_t *strip, uint8_t brightness);
 #endif
 
+// Host side strip that just keeps track of what it would have sent, taking as long as a WS2812 strip would
+#ifdef LED_STRIP_SIMULATED
+/**
+ * @brief Initializes a simulated LED strip, bus and gpio are ignored
+ *
+ * @param bus The bus number.
+ * @param gpio The GPIO pin number.
+ * @param numpixels Number of pixels in the LED strip.
+ * @return Pointer to the initialized LED strip on success, NULL on failure.
+ */
+_os_led_strip_t *_sim_os_led_strip_init(int bus, int gpio, uint32_t numpixels);
+
+/**
+ * @brief Stops the simulated strip's transfer thread and frees it
+ *
+ * @param strip Pointer to the LED strip to be freed.
+ * @return OS_RET_NULL_PTR if strip is NULL, OS_RET_OK otherwise.
+ */
+int free_sim_strip(_os_led_strip_t *strip);
+
+/**
+ * @brief Sets the color of a specific pixel in the LED strip.
+ *
+ * @param strip Pointer to the LED strip.
+ * @param pixel Index of the pixel to set.
+ * @param r Red component (0-255).
+ * @param g Green component (0-255).
+ * @param b Blue component (0-255).
+ * @return OS_RET_NULL_PTR if strip is NULL, OS_RET_OK otherwise.
+ */
+int _sim_os_led_strip_set(_os_led_strip_t *strip, uint32_t pixel, uint8_t r, uint8_t g, uint8_t b);
+
+/**
+ * @brief "Sends" the pixels, blocking for as long as the real strip would take
+ *
+ * @param strip Pointer to the LED strip.
+ * @return OS_RET_NULL_PTR if strip is NULL, OS_RET_OK otherwise.
+ */
+int _sim_os_led_strip_show(_os_led_strip_t *strip);
+
+/**
+ * @brief Sets the updated brighntess for the led strip
+ * @param strip Pointer to LED strip
+ * @param uint8_t brightness level(0-255)
+ */
+int _sim_led_strip_set_brightness(_os_led_strip_t *strip, uint8_t brightness);
+
+/**
+ * @brief Gets the pixel buffer the simulated strip sends out on show
+ * @param strip Pointer to LED strip
+ */
+rgb_t *_sim_os_led_strip_get_buffer(_os_led_strip_t *strip);
+
+/**
+ * @brief Starts "sending" the pixels on the strip's own thread, done is called once it would be over
+ * @param strip Pointer to LED strip
+ */
+int _sim_os_led_strip_show_async(_os_led_strip_t *strip, void (*done)(void *arg, int ret), void *arg);
+
+/**
+ * @brief Colors currently "on" the simulated strip, brightness applied
+ * @param strip Pointer to LED strip
+ */
+const rgb_t *_sim_os_led_strip_get_output(_os_led_strip_t *strip);
+#endif
+
 typedef enum
 {
 #ifdef NEOPIXEL_LED_STRIP
@@ -279,6 +345,9 @@ typedef enum
 #ifdef FASTLED_I2S
     STRIP_FASTLED_I2S_DMA_RGB,
 #endif
+#ifdef LED_STRIP_SIMULATED
+    STRIP_SIMULATED_RGB,
+#endif
 } led_strip_type_t;
 
 /**
@@ -288,6 +357,62 @@ typedef int (*led_strip_set_t)(_os_led_strip_t *strip, uint32_t pixel, uint8_t r
 typedef int (*led_strip_show_t)(_os_led_strip_t *strip);
 typedef int (*led_strip_update_brightness_t)(_os_led_strip_t *strip, uint8_t brightness);
 
+/**
+ * @brief (optional)Pointer function for setting a run of pixels in one call
+ */
+typedef int (*led_strip_write_t)(_os_led_strip_t *strip, uint32_t offset, const rgb_t *col, uint32_t count);
+
+/**
+ * @brief (optional)Pointer function returning the numpixels rgb_t buffer the backend sends out on show, NULL if it has none
+ */
+typedef rgb_t *(*led_strip_get_buffer_t)(_os_led_strip_t *strip);
+
+/**
+ * @brief (optional)Pointer function that starts sending out the pixels and returns right away,
+ * the backend calls done(arg, ret) once the transfer is over(ie from its DMA complete interrupt)
+ */
+typedef int (*led_strip_show_async_t)(_os_led_strip_t *strip, void (*done)(void *arg, int ret), void *arg);
+
+/**
+ * @brief (optional)Pointer function taking a whole frame already in wire order, 3 or 4(RGBW) bytes a pixel,
+ * needed for RGBW output and to skip unpacking the pipeline's output back into rgb_t
+ */
+typedef int (*led_strip_write_raw_t)(_os_led_strip_t *strip, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Order the color bytes go out on the wire, ie most WS2812s are LED_ORDER_GRB
+ */
+typedef enum
+{
+    LED_ORDER_RGB,
+    LED_ORDER_RBG,
+    LED_ORDER_GRB,
+    LED_ORDER_GBR,
+    LED_ORDER_BRG,
+    LED_ORDER_BGR,
+} os_led_color_order_t;
+
+/**
+ * @brief Byte within a pixel that r, g and b go to, indexed by os_led_color_order_t
+ */
+extern const uint8_t os_led_color_order_pos[6][3];
+
+/**
+ * @brief What happens to a frame on its way out to the strip
+ */
+typedef struct os_led_strip_pipeline_config
+{
+    float gamma[4];             /**< Per channel gamma, r, g, b, w. 0 or 1 leaves the channel linear */
+    uint8_t brightness;         /**< Global brightness, folded into the gamma tables */
+    os_led_color_order_t order; /**< Order r, g and b go out in, white always goes last */
+    bool rgbw;                  /**< Pull the white channel out of r, g and b, needs strip_write_raw_func */
+} os_led_strip_pipeline_config_t;
+
+struct os_led_strip_async;
+struct os_led_strip_pipeline;
+struct os_led_strip_palette;
+struct os_led_strip_segment;
+
 typedef struct os_led_strip_t
 {
     _os_led_strip_t *strip;
@@ -299,6 +424,34 @@ typedef struct os_led_strip_t
     led_strip_show_t strip_show_func;
     led_strip_update_brightness_t strip_update_brightness_func;
 
+    // Optional, NULL when the backend can't do them
+    led_strip_write_t strip_write_func;
+    led_strip_get_buffer_t strip_get_buffer_func;
+    led_strip_show_async_t strip_show_async_func;
+    led_strip_write_raw_t strip_write_raw_func;
+
+    // Pixel buffer everything gets written into, NULL until os_led_strip_get_buffer() unless the backend has its own
+    rgb_t *buffer;
+    // Buffer belongs to the backend, otherwise it's a shadow copy pushed to the backend on show
+    bool buffer_native;
+    // The backend's own buffer, if it has one, even once drawing has moved to a shadow buffer
+    rgb_t *backend_buffer;
+
+    // Gamma, brightness, color order and white channel, NULL unless os_led_strip_set_pipeline() was called
+    struct os_led_strip_pipeline *pipeline;
+
+    // 16 bit frame dithered down to 8 bits on show, replaces buffer once os_led_strip_enable_hdr() was called
+    rgb16_t *buffer16;
+
+    // 4 or 8 bit palette indices expanded on show, replaces buffer once os_led_strip_enable_palette() was called
+    struct os_led_strip_palette *palette;
+
+    // Frame in flight and completion signalling, NULL unless os_led_strip_enable_async() was called
+    struct os_led_strip_async *async;
+
+    // Pixel ranges owned by producers with their own buffers, picked up on show
+    struct os_led_strip_segment *segments;
+
 } os_led_strip_t;
 
 /**
@@ -390,6 +543,26 @@ int os_led_strip_set_hsv_range(os_led_strip_t *strip, uint32_t lower_range, uint
  */
 int os_led_strip_fill_hsv_range(os_led_strip_t *strip, uint32_t lower_range, uint32_t upper_range, hsv_t col);
 
+/**
+ * @brief Copies a run of colors into the strip in one go
+ * @param strip A pointer to the initialized LED strip structure.
+ * @param uint32_t offset first pixel to write
+ * @param const rgb_t *col colors to write
+ * @param uint32_t count number of pixels to write
+ */
+int os_led_strip_write(os_led_strip_t *strip, uint32_t offset, const rgb_t *col, uint32_t count);
+
+/**
+ * @brief Gets the strip's pixel buffer, so a frame can be rendered straight into it
+ * @note This is the backend's own buffer when it has one. Otherwise a shadow buffer is allocated on the first call,
+ * and from then on all writes go to it and show pushes all of it to the backend. There's no reading pixels back
+ * out of such a backend, so the shadow starts out black and the next show blanks anything set before the first call,
+ * get the buffer before drawing anything you want kept. Hold off touching the buffer while another task might be calling show.
+ * @param strip A pointer to the initialized LED strip structure.
+ * @return numpixel colors, NULL if strip is NULL, we ran out of memory or the strip is in HDR or palette mode
+ */
+rgb_t *os_led_strip_get_buffer(os_led_strip_t *strip);
+
 /**
  * @brief Shows the updated LED colors on the strip.
  *
@@ -401,12 +574,271 @@ int os_led_strip_fill_hsv_range(os_led_strip_t *strip, uint32_t lower_range, uin
  */
 int os_led_strip_show(os_led_strip_t *strip);
 
+/**
+ * @brief Called once a frame handed to os_led_strip_show_async() is out on the strip
+ * @note Might be called from the show thread or the backend's interrupt, keep it short
+ */
+typedef void (*os_led_strip_done_cb_t)(os_led_strip_t *strip, int ret, void *arg);
+
+/**
+ * @brief Lets the strip send frames in the background, drawing keeps going into a shadow buffer meanwhile
+ * @note Backends without strip_show_async_func need os_led_strip_show_thread() running.
+ * Like os_led_strip_get_buffer(), a new shadow buffer starts out black
+ * @param strip A pointer to the initialized LED strip structure.
+ * @param os_led_strip_done_cb_t callback (optional)called after each frame is sent
+ * @param void *arg passed along to callback
+ */
+int os_led_strip_enable_async(os_led_strip_t *strip, os_led_strip_done_cb_t callback, void *arg);
+
+/**
+ * @brief Show thread! Sends out frames handed over by os_led_strip_show_async() for backends that block on show
+ * @param void *params pointer to the async enabled os_led_strip_t
+ */
+void os_led_strip_show_thread(void *params);
+
+/**
+ * @brief Snapshots the current pixels and starts sending them out without waiting for the transfer
+ * @note Only waits if the previous frame is still going out. os_led_strip_show() does the same,
+ * then waits for the transfer to be done
+ * @param strip A pointer to the async enabled LED strip structure.
+ */
+int os_led_strip_show_async(os_led_strip_t *strip);
+
+/**
+ * @brief Blocks until the last frame handed to os_led_strip_show_async() is out on the strip
+ * @param strip A pointer to the async enabled LED strip structure.
+ * @return return value of sending out the last frame
+ */
+int os_led_strip_wait_show(os_led_strip_t *strip);
+
+// Most strips a single group can drive
+#define OS_LED_STRIP_GROUP_MAX_STRIPS 16
+
+/**
+ * @brief Timing of a strip group
+ */
+typedef struct os_led_strip_group_stats
+{
+    uint32_t frames_shown;       /**< Frames started on all strips */
+    uint32_t late_frames;        /**< Frames that missed their frame clock tick */
+    uint32_t last_frame_us;      /**< First strip starting to last strip being done, for the last finished frame */
+    uint32_t max_frame_us;       /**< Longest last_frame_us so far */
+    uint32_t last_start_skew_us; /**< First strip starting to last strip starting, for the last frame */
+} os_led_strip_group_stats_t;
+
+/**
+ * @brief Strips that get shown together off one frame clock
+ */
+typedef struct os_led_strip_group
+{
+    os_led_strip_t *strips[OS_LED_STRIP_GROUP_MAX_STRIPS];
+    int num_strips;
+    os_mut_t mutex;
+
+    // Frame clock, in microseconds of os_time_us()
+    uint32_t frame_period_us;
+    int64_t next_frame_us;
+
+    // Whether the last frame might still be going out, and when it started
+    bool in_flight;
+    int64_t frame_start_us;
+
+    os_led_strip_group_stats_t stats;
+} os_led_strip_group_t;
+
+/**
+ * @brief Sets up an empty strip group
+ * @param os_led_strip_group_t *group that we are setting up
+ * @param uint32_t fps frames shown per second at most, 0 to show frames as soon as they're ready
+ */
+int os_led_strip_group_init(os_led_strip_group_t *group, uint32_t fps);
+
+/**
+ * @brief Adds a strip to the group, turning on async show for it if it isn't already
+ * @note Strips without strip_show_async_func need os_led_strip_show_thread() running, one per strip
+ * @param os_led_strip_group_t *group that we are adding to
+ * @param strip A pointer to the initialized LED strip structure.
+ */
+int os_led_strip_group_add(os_led_strip_group_t *group, os_led_strip_t *strip);
+
+/**
+ * @brief Waits for the last frame and the next frame clock tick, then starts every strip in the group at once
+ * @note Returns once all strips are started, not once they're done
+ * @param os_led_strip_group_t *group that we are showing
+ */
+int os_led_strip_group_show(os_led_strip_group_t *group);
+
+/**
+ * @brief Blocks until every strip in the group is done with the last frame
+ * @param os_led_strip_group_t *group that we are waiting on
+ */
+int os_led_strip_group_wait(os_led_strip_group_t *group);
+
+/**
+ * @brief Gets the timing of a strip group
+ * @param os_led_strip_group_t *group that we want the timing of
+ * @param os_led_strip_group_stats_t *stats filled in with the current timing
+ */
+int os_led_strip_group_get_stats(os_led_strip_group_t *group, os_led_strip_group_stats_t *stats);
+
+/**
+ * @brief Run of pixels one producer draws on its own, without taking the strip mutex
+ */
+typedef struct os_led_strip_segment os_led_strip_segment_t;
+
+/**
+ * @brief Hands a run of pixels over to one producer, who draws into a private buffer and publishes whole frames
+ * @note The segment keeps three count pixel buffers, so publishing never waits on show or the other way around.
+ * Each show copies in the latest frame published for every segment, once per segment rather than per pixel.
+ * Segments can't overlap, and nothing else should draw on their pixels while they're there
+ * @param strip A pointer to the initialized LED strip structure.
+ * @param uint32_t offset first pixel of the segment
+ * @param uint32_t count number of pixels in the segment
+ * @param os_led_strip_segment_t **segment set to the new segment
+ */
+int os_led_strip_add_segment(os_led_strip_t *strip, uint32_t offset, uint32_t count, os_led_strip_segment_t **segment);
+
+/**
+ * @brief Takes a segment back off the strip and frees it, whatever it published last stays up
+ * @note The producer has to be done with it first
+ * @param strip A pointer to the initialized LED strip structure.
+ * @param os_led_strip_segment_t *segment to remove
+ */
+int os_led_strip_remove_segment(os_led_strip_t *strip, os_led_strip_segment_t *segment);
+
+/**
+ * @brief Gets the buffer the producer draws its next frame into, pixel 0 is the segment's first pixel
+ * @note Belongs to the producer until it's published. The one handed back after publishing holds an older frame,
+ * so draw all of it every time
+ * @param os_led_strip_segment_t *segment that we are drawing
+ * @return count colors, NULL if segment is NULL
+ */
+rgb_t *os_led_strip_segment_buffer(os_led_strip_segment_t *segment);
+
+/**
+ * @brief Publishes the frame drawn into the segment's buffer with one atomic swap, the next show picks it up
+ * @note Frames published faster than the strip is shown replace each other, only the latest goes out
+ * @param os_led_strip_segment_t *segment that we are publishing
+ * @return the buffer to draw the next frame into, NULL if segment is NULL
+ */
+rgb_t *os_led_strip_segment_publish(os_led_strip_segment_t *segment);
+
 /**
  * @brief Update the brightness levels of of the strip
+ * @note With an output pipeline set this rebuilds its tables instead of going to the backend
  * @param os_led_strip_t A pointer to the initialized LED strip structure.
  * @param uint8_t desired brightness
 */
 int os_led_strip_set_brightness(os_led_strip_t *strip, uint8_t brightness);
 
+/**
+ * @brief Sets up gamma, brightness, color order and white extraction, done in one pass over the frame on show
+ * @note Drawing moves to a shadow buffer(a new one starts out black, see os_led_strip_get_buffer()),
+ * and the backend's own brightness is left at full.
+ * Without strip_write_raw_func the reordered bytes are handed over packed into rgb_t's r, g, b fields,
+ * so the backend has to send them out as is(ie set to LED_ORDER_RGB itself)
+ * @param strip A pointer to the initialized LED strip structure.
+ * @param const os_led_strip_pipeline_config_t *config settings to use, NULL to go back to sending frames untouched
+ * @return OS_RET_INVALID_PARAM if rgbw is asked for but the backend can't take raw frames
+ */
+int os_led_strip_set_pipeline(os_led_strip_t *strip, const os_led_strip_pipeline_config_t *config);
+
+/**
+ * @brief Switches the strip to a 16 bit frame, gamma and brightness are done at 16 bits
+ * and the result is temporally dithered down to the strip's 8 bits so dim colors don't band
+ * @note Sets up a linear, full brightness, RGB pipeline if there isn't one already.
+ * 8 bit writes keep working(scaled up to 16 bits), os_led_strip_get_buffer() returns NULL from here on.
+ * Dithering spreads the error over following frames, so it looks best when shown at a steady high refresh rate
+ * @param strip A pointer to the initialized LED strip structure.
+ */
+int os_led_strip_enable_hdr(os_led_strip_t *strip);
+
+/**
+ * @brief Gets the strip's 16 bit frame, so a frame can be rendered straight into it
+ * @note Same rules as os_led_strip_get_buffer(), hold off touching it while another task might be calling show
+ * @param strip A pointer to the HDR enabled LED strip structure.
+ * @return numpixel colors, NULL if strip is NULL or HDR isn't enabled
+ */
+rgb16_t *os_led_strip_get_buffer16(os_led_strip_t *strip);
+
+/**
+ * @brief Copies a run of 16 bit colors into the strip in one go
+ * @param strip A pointer to the HDR enabled LED strip structure.
+ * @param uint32_t offset first pixel to write
+ * @param const rgb16_t *col colors to write
+ * @param uint32_t count number of pixels to write
+ */
+int os_led_strip_write16(os_led_strip_t *strip, uint32_t offset, const rgb16_t *col, uint32_t count);
+
+/**
+ * @brief Switches the strip to storing a palette index per pixel instead of a color, 4 bits a pixel for
+ * up to 16 colors or 8 bits for up to 256. Indices are only turned into colors as the frame goes out
+ * @note Whatever was drawn so far is carried over as the closest palette colors, and the shadow buffer is freed.
+ * Color writes keep working but get the closest palette entry, which means searching the palette,
+ * so use the index calls for anything drawn often. os_led_strip_get_buffer() returns NULL from here on.
+ * Doesn't go with HDR mode
+ * @param strip A pointer to the initialized LED strip structure.
+ * @param uint8_t bits per pixel, 4 or 8
+ * @param const rgb_t *colors starting palette
+ * @param int num_colors number of colors, at most 16 for 4 bits. Entries past these start out black
+ */
+int os_led_strip_enable_palette(os_led_strip_t *strip, uint8_t bits, const rgb_t *colors, int num_colors);
+
+/**
+ * @brief Replaces a run of palette entries, every pixel using them changes color on the next show
+ * @param strip A pointer to the palette enabled LED strip structure.
+ * @param uint8_t first entry to replace
+ * @param const rgb_t *colors new colors
+ * @param int count number of entries to replace
+ */
+int os_led_strip_set_palette(os_led_strip_t *strip, uint8_t first, const rgb_t *colors, int count);
+
+/**
+ * @brief Same as os_led_strip_set_palette() but from hsv colors
+ * @param strip A pointer to the palette enabled LED strip structure.
+ * @param uint8_t first entry to replace
+ * @param const hsv_t *colors new colors
+ * @param int count number of entries to replace
+ */
+int os_led_strip_set_palette_hsv(os_led_strip_t *strip, uint8_t first, const hsv_t *colors, int count);
+
+/**
+ * @brief Rotates a run of palette entries, steps entries up(negative for down) with wraparound.
+ * Animates the whole strip for the cost of touching the palette, ie a rainbow drawn with indices 0-15
+ * and rotated by 1 every frame scrolls along the strip
+ * @param strip A pointer to the palette enabled LED strip structure.
+ * @param uint8_t first entry of the run
+ * @param int count number of entries in the run
+ * @param int steps how far to rotate, entry first + n gets the color of first + (n - steps) mod count
+ */
+int os_led_strip_rotate_palette(os_led_strip_t *strip, uint8_t first, int count, int steps);
+
+/**
+ * @brief Sets a pixel to a palette entry
+ * @param strip A pointer to the palette enabled LED strip structure.
+ * @param uint32_t pixel to set
+ * @param uint8_t index palette entry to use
+ */
+int os_led_strip_set_index(os_led_strip_t *strip, uint32_t pixel, uint8_t index);
+
+/**
+ * @brief Sets a run of pixels to one palette entry
+ * @param strip A pointer to the palette enabled LED strip structure.
+ * @param uint32_t offset first pixel to set
+ * @param uint32_t count number of pixels to set
+ * @param uint8_t index palette entry to use
+ */
+int os_led_strip_fill_index(os_led_strip_t *strip, uint32_t offset, uint32_t count, uint8_t index);
+
+/**
+ * @brief Copies a run of palette indices into the strip, one byte per pixel whatever the strip's bits
+ * @note 4 bit strips only keep the low 4 bits of each index
+ * @param strip A pointer to the palette enabled LED strip structure.
+ * @param uint32_t offset first pixel to write
+ * @param const uint8_t *indices palette entries to use
+ * @param uint32_t count number of pixels to write
+ */
+int os_led_strip_write_index(os_led_strip_t *strip, uint32_t offset, const uint8_t *indices, uint32_t count);
+
 #endif
 #endif
\ No newline at end of file
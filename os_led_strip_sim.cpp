@@ -0,0 +1,177 @@
+#include "os_led_strip.h"
+#include "global_includes.h"
+#include "string.h"
+
+#if defined(OS_LED_STRIP) && defined(LED_STRIP_SIMULATED)
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// WS2812 timing, 24 bits at 1.25us a bit, then the latch
+#define SIM_STRIP_PIXEL_NS 30000
+#define SIM_STRIP_LATCH_US 50
+
+struct _os_led_strip_t
+{
+    uint32_t numpixels;
+    uint8_t brightness;
+
+    // What set/get_buffer write into, and what's "lit up" after the last show
+    rgb_t *pixels;
+    rgb_t *output;
+
+    // Stands in for the DMA engine, one per strip so strips really do go out side by side
+    std::thread transfer_thread;
+    std::atomic<bool> running;
+    os_setbits_t start;
+    void (*done)(void *arg, int ret);
+    void *done_arg;
+};
+
+// Takes as long as the real strip would, then latches the pixels onto the output
+static void sim_strip_transfer(_os_led_strip_t *strip)
+{
+    std::this_thread::sleep_for(std::chrono::nanoseconds((int64_t)strip->numpixels * SIM_STRIP_PIXEL_NS) +
+                                std::chrono::microseconds(SIM_STRIP_LATCH_US));
+
+    uint32_t scale = strip->brightness + 1;
+    for (uint32_t n = 0; n < strip->numpixels; n++)
+    {
+        strip->output[n].r = (strip->pixels[n].r * scale) >> 8;
+        strip->output[n].g = (strip->pixels[n].g * scale) >> 8;
+        strip->output[n].b = (strip->pixels[n].b * scale) >> 8;
+    }
+}
+
+static void sim_strip_thread(_os_led_strip_t *strip)
+{
+    for (;;)
+    {
+        os_waitbits_indefinite(&strip->start, 0);
+        os_clearbits(&strip->start, 0);
+        if (!strip->running)
+        {
+            return;
+        }
+
+        sim_strip_transfer(strip);
+        strip->done(strip->done_arg, OS_RET_OK);
+    }
+}
+
+_os_led_strip_t *_sim_os_led_strip_init(int bus, int gpio, uint32_t numpixels)
+{
+    // Nothing to wire up on a simulated strip
+    (void)bus;
+    (void)gpio;
+
+    _os_led_strip_t *strip = new _os_led_strip_t;
+    strip->numpixels = numpixels;
+    strip->brightness = 255;
+    strip->pixels = (rgb_t *)calloc(numpixels, sizeof(rgb_t));
+    strip->output = (rgb_t *)calloc(numpixels, sizeof(rgb_t));
+    if (strip->pixels == NULL || strip->output == NULL)
+    {
+        free(strip->pixels);
+        free(strip->output);
+        delete strip;
+        return NULL;
+    }
+
+    strip->done = NULL;
+    strip->done_arg = NULL;
+    strip->running = true;
+    os_setbits_init(&strip->start);
+    strip->transfer_thread = std::thread(sim_strip_thread, strip);
+
+    return strip;
+}
+
+int free_sim_strip(_os_led_strip_t *strip)
+{
+    if (strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    strip->running = false;
+    os_setbits_signal(&strip->start, 0);
+    strip->transfer_thread.join();
+
+    free(strip->pixels);
+    free(strip->output);
+    delete strip;
+    return OS_RET_OK;
+}
+
+int _sim_os_led_strip_set(_os_led_strip_t *strip, uint32_t pixel, uint8_t r, uint8_t g, uint8_t b)
+{
+    if (strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (pixel >= strip->numpixels)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    strip->pixels[pixel] = {r, g, b};
+    return OS_RET_OK;
+}
+
+int _sim_os_led_strip_show(_os_led_strip_t *strip)
+{
+    if (strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    sim_strip_transfer(strip);
+    return OS_RET_OK;
+}
+
+int _sim_led_strip_set_brightness(_os_led_strip_t *strip, uint8_t brightness)
+{
+    if (strip == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    strip->brightness = brightness;
+    return OS_RET_OK;
+}
+
+rgb_t *_sim_os_led_strip_get_buffer(_os_led_strip_t *strip)
+{
+    if (strip == NULL)
+    {
+        return NULL;
+    }
+
+    return strip->pixels;
+}
+
+int _sim_os_led_strip_show_async(_os_led_strip_t *strip, void (*done)(void *arg, int ret), void *arg)
+{
+    if (strip == NULL || done == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    strip->done = done;
+    strip->done_arg = arg;
+    os_setbits_signal(&strip->start, 0);
+    return OS_RET_OK;
+}
+
+const rgb_t *_sim_os_led_strip_get_output(_os_led_strip_t *strip)
+{
+    if (strip == NULL)
+    {
+        return NULL;
+    }
+
+    return strip->output;
+}
+#endif
@@ -1,6 +1,8 @@
 #ifndef _OS_SPI_H
 #define _OS_SPI_H
 
+#include "platform_cshal.h"
+#include "stddef.h"
 #include "stdlib.h"
 #include "stdint.h"
 
@@ -11,6 +13,8 @@ typedef struct os_spi_gpio_t
     int clk = -1;
 } os_spi_gpio_t;
 
+struct os_spi_queue;
+
 typedef struct __os_spi_t
 {
 
@@ -18,6 +22,9 @@ typedef struct __os_spi_t
     // If platform supports flexible GPIO configuration
     os_spi_gpio_t gpio_man;
 
+    // Transactions waiting for the bus, set up by os_spi_initialize() on platforms with a queue
+    struct os_spi_queue *queue = NULL;
+
     // Pointer to spi handle
 } os_spi_t;
 
@@ -40,8 +47,37 @@ typedef struct os_device_init_params
     os_spi_t *bus;
 } os_device_init_params;
 
+typedef struct os_spi_trans os_spi_trans_t;
+
+/**
+ * @brief Called from the bus once a queued transaction is done
+ * @note Runs on the bus's worker, so keep it short. Don't free or requeue the transaction from in here
+ */
+typedef void (*os_spi_trans_cb_t)(os_spi_trans_t *trans, void *arg);
+
+/**
+ * @brief One queued SPI transaction, set up with os_spi_trans_init() and handed over with os_spi_queue_transfer()
+ * @note Belongs to the bus from being queued until os_spi_get_result() returns, buffers have to stay around until then too
+ */
+struct os_spi_trans
+{
+    os_device_t *device;
+    // Either can be NULL for send or recieve only
+    uint8_t *rx;
+    uint8_t *tx;
+    size_t size;
+    os_spi_trans_cb_t callback;
+    void *arg;
+
+    // Filled in by the bus
+    int result;
+    os_setbits_t done;
+    os_spi_trans_t *next;
+};
+
 /**
  * @brief Begins the SPI interface
+ * @note On spidev hosts fd is the bus number, devices are /dev/spidev<fd>.<cs_gpio>
  * @param os_spi_t *pointer to the SPI interface
  */
 int os_spi_initialize(os_spi_t *spi, int fd, os_spi_gpio_t *gpio);
@@ -94,4 +130,33 @@ int os_spi_send(os_device_t *device, uint8_t *buf, size_t size);
  * @param size_t size of buffer reciving data in
  */
 int os_spi_recieve(os_device_t *device, uint8_t *buf, size_t size);
-#endif
\ No newline at end of file
+
+/**
+ * @brief Sets up a transaction to queue, can be queued again once it's done
+ * @param os_spi_trans_t *trans that we are setting up
+ * @param os_device_t *device coupled device the transaction is for
+ * @param uint8_t *rx recieving buffer, NULL to throw away what comes in
+ * @param uint8_t *tx sending buffer, NULL to send zeroes
+ * @param size_t size of the transfer in bytes
+ * @param os_spi_trans_cb_t callback (optional)called once the transaction is done
+ * @param void *arg passed along to callback
+ */
+int os_spi_trans_init(os_spi_trans_t *trans, os_device_t *device, uint8_t *rx, uint8_t *tx, size_t size, os_spi_trans_cb_t callback,
+                      void *arg);
+
+/**
+ * @brief Queues a transaction on its device's bus and returns straight away
+ * @note Transactions from every device coupled to a bus go out back to back in the order they were queued,
+ * so the CPU can get on with the next frame while the last one goes out. Ones bigger than the device's dma_buf_size
+ * are split into dma_buf_size transfers with chip select held through them
+ * @param os_spi_trans_t *trans set up transaction, can't already be queued
+ */
+int os_spi_queue_transfer(os_spi_trans_t *trans);
+
+/**
+ * @brief Waits for a queued transaction to finish
+ * @param os_spi_trans_t *trans queued transaction
+ * @return what the transfer returned, OS_RET_OK if it went out
+ */
+int os_spi_get_result(os_spi_trans_t *trans);
+#endif
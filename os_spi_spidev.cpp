@@ -0,0 +1,403 @@
+#include "os_spi.h"
+#include "global_includes.h"
+#include "string.h"
+
+#if defined(OS_SPI_SPIDEV) && defined(__linux__)
+#include <fcntl.h>
+#include <linux/spi/spidev.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <thread>
+#include <unistd.h>
+
+// Transfers handed to the kernel in one message, it runs them without gaps
+#define SPIDEV_MAX_BATCH 16
+
+struct os_spi_queue
+{
+    os_mut_t mutex;
+    os_spi_trans_t *head;
+    os_spi_trans_t *tail;
+    uint32_t freq_hz;
+
+    // Stands in for the DMA engine, the caller only waits on it in os_spi_get_result()
+    std::thread worker;
+    bool running;
+    os_setbits_t work;
+};
+
+typedef struct spidev_device
+{
+    int fd;
+} spidev_device_t;
+
+static void spidev_complete(os_spi_trans_t *trans)
+{
+    if (trans->callback != NULL)
+    {
+        trans->callback(trans, trans->arg);
+    }
+    os_setbits_signal(&trans->done, 0);
+}
+
+// Runs whatever's queued. A device's consecutive transactions go out together as one message of up to dma_buf_size
+// bytes(keep it within spidev's bufsiz), bigger ones are split over messages with chip select held in between.
+// Devices coupled with a clk of 0 go out at freq_hz, the bus speed when the batch was taken off the queue
+static void spidev_run(os_spi_trans_t *trans, uint32_t freq_hz)
+{
+    struct spi_ioc_transfer xfers[SPIDEV_MAX_BATCH];
+    os_spi_trans_t *batch[SPIDEV_MAX_BATCH];
+    size_t offset = 0;
+
+    while (trans != NULL)
+    {
+        os_device_t *device = trans->device;
+        size_t budget = device->dma_buf_size ? device->dma_buf_size : SIZE_MAX;
+        os_spi_trans_t *first = trans;
+        int count = 0;
+        int finished = 0;
+
+        while (trans != NULL && trans->device == device && count < SPIDEV_MAX_BATCH && budget > 0)
+        {
+            if (offset == 0)
+            {
+                // Only split what wouldn't fit in a message of its own
+                if (count > 0 && trans->size > budget)
+                {
+                    break;
+                }
+                trans->result = OS_RET_OK;
+            }
+
+            size_t len = trans->size - offset < budget ? trans->size - offset : budget;
+            struct spi_ioc_transfer *xfer = &xfers[count++];
+            memset(xfer, 0, sizeof(*xfer));
+            xfer->tx_buf = trans->tx ? (uintptr_t)(trans->tx + offset) : 0;
+            xfer->rx_buf = trans->rx ? (uintptr_t)(trans->rx + offset) : 0;
+            xfer->len = len;
+            xfer->speed_hz = device->clk > 0 ? device->clk : freq_hz;
+            xfer->bits_per_word = 8;
+            // Chip select goes up between transactions
+            xfer->cs_change = 1;
+            budget -= len;
+            offset += len;
+
+            if (offset < trans->size)
+            {
+                break;
+            }
+            batch[finished++] = trans;
+            trans = trans->next;
+            offset = 0;
+        }
+        // On the last transfer cs_change means the opposite, chip select stays down for the rest of a split transaction
+        xfers[count - 1].cs_change = offset != 0;
+
+        spidev_device_t *dev = (spidev_device_t *)device->device;
+        if (ioctl(dev->fd, SPI_IOC_MESSAGE(count), xfers) < 0)
+        {
+            for (os_spi_trans_t *failed = first; failed != trans; failed = failed->next)
+            {
+                failed->result = OS_RET_INT_ERR;
+            }
+            if (offset != 0)
+            {
+                trans->result = OS_RET_INT_ERR;
+            }
+        }
+
+        for (int n = 0; n < finished; n++)
+        {
+            spidev_complete(batch[n]);
+        }
+    }
+}
+
+static void spidev_thread(os_spi_queue *queue)
+{
+    while (true)
+    {
+        os_waitbits_indefinite(&queue->work, 0);
+        os_clearbits(&queue->work, 0);
+
+        os_mut_entry_wait_indefinite(&queue->mutex);
+        os_spi_trans_t *trans = queue->head;
+        queue->head = NULL;
+        queue->tail = NULL;
+        bool running = queue->running;
+        uint32_t freq_hz = queue->freq_hz;
+        os_mut_exit(&queue->mutex);
+
+        if (!running)
+        {
+            // Whatever didn't make it out fails rather than leaving someone waiting
+            while (trans != NULL)
+            {
+                os_spi_trans_t *next = trans->next;
+                trans->result = OS_RET_INT_ERR;
+                spidev_complete(trans);
+                trans = next;
+            }
+            return;
+        }
+        spidev_run(trans, freq_hz);
+    }
+}
+
+int os_spi_initialize(os_spi_t *spi, int fd, os_spi_gpio_t *gpio)
+{
+    if (spi == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    // Pins are set by the device tree on spidev hosts
+    spi->fd = fd;
+    if (gpio != NULL)
+    {
+        spi->gpio_man = *gpio;
+    }
+
+    os_spi_queue *queue = new os_spi_queue;
+    queue->head = NULL;
+    queue->tail = NULL;
+    queue->freq_hz = 1000000;
+    queue->running = true;
+    os_setbits_init(&queue->work);
+    int ret = os_mut_init(&queue->mutex);
+    if (ret != OS_RET_OK)
+    {
+        delete queue;
+        return ret;
+    }
+
+    spi->queue = queue;
+    queue->worker = std::thread(spidev_thread, queue);
+    return OS_RET_OK;
+}
+
+int os_spi_deinit(os_spi_t *spi)
+{
+    if (spi == NULL || spi->queue == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_spi_queue *queue = spi->queue;
+    int ret = os_mut_entry_wait_indefinite(&queue->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    queue->running = false;
+    ret = os_mut_exit(&queue->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    os_setbits_signal(&queue->work, 0);
+    queue->worker.join();
+    delete queue;
+    spi->queue = NULL;
+    return OS_RET_OK;
+}
+
+int os_spi_couple_device(os_device_init_params init_params, os_device_t *device)
+{
+    if (device == NULL || init_params.bus == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (init_params.bus->queue == NULL || init_params.cs_gpio < 0)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    char path[32];
+    snprintf(path, sizeof(path), "/dev/spidev%d.%d", init_params.bus->fd, init_params.cs_gpio);
+    int fd = open(path, O_RDWR);
+    if (fd < 0)
+    {
+        return OS_RET_INT_ERR;
+    }
+
+    uint8_t bits = 8;
+    if (ioctl(fd, SPI_IOC_WR_MODE, &init_params.spi_mode) < 0 || ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0)
+    {
+        close(fd);
+        return OS_RET_INT_ERR;
+    }
+
+    spidev_device_t *dev = (spidev_device_t *)malloc(sizeof(spidev_device_t));
+    if (dev == NULL)
+    {
+        close(fd);
+        return OS_RET_LOW_MEM_ERROR;
+    }
+    dev->fd = fd;
+
+    device->spi_mode = init_params.spi_mode;
+    device->dma_buf_size = init_params.dma_buf_size;
+    device->chip_select = init_params.cs_gpio;
+    device->clk = init_params.clk;
+    device->device = dev;
+    device->bus = init_params.bus;
+    return OS_RET_OK;
+}
+
+int os_spi_decouple_device(os_device_t *device)
+{
+    if (device == NULL || device->device == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    spidev_device_t *dev = (spidev_device_t *)device->device;
+    close(dev->fd);
+    free(dev);
+    device->device = NULL;
+    return OS_RET_OK;
+}
+
+int os_spi_setbus(os_spi_t *spi, uint32_t freq_hz)
+{
+    if (spi == NULL || spi->queue == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (freq_hz == 0)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    // Devices coupled with a clk of 0 run at the bus speed, from the next batch the worker takes on
+    os_spi_queue *queue = spi->queue;
+    int ret = os_mut_entry_wait_indefinite(&queue->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    queue->freq_hz = freq_hz;
+    return os_mut_exit(&queue->mutex);
+}
+
+int os_spi_trans_init(os_spi_trans_t *trans, os_device_t *device, uint8_t *rx, uint8_t *tx, size_t size, os_spi_trans_cb_t callback,
+                      void *arg)
+{
+    if (trans == NULL || device == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    trans->device = device;
+    trans->rx = rx;
+    trans->tx = tx;
+    trans->size = size;
+    trans->callback = callback;
+    trans->arg = arg;
+    trans->result = OS_RET_OK;
+    trans->next = NULL;
+    os_setbits_init(&trans->done);
+    // Nothing to wait for until it's queued
+    os_setbits_signal(&trans->done, 0);
+    return OS_RET_OK;
+}
+
+int os_spi_queue_transfer(os_spi_trans_t *trans)
+{
+    if (trans == NULL || trans->device == NULL || trans->device->device == NULL || trans->device->bus == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    if (trans->size == 0 || trans->device->bus->queue == NULL)
+    {
+        return OS_RET_INVALID_PARAM;
+    }
+
+    os_spi_queue *queue = trans->device->bus->queue;
+    trans->next = NULL;
+    os_clearbits(&trans->done, 0);
+
+    int ret = os_mut_entry_wait_indefinite(&queue->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    int final_ret = OS_RET_OK;
+    if (!queue->running)
+    {
+        final_ret = OS_RET_INVALID_PARAM;
+    }
+    else
+    {
+        if (queue->tail != NULL)
+        {
+            queue->tail->next = trans;
+        }
+        else
+        {
+            queue->head = trans;
+        }
+        queue->tail = trans;
+    }
+
+    ret = os_mut_exit(&queue->mutex);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    if (final_ret != OS_RET_OK)
+    {
+        os_setbits_signal(&trans->done, 0);
+        return final_ret;
+    }
+    os_setbits_signal(&queue->work, 0);
+    return OS_RET_OK;
+}
+
+int os_spi_get_result(os_spi_trans_t *trans)
+{
+    if (trans == NULL)
+    {
+        return OS_RET_NULL_PTR;
+    }
+
+    os_waitbits_indefinite(&trans->done, 0);
+    return trans->result;
+}
+
+// The blocking calls go through the queue too, so they wait their turn behind anything already queued
+int os_spi_transfer(os_device_t *device, uint8_t *rx, uint8_t *tx, size_t size)
+{
+    os_spi_trans_t trans;
+    int ret = os_spi_trans_init(&trans, device, rx, tx, size, NULL, NULL);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+
+    ret = os_spi_queue_transfer(&trans);
+    if (ret != OS_RET_OK)
+    {
+        return ret;
+    }
+    return os_spi_get_result(&trans);
+}
+
+int os_spi_send(os_device_t *device, uint8_t *buf, size_t size)
+{
+    return os_spi_transfer(device, NULL, buf, size);
+}
+
+int os_spi_recieve(os_device_t *device, uint8_t *buf, size_t size)
+{
+    return os_spi_transfer(device, buf, NULL, size);
+}
+#endif
@@ -0,0 +1,22 @@
+#include "os_time.h"
+#include "stddef.h"
+
+bool os_frame_clock_wait(int64_t *next_us, uint32_t period_us)
+{
+    if (next_us == NULL || period_us == 0)
+    {
+        return false;
+    }
+
+    int64_t now = os_time_us();
+    if (now < *next_us)
+    {
+        os_thread_sleep_us((uint32_t)(*next_us - now));
+        *next_us += period_us;
+        return false;
+    }
+
+    // Running late, start counting ticks from now instead of trying to catch up
+    *next_us = now + period_us;
+    return true;
+}
@@ -0,0 +1,25 @@
+#ifndef _OS_TIME_H
+#define _OS_TIME_H
+#include "stdbool.h"
+#include "stdint.h"
+
+/**
+ * @brief Microseconds since boot, off a clock that only ever goes forward
+ */
+int64_t os_time_us(void);
+
+/**
+ * @brief Puts the calling thread to sleep
+ * @param uint32_t us how long to sleep for at least, in microseconds
+ */
+int os_thread_sleep_us(uint32_t us);
+
+/**
+ * @brief Sleeps until the next tick of a frame clock, then moves it on a period
+ * @note Running late, the clock starts counting ticks from now instead of trying to catch up
+ * @param int64_t *next_us when the next tick is due in os_time_us(), 0 starts the clock from now
+ * @param uint32_t period_us time between ticks, 0 never waits
+ * @return true if the tick had already gone by
+ */
+bool os_frame_clock_wait(int64_t *next_us, uint32_t period_us);
+#endif
@@ -0,0 +1,419 @@
+#include "global_includes.h"
+
+#ifdef OS_TEST_COLOR_CONV
+#include <chrono>
+#include <math.h>
+
+#define TEST_COLOR_CONV_PIXELS 1024
+#define TEST_COLOR_CONV_ROUNDS 2000
+#define TEST_COLOR_CONV_KELVIN_MIN 1000
+#define TEST_COLOR_CONV_KELVIN_MAX 40000
+#define TEST_COLOR_CONV_PANEL_WIDTH 320
+#define TEST_COLOR_CONV_PANEL_HEIGHT 240
+// Furthest rgb2hsv_fast() round trips may land from where they started, as promised in color_conv.h
+#define TEST_COLOR_CONV_ROUND_TRIP_WORST 8
+#define TEST_COLOR_CONV_ROUND_TRIP_WORST_HSV 5
+
+// One value of the first channel at a time, every combination of the other two
+static uint8_t input[65536 * 3];
+static uint8_t output[65536 * 3];
+static uint16_t output565[65536];
+
+static rgb_t frame[TEST_COLOR_CONV_PIXELS];
+static hsv_t frame_hsv[TEST_COLOR_CONV_PIXELS];
+static uint16_t frame565[TEST_COLOR_CONV_PIXELS];
+static rgb_t frame_to[TEST_COLOR_CONV_PIXELS];
+static rgb16_t frame16[TEST_COLOR_CONV_PIXELS];
+static rgb16_t frame16_to[TEST_COLOR_CONV_PIXELS];
+static rgb16_t frame16_out[TEST_COLOR_CONV_PIXELS];
+static rgb_t panel[TEST_COLOR_CONV_PANEL_WIDTH * TEST_COLOR_CONV_PANEL_HEIGHT];
+static uint8_t panel_out[TEST_COLOR_CONV_PANEL_WIDTH * TEST_COLOR_CONV_PANEL_HEIGHT * 3];
+static rgb_t kelvin_ref[TEST_COLOR_CONV_KELVIN_MAX - TEST_COLOR_CONV_KELVIN_MIN + 1];
+static rgb_t kelvin_fast[TEST_COLOR_CONV_KELVIN_MAX - TEST_COLOR_CONV_KELVIN_MIN + 1];
+
+static int test_color_conv_diff(rgb_t a, rgb_t b)
+{
+    int d = abs(a.r - b.r);
+    d = abs(a.g - b.g) > d ? abs(a.g - b.g) : d;
+    return abs(a.b - b.b) > d ? abs(a.b - b.b) : d;
+}
+
+// The sRGB curves in float, what the tables stand in for
+static float test_color_conv_decode(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float test_color_conv_encode(float l)
+{
+    return l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1 / 2.4f) - 0.055f;
+}
+
+static const char *format_names[] = {"rgb565 le", "rgb565 be", "bgr565 le", "bgr565 be", "rgb666", "bgr666"};
+
+// A pixel at a time, the way a display driver would
+static void test_color_conv_format_reference(rgb_t col, uint8_t *out, color_format_t format, bool dither, uint32_t x, uint32_t y)
+{
+    static const uint8_t bayer[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+    int t = dither ? bayer[y % 4][x % 4] : 0;
+    int r = format == COLOR_FORMAT_BGR565_LE || format == COLOR_FORMAT_BGR565_BE || format == COLOR_FORMAT_BGR666 ? col.b : col.r;
+    int b = r == col.r ? col.b : col.r;
+    if (format == COLOR_FORMAT_RGB666 || format == COLOR_FORMAT_BGR666)
+    {
+        out[0] = (r + t / 4 > 255 ? 255 : r + t / 4) & 0xFC;
+        out[1] = (col.g + t / 4 > 255 ? 255 : col.g + t / 4) & 0xFC;
+        out[2] = (b + t / 4 > 255 ? 255 : b + t / 4) & 0xFC;
+        return;
+    }
+    uint16_t px = rgb888_to_rgb565(r + t / 2 > 255 ? 255 : r + t / 2, col.g + t / 4 > 255 ? 255 : col.g + t / 4, b + t / 2 > 255 ? 255 : b + t / 2);
+    bool big_endian = format == COLOR_FORMAT_RGB565_BE || format == COLOR_FORMAT_BGR565_BE;
+    out[0] = big_endian ? px >> 8 : px & 0xFF;
+    out[1] = big_endian ? px & 0xFF : px >> 8;
+}
+
+void test_color_conv(void *parameters)
+{
+    // Every possible input against the single pixel functions
+    uint32_t wrong[3] = {0, 0, 0};
+    for (int first = 0; first < 256; first++)
+    {
+        for (int n = 0; n < 65536; n++)
+        {
+            input[n * 3] = (uint8_t)first;
+            input[n * 3 + 1] = (uint8_t)(n >> 8);
+            input[n * 3 + 2] = (uint8_t)n;
+        }
+        const hsv_t *hsv = (const hsv_t *)input;
+        const rgb_t *rgb = (const rgb_t *)input;
+
+        hsv2rgb_n(hsv, (rgb_t *)output, 65536);
+        for (int n = 0; n < 65536; n++)
+        {
+            rgb_t col = hsv2rgb(hsv[n]);
+            wrong[0] += memcmp(&col, &output[n * 3], 3) != 0;
+        }
+
+        rgb2hsv_n(rgb, (hsv_t *)output, 65536);
+        for (int n = 0; n < 65536; n++)
+        {
+            hsv_t col = rgb2hsv(rgb[n]);
+            wrong[1] += memcmp(&col, &output[n * 3], 3) != 0;
+        }
+
+        rgb888_to_rgb565_n(rgb, output565, 65536);
+        for (int n = 0; n < 65536; n++)
+        {
+            wrong[2] += output565[n] != rgb888_to_rgb565(rgb[n].r, rgb[n].g, rgb[n].b);
+        }
+    }
+
+    // Odd lengths in place, so the leftovers after the vector loops get checked too
+    for (int n = 0; n < TEST_COLOR_CONV_PIXELS; n++)
+    {
+        frame_hsv[n] = {(uint8_t)(n * 7), (uint8_t)(n * 13 + 5), (uint8_t)(n * 31 + 9)};
+    }
+    for (uint32_t len = 0; len < 40; len++)
+    {
+        hsv_t copy[40];
+        memcpy(copy, frame_hsv, sizeof(copy));
+        hsv2rgb_n(copy, (rgb_t *)copy, len);
+        for (uint32_t n = 0; n < 40; n++)
+        {
+            rgb_t col = n < len ? hsv2rgb(frame_hsv[n]) : *(const rgb_t *)&frame_hsv[n];
+            wrong[0] += memcmp(&col, &copy[n], 3) != 0;
+        }
+    }
+    os_printf("%s kernels: %u hsv2rgb, %u rgb2hsv, %u rgb565 results differ from the single pixel functions\n",
+              color_conv_kernel_name(), wrong[0], wrong[1], wrong[2]);
+
+    // Frame sized buffers, a pixel at a time against the array versions
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < TEST_COLOR_CONV_ROUNDS; round++)
+    {
+        frame_hsv[round % TEST_COLOR_CONV_PIXELS].h++;
+        for (int n = 0; n < TEST_COLOR_CONV_PIXELS; n++)
+        {
+            frame[n] = hsv2rgb(frame_hsv[n]);
+        }
+    }
+    double single_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < TEST_COLOR_CONV_ROUNDS; round++)
+    {
+        frame_hsv[round % TEST_COLOR_CONV_PIXELS].h++;
+        hsv2rgb_n(frame_hsv, frame, TEST_COLOR_CONV_PIXELS);
+    }
+    double batch_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    os_printf("hsv2rgb: %.1f Mpixels/s a pixel at a time, %.1f Mpixels/s array\n",
+              TEST_COLOR_CONV_PIXELS * TEST_COLOR_CONV_ROUNDS / single_s / 1e6, TEST_COLOR_CONV_PIXELS * TEST_COLOR_CONV_ROUNDS / batch_s / 1e6);
+
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < TEST_COLOR_CONV_ROUNDS; round++)
+    {
+        frame[round % TEST_COLOR_CONV_PIXELS].r++;
+        for (int n = 0; n < TEST_COLOR_CONV_PIXELS; n++)
+        {
+            frame_hsv[n] = rgb2hsv(frame[n]);
+        }
+    }
+    single_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < TEST_COLOR_CONV_ROUNDS; round++)
+    {
+        frame[round % TEST_COLOR_CONV_PIXELS].r++;
+        rgb2hsv_n(frame, frame_hsv, TEST_COLOR_CONV_PIXELS);
+    }
+    batch_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    os_printf("rgb2hsv: %.1f Mpixels/s a pixel at a time, %.1f Mpixels/s array\n",
+              TEST_COLOR_CONV_PIXELS * TEST_COLOR_CONV_ROUNDS / single_s / 1e6, TEST_COLOR_CONV_PIXELS * TEST_COLOR_CONV_ROUNDS / batch_s / 1e6);
+
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < TEST_COLOR_CONV_ROUNDS; round++)
+    {
+        frame[round % TEST_COLOR_CONV_PIXELS].g++;
+        for (int n = 0; n < TEST_COLOR_CONV_PIXELS; n++)
+        {
+            frame565[n] = rgb888_to_rgb565(frame[n].r, frame[n].g, frame[n].b);
+        }
+    }
+    single_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < TEST_COLOR_CONV_ROUNDS; round++)
+    {
+        frame[round % TEST_COLOR_CONV_PIXELS].g++;
+        rgb888_to_rgb565_n(frame, frame565, TEST_COLOR_CONV_PIXELS);
+    }
+    batch_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    os_printf("rgb565: %.1f Mpixels/s a pixel at a time, %.1f Mpixels/s array\n",
+              TEST_COLOR_CONV_PIXELS * TEST_COLOR_CONV_ROUNDS / single_s / 1e6, TEST_COLOR_CONV_PIXELS * TEST_COLOR_CONV_ROUNDS / batch_s / 1e6);
+
+    // Every kelvin in the table's range through the float curves and the table
+    const int kelvins = TEST_COLOR_CONV_KELVIN_MAX - TEST_COLOR_CONV_KELVIN_MIN + 1;
+    start = std::chrono::steady_clock::now();
+    for (int n = 0; n < kelvins; n++)
+    {
+        kelvin_ref[n] = kelvin2rgb(TEST_COLOR_CONV_KELVIN_MIN + n);
+    }
+    single_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (int n = 0; n < kelvins; n++)
+    {
+        kelvin_fast[n] = kelvin2rgb_fast(TEST_COLOR_CONV_KELVIN_MIN + n);
+    }
+    batch_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int worst = 0;
+    int off = 0;
+    for (int n = 0; n < kelvins; n++)
+    {
+        int d = test_color_conv_diff(kelvin_ref[n], kelvin_fast[n]);
+        worst = d > worst ? d : worst;
+        off += d > 1;
+    }
+    os_printf("kelvin2rgb: %.1f Mcolors/s float, %.1f Mcolors/s table, worst difference %d, %d of %d more than 1 off\n",
+              kelvins / single_s / 1e6, kelvins / batch_s / 1e6, worst, off, kelvins);
+
+    // Whole RGB cube through the integer rgb2hsv and back, then colors hsv2rgb can make going the other way round
+    worst = 0;
+    uint64_t total = 0;
+    for (uint32_t n = 0; n < (1 << 24); n++)
+    {
+        rgb_t col = {(uint8_t)(n >> 16), (uint8_t)(n >> 8), (uint8_t)n};
+        int d = test_color_conv_diff(col, hsv2rgb(rgb2hsv_fast(col)));
+        worst = d > worst ? d : worst;
+        total += d;
+    }
+    int worst_hsv = 0;
+    for (uint32_t n = 0; n < (1 << 24); n++)
+    {
+        rgb_t col = hsv2rgb({(uint8_t)(n >> 16), (uint8_t)(n >> 8), (uint8_t)n});
+        int d = test_color_conv_diff(col, hsv2rgb(rgb2hsv_fast(col)));
+        worst_hsv = d > worst_hsv ? d : worst_hsv;
+    }
+    bool in_bounds = worst <= TEST_COLOR_CONV_ROUND_TRIP_WORST && worst_hsv <= TEST_COLOR_CONV_ROUND_TRIP_WORST_HSV;
+    os_printf("rgb2hsv_fast round trip: worst %d, average %.2f over the rgb cube, worst %d from hsv2rgb colors%s\n", worst,
+              (double)total / (1 << 24), worst_hsv, in_bounds ? "" : " FAIL");
+
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < TEST_COLOR_CONV_ROUNDS; round++)
+    {
+        frame[round % TEST_COLOR_CONV_PIXELS].b++;
+        for (int n = 0; n < TEST_COLOR_CONV_PIXELS; n++)
+        {
+            frame_hsv[n] = rgb2hsv_fast(frame[n]);
+        }
+    }
+    batch_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    os_printf("rgb2hsv_fast: %.1f Mpixels/s\n", TEST_COLOR_CONV_PIXELS * TEST_COLOR_CONV_ROUNDS / batch_s / 1e6);
+
+    // Linear light tables against the curves, every 8 bit code has to survive the round trip
+    int worst_linear = 0;
+    int round_trip = 0;
+    for (int n = 0; n < 256; n++)
+    {
+        rgb16_t linear = srgb_to_linear({(uint8_t)n, (uint8_t)n, (uint8_t)n});
+        int d = abs(linear.r - (int)lroundf(test_color_conv_decode(n / 255.0f) * 65535));
+        worst_linear = d > worst_linear ? d : worst_linear;
+        round_trip += linear_to_srgb(linear).r != n;
+    }
+    int worst_srgb = 0;
+    for (int n = 0; n < 65536; n++)
+    {
+        rgb_t col = linear_to_srgb({(uint16_t)n, (uint16_t)n, (uint16_t)n});
+        int d = abs(col.r - (int)lroundf(test_color_conv_encode(n / 65535.0f) * 255));
+        worst_srgb = d > worst_srgb ? d : worst_srgb;
+    }
+    os_printf("linear tables: worst %d of 65535 to linear, worst %d of 255 back, %d codes don't round trip\n", worst_linear,
+              worst_srgb, round_trip);
+
+    // Vector blend against the same math one channel at a time, odd length and in place
+    for (int n = 0; n < TEST_COLOR_CONV_PIXELS; n++)
+    {
+        frame16[n] = {(uint16_t)(n * 977), (uint16_t)(n * 3331 + 5), (uint16_t)(65535 - n * 61)};
+        frame16_to[n] = {(uint16_t)(n * 6007 + 17), (uint16_t)(n * 13), (uint16_t)(n * 40009)};
+    }
+    int wrong_lerp = 0;
+    for (uint32_t frac = 0; frac < 65536; frac += 4099)
+    {
+        memcpy(frame16_out, frame16, sizeof(frame16));
+        rgb16_lerp_n(frame16_out, frame16_to, frame16_out, TEST_COLOR_CONV_PIXELS - 3, (uint16_t)frac);
+        for (int n = 0; n < TEST_COLOR_CONV_PIXELS * 3; n++)
+        {
+            uint32_t a = ((const uint16_t *)frame16)[n];
+            uint32_t b = ((const uint16_t *)frame16_to)[n];
+            uint16_t expect = n < (TEST_COLOR_CONV_PIXELS - 3) * 3 ? (uint16_t)(a - ((a * frac) >> 16) + ((b * frac) >> 16)) : (uint16_t)a;
+            wrong_lerp += ((const uint16_t *)frame16_out)[n] != expect;
+        }
+    }
+
+    rgb_t red = {255, 0, 0};
+    rgb_t green = {0, 255, 0};
+    rgb_t mid_linear;
+    rgb_lerp_linear_n(&red, &green, &mid_linear, 1, 32768);
+    rgb_t mid_oklab = rgb_lerp_oklab(red, green, 32768);
+    os_printf("blends: %d wrong, red to green halfway %d,%d,%d in linear light, %d,%d,%d in oklab\n", wrong_lerp, mid_linear.r,
+              mid_linear.g, mid_linear.b, mid_oklab.r, mid_oklab.g, mid_oklab.b);
+
+    // Every color through oklab and back
+    worst = 0;
+    for (uint32_t n = 0; n < (1 << 24); n++)
+    {
+        rgb_t col = {(uint8_t)(n >> 16), (uint8_t)(n >> 8), (uint8_t)n};
+        int d = test_color_conv_diff(col, oklab2rgb(rgb2oklab(col)));
+        worst = d > worst ? d : worst;
+    }
+    os_printf("oklab round trip: worst %d over the rgb cube\n", worst);
+
+    // A crossfade of a whole frame, through the curves a pixel at a time against the tables and vector blend
+    for (int n = 0; n < TEST_COLOR_CONV_PIXELS; n++)
+    {
+        frame_to[n] = {(uint8_t)(255 - n), (uint8_t)(n * 3), (uint8_t)(n * 11)};
+    }
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < TEST_COLOR_CONV_ROUNDS / 10; round++)
+    {
+        float t = round / (float)(TEST_COLOR_CONV_ROUNDS / 10);
+        for (int n = 0; n < TEST_COLOR_CONV_PIXELS; n++)
+        {
+            const uint8_t *a = &frame[n].r;
+            const uint8_t *b = &frame_to[n].r;
+            uint8_t *out = &frame_hsv[n].h;
+            for (int c = 0; c < 3; c++)
+            {
+                float la = test_color_conv_decode(a[c] / 255.0f);
+                float lb = test_color_conv_decode(b[c] / 255.0f);
+                out[c] = (uint8_t)(test_color_conv_encode(la + (lb - la) * t) * 255 + 0.5f);
+            }
+        }
+    }
+    single_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < TEST_COLOR_CONV_ROUNDS / 10; round++)
+    {
+        rgb_lerp_linear_n(frame, frame_to, (rgb_t *)frame_hsv, TEST_COLOR_CONV_PIXELS, (uint16_t)(round * 65536 / (TEST_COLOR_CONV_ROUNDS / 10)));
+    }
+    batch_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    os_printf("linear crossfade: %.1f Mpixels/s with powf, %.1f Mpixels/s with tables\n",
+              TEST_COLOR_CONV_PIXELS * (TEST_COLOR_CONV_ROUNDS / 10) / single_s / 1e6,
+              TEST_COLOR_CONV_PIXELS * (TEST_COLOR_CONV_ROUNDS / 10) / batch_s / 1e6);
+
+    // Display formats, short rows at odd places to get the leftovers and dither alignment, then whole frames
+    for (int n = 0; n < TEST_COLOR_CONV_PANEL_WIDTH * TEST_COLOR_CONV_PANEL_HEIGHT; n++)
+    {
+        panel[n] = {(uint8_t)(n * 7 + n / 320), (uint8_t)(n / 320), (uint8_t)(n * 13 + 250)};
+    }
+    for (int format = COLOR_FORMAT_RGB565_LE; format <= COLOR_FORMAT_BGR666; format++)
+    {
+        uint32_t bytes = color_format_bytes((color_format_t)format);
+        int wrong_format = 0;
+        for (int dither = 0; dither < 2; dither++)
+        {
+            for (uint32_t len = 0; len < 40; len++)
+            {
+                rgb_convert_row(&panel[len * 5], panel_out, len, (color_format_t)format, dither, len * 3, len);
+                for (uint32_t n = 0; n < len; n++)
+                {
+                    uint8_t expect[3];
+                    test_color_conv_format_reference(panel[len * 5 + n], expect, (color_format_t)format, dither, len * 3 + n, len);
+                    wrong_format += memcmp(expect, &panel_out[n * bytes], bytes) != 0;
+                }
+            }
+            rgb_convert_frame(panel, panel_out, TEST_COLOR_CONV_PANEL_WIDTH, TEST_COLOR_CONV_PANEL_HEIGHT, (color_format_t)format, dither);
+            for (int n = 0; n < TEST_COLOR_CONV_PANEL_WIDTH * TEST_COLOR_CONV_PANEL_HEIGHT; n++)
+            {
+                uint8_t expect[3];
+                test_color_conv_format_reference(panel[n], expect, (color_format_t)format, dither, n % TEST_COLOR_CONV_PANEL_WIDTH,
+                                                 n / TEST_COLOR_CONV_PANEL_WIDTH);
+                wrong_format += memcmp(expect, &panel_out[n * bytes], bytes) != 0;
+            }
+        }
+
+        start = std::chrono::steady_clock::now();
+        for (int round = 0; round < 20; round++)
+        {
+            for (int n = 0; n < TEST_COLOR_CONV_PANEL_WIDTH * TEST_COLOR_CONV_PANEL_HEIGHT; n++)
+            {
+                test_color_conv_format_reference(panel[n], &panel_out[n * bytes], (color_format_t)format, true,
+                                                 n % TEST_COLOR_CONV_PANEL_WIDTH, n / TEST_COLOR_CONV_PANEL_WIDTH);
+            }
+        }
+        single_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        for (int round = 0; round < 20; round++)
+        {
+            rgb_convert_frame(panel, panel_out, TEST_COLOR_CONV_PANEL_WIDTH, TEST_COLOR_CONV_PANEL_HEIGHT, (color_format_t)format, true);
+        }
+        batch_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        os_printf("%s: %d wrong, dithered %.1f Mpixels/s a pixel at a time, %.1f Mpixels/s by row\n", format_names[format], wrong_format,
+                  TEST_COLOR_CONV_PANEL_WIDTH * TEST_COLOR_CONV_PANEL_HEIGHT * 20 / single_s / 1e6,
+                  TEST_COLOR_CONV_PANEL_WIDTH * TEST_COLOR_CONV_PANEL_HEIGHT * 20 / batch_s / 1e6);
+    }
+
+    // Flat levels of red, how far a 4x4 tile of 565 averages out from the 8 bit level, up to the last 5 bit step
+    double worst_plain = 0;
+    double worst_dither = 0;
+    for (int level = 0; level < 248; level++)
+    {
+        rgb_t row[4] = {{(uint8_t)level, 0, 0}, {(uint8_t)level, 0, 0}, {(uint8_t)level, 0, 0}, {(uint8_t)level, 0, 0}};
+        uint8_t out[8];
+        double plain = 0;
+        double dithered = 0;
+        for (uint32_t y = 0; y < 4; y++)
+        {
+            for (int dither = 0; dither < 2; dither++)
+            {
+                rgb_convert_row(row, out, 4, COLOR_FORMAT_RGB565_LE, dither, 0, y);
+                for (int x = 0; x < 4; x++)
+                {
+                    int r5 = out[x * 2 + 1] >> 3;
+                    (dither ? dithered : plain) += r5 * 8 / 16.0;
+                }
+            }
+        }
+        worst_plain = fabs(plain - level) > worst_plain ? fabs(plain - level) : worst_plain;
+        worst_dither = fabs(dithered - level) > worst_dither ? fabs(dithered - level) : worst_dither;
+    }
+    os_printf("565 red over a 4x4 tile: worst %.1f off truncated, %.1f off dithered\n", worst_plain, worst_dither);
+}
+
+#endif
@@ -0,0 +1,160 @@
+#include "global_includes.h"
+
+#ifdef OS_TEST_LED_ANIM
+#include <chrono>
+#include <math.h>
+#include <thread>
+
+#define TEST_ANIM_STRIPS 8
+#define TEST_ANIM_PIXELS 300
+#define TEST_ANIM_MATRIX_WIDTH 64
+#define TEST_ANIM_MATRIX_HEIGHT 32
+#define TEST_ANIM_FRAMES 100
+
+static os_led_strip_t strips[TEST_ANIM_STRIPS];
+static os_led_anim_t anims[TEST_ANIM_STRIPS * 2 + 1];
+static os_led_anim_scheduler_t sched;
+static os_ledmatrix_t matrix;
+static rgb_t panel[TEST_ANIM_MATRIX_WIDTH * TEST_ANIM_MATRIX_HEIGHT];
+
+static const os_led_keyframe_t rainbow[] = {
+    {0, {255, 0, 0}}, {500, {255, 255, 0}}, {1000, {0, 255, 0}}, {1500, {0, 255, 255}}, {2000, {0, 0, 255}}, {2500, {255, 0, 255}},
+};
+
+static const os_led_keyframe_t pulse[] = {
+    {0, {0, 0, 0}},
+    {400, {255, 128, 32}},
+};
+
+static int test_anim_matrix_init(void *ptr, int width, int height)
+{
+    return OS_RET_OK;
+}
+
+static int test_anim_matrix_setpixel(void *ptr, int x, int y, uint8_t r, uint8_t g, uint8_t b)
+{
+    panel[y * TEST_ANIM_MATRIX_WIDTH + x] = {r, g, b};
+    return OS_RET_OK;
+}
+
+static int test_anim_matrix_update(void *ptr)
+{
+    return OS_RET_OK;
+}
+
+// Float version of what a looping animation should look like at palette position pos
+static rgb_t test_anim_reference(const os_led_keyframe_t *keyframes, int num_keyframes, uint32_t duration_ms, float pos)
+{
+    int n = 0;
+    while (n + 1 < num_keyframes && keyframes[n + 1].time_ms <= pos)
+    {
+        n++;
+    }
+    float end = n + 1 < num_keyframes ? keyframes[n + 1].time_ms : duration_ms;
+    rgb_t a = keyframes[n].color;
+    rgb_t b = keyframes[(n + 1) % num_keyframes].color;
+    float frac = (pos - keyframes[n].time_ms) / (end - keyframes[n].time_ms);
+    return {(uint8_t)(a.r + (b.r - a.r) * frac), (uint8_t)(a.g + (b.g - a.g) * frac), (uint8_t)(a.b + (b.b - a.b) * frac)};
+}
+
+static int test_anim_diff(rgb_t a, rgb_t b)
+{
+    int d = abs(a.r - b.r);
+    d = abs(a.g - b.g) > d ? abs(a.g - b.g) : d;
+    return abs(a.b - b.b) > d ? abs(a.b - b.b) : d;
+}
+
+void test_led_anim(void *parameters)
+{
+    os_ledmatrix_init_t init;
+    memset(&init, 0, sizeof(init));
+    init.init_func = test_anim_matrix_init;
+    init.setpixel_func = test_anim_matrix_setpixel;
+    init.update_func = test_anim_matrix_update;
+    init.width = TEST_ANIM_MATRIX_WIDTH;
+    init.height = TEST_ANIM_MATRIX_HEIGHT;
+    init.matrix_ptr = panel;
+    os_init_ledmatrix(init, &matrix);
+
+    // Half of each strip scrolls through the rainbow, the other half pulses
+    for (int n = 0; n < TEST_ANIM_STRIPS; n++)
+    {
+        os_led_strip_init(&strips[n], STRIP_SIMULATED_RGB, 0, n, TEST_ANIM_PIXELS);
+        os_led_strip_enable_async(&strips[n], NULL, NULL);
+        os_led_anim_init_strip(&anims[n * 2], rainbow, 6, 3000, LED_ANIM_GRADIENT, &strips[n], 0, TEST_ANIM_PIXELS / 2);
+        os_led_anim_init_strip(&anims[n * 2 + 1], pulse, 2, 800 + n * 100, LED_ANIM_FILL, &strips[n], TEST_ANIM_PIXELS / 2,
+                               TEST_ANIM_PIXELS / 2);
+    }
+    os_led_anim_init_matrix(&anims[TEST_ANIM_STRIPS * 2], rainbow, 6, 3000, LED_ANIM_GRADIENT, &matrix,
+                            {0, 0, TEST_ANIM_MATRIX_WIDTH, TEST_ANIM_MATRIX_HEIGHT});
+
+    os_led_anim_scheduler_init(&sched, 60);
+    for (int n = 0; n < TEST_ANIM_STRIPS * 2 + 1; n++)
+    {
+        os_led_anim_add(&sched, &anims[n]);
+    }
+
+    // Checked against floats at a few points in time
+    int worst = 0;
+    for (uint32_t t = 0; t < 6000; t += 777)
+    {
+        os_led_anim_scheduler_step(&sched, t);
+        os_led_strip_wait_show(&strips[0]);
+
+        const rgb_t *output = _sim_os_led_strip_get_output(strips[0].strip);
+        for (int p = 0; p < TEST_ANIM_PIXELS / 2; p++)
+        {
+            float pos = fmodf(p * 3000.0f / (TEST_ANIM_PIXELS / 2) + 3000.0f - (t % 3000), 3000.0f);
+            int d = test_anim_diff(output[p], test_anim_reference(rainbow, 6, 3000, pos));
+            worst = d > worst ? d : worst;
+        }
+        int d = test_anim_diff(output[TEST_ANIM_PIXELS / 2], test_anim_reference(pulse, 2, 800, t % 800));
+        worst = d > worst ? d : worst;
+
+        for (int x = 0; x < TEST_ANIM_MATRIX_WIDTH; x++)
+        {
+            float pos = fmodf(x * 3000.0f / TEST_ANIM_MATRIX_WIDTH + 3000.0f - (t % 3000), 3000.0f);
+            d = test_anim_diff(panel[(TEST_ANIM_MATRIX_HEIGHT - 1) * TEST_ANIM_MATRIX_WIDTH + x], test_anim_reference(rainbow, 6, 3000, pos));
+            worst = d > worst ? d : worst;
+        }
+    }
+    os_printf("worst difference from float reference: %d\n", worst);
+
+    os_led_anim_stats_t stats;
+    for (int frame = 0; frame < TEST_ANIM_FRAMES; frame++)
+    {
+        os_led_anim_scheduler_step(&sched, frame * 16);
+    }
+    os_led_anim_get_stats(&sched, &stats);
+    os_printf("%d animations: %u us render, %u us max\n", TEST_ANIM_STRIPS * 2 + 1, stats.last_render_us, stats.max_render_us);
+
+    // The same strip effects written the usual way, a pixel at a time through hsv
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < TEST_ANIM_FRAMES; frame++)
+    {
+        for (int n = 0; n < TEST_ANIM_STRIPS; n++)
+        {
+            for (int p = 0; p < TEST_ANIM_PIXELS / 2; p++)
+            {
+                os_led_strip_set_hsv(&strips[n], p, {(uint8_t)(p + frame), 255, 255});
+            }
+            for (int p = TEST_ANIM_PIXELS / 2; p < TEST_ANIM_PIXELS; p++)
+            {
+                os_led_strip_set_hsv(&strips[n], p, {20, 220, (uint8_t)(frame * 8)});
+            }
+        }
+    }
+    auto time = std::chrono::steady_clock::now() - start;
+    os_printf("per pixel hsv loop: %lld us render\n",
+              (long long)std::chrono::duration_cast<std::chrono::microseconds>(time).count() / TEST_ANIM_FRAMES);
+
+    // And off the frame clock for a bit
+    std::thread thread(os_led_anim_scheduler_thread, &sched);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    os_led_anim_scheduler_stop(&sched);
+    thread.join();
+    os_led_anim_get_stats(&sched, &stats);
+    os_printf("scheduler thread: %u frames, %u late, last frame %u us\n", stats.frames, stats.late_frames, stats.last_frame_us);
+}
+
+#endif
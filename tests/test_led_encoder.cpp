@@ -0,0 +1,98 @@
+#include "global_includes.h"
+
+#ifdef OS_TEST_LED_ENCODER
+#include <chrono>
+
+#define TEST_ENCODER_PIXELS 1024
+#define TEST_ENCODER_ROUNDS 200
+
+static rgb_t frame[TEST_ENCODER_PIXELS];
+static uint8_t wire[TEST_ENCODER_PIXELS * 3];
+static uint8_t encoded[TEST_ENCODER_PIXELS * 3 * 8 * sizeof(uint32_t)];
+static uint8_t reference[TEST_ENCODER_PIXELS * 3 * 8 * sizeof(uint32_t)];
+
+static const char *encoding_names[] = {"spi 3 bit", "spi 4 bit", "i2s 4 bit", "rmt"};
+
+// A bit at a time, the way backends used to do it
+static void test_led_encoder_reference(os_led_encoding_t encoding, const uint8_t *data, uint32_t len, uint8_t *out)
+{
+    const uint32_t zero = 16 | (1 << 15) | (34 << 16);
+    const uint32_t one = 32 | (1 << 15) | (18 << 16);
+    int width = encoding == LED_ENCODING_SPI_3BIT ? 3 : 4;
+    uint32_t bit_pos = 0;
+
+    memset(out, 0, len * 8 * sizeof(uint32_t));
+    for (uint32_t n = 0; n < len; n++)
+    {
+        for (int bit = 7; bit >= 0; bit--)
+        {
+            int set = (data[n] >> bit) & 1;
+            if (encoding == LED_ENCODING_RMT)
+            {
+                uint32_t item = set ? one : zero;
+                memcpy(&out[(n * 8 + 7 - bit) * sizeof(uint32_t)], &item, sizeof(item));
+                continue;
+            }
+
+            for (int w = 0; w < width; w++)
+            {
+                // First wire bit is always high and the last always low, the data bit fills the ones in between
+                if (w == 0 || (set && w < width - 1))
+                {
+                    uint32_t byte = bit_pos / 8;
+                    if (encoding == LED_ENCODING_I2S_4BIT)
+                    {
+                        byte ^= 1;
+                    }
+                    out[byte] |= 0x80 >> (bit_pos % 8);
+                }
+                bit_pos++;
+            }
+        }
+    }
+}
+
+void test_led_encoder(void *parameters)
+{
+    for (int n = 0; n < TEST_ENCODER_PIXELS; n++)
+    {
+        frame[n] = {(uint8_t)(n * 7), (uint8_t)(n * 13 + 5), (uint8_t)(n * 31 + 9)};
+        wire[n * 3] = frame[n].g;
+        wire[n * 3 + 1] = frame[n].r;
+        wire[n * 3 + 2] = frame[n].b;
+    }
+
+    const os_led_timing_t timing = LED_TIMING_WS2812;
+    for (int encoding = LED_ENCODING_SPI_3BIT; encoding <= LED_ENCODING_RMT; encoding++)
+    {
+        os_led_encoder_t encoder;
+        os_led_encoder_init(&encoder, (os_led_encoding_t)encoding, &timing, 25);
+        size_t size = os_led_encoder_size(&encoder, sizeof(wire));
+
+        // Odd length so the leftovers after the vector loop get checked too
+        os_led_encode_rgb(&encoder, frame, TEST_ENCODER_PIXELS - 1, LED_ORDER_GRB, encoded);
+        test_led_encoder_reference((os_led_encoding_t)encoding, wire, sizeof(wire) - 3, reference);
+        int wrong = memcmp(encoded, reference, os_led_encoder_size(&encoder, sizeof(wire) - 3)) != 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < TEST_ENCODER_ROUNDS; round++)
+        {
+            test_led_encoder_reference((os_led_encoding_t)encoding, wire, sizeof(wire), reference);
+        }
+        double bitwise_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (int round = 0; round < TEST_ENCODER_ROUNDS; round++)
+        {
+            os_led_encode_rgb(&encoder, frame, TEST_ENCODER_PIXELS, LED_ORDER_GRB, encoded);
+        }
+        double table_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        wrong += memcmp(encoded, reference, size) != 0;
+
+        os_printf("%s: %.1f Mpixels/s bit at a time, %.1f Mpixels/s encoder, %s\n", encoding_names[encoding],
+                  TEST_ENCODER_PIXELS * TEST_ENCODER_ROUNDS / bitwise_s / 1e6,
+                  TEST_ENCODER_PIXELS * TEST_ENCODER_ROUNDS / table_s / 1e6, wrong ? "MISMATCH" : "matches");
+    }
+}
+
+#endif
@@ -0,0 +1,272 @@
+#include "global_includes.h"
+
+#ifdef OS_TEST_LED_STRIP
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "math.h"
+
+#define TEST_STRIP_COUNT 8
+#define TEST_STRIP_PIXELS 300
+#define TEST_STRIP_FRAMES 20
+#define TEST_STRIP_PRODUCERS 4
+#define TEST_STRIP_PRODUCER_FRAMES 500
+
+static os_led_strip_t strips[TEST_STRIP_COUNT];
+static os_led_strip_group_t group;
+
+static os_led_strip_segment_t *segments[TEST_STRIP_PRODUCERS];
+static std::atomic<int> producers_running;
+static int64_t producer_us[TEST_STRIP_PRODUCERS];
+
+static rgb_t test_led_strip_producer_col(int producer, int frame, int p)
+{
+    return {(uint8_t)(producer * 60), (uint8_t)frame, (uint8_t)p};
+}
+
+// Draws its own quarter of the strip as fast as it can, pixel by pixel through the strip or into its segment
+static void test_led_strip_producer(int producer, bool use_segment)
+{
+    const int count = TEST_STRIP_PIXELS / TEST_STRIP_PRODUCERS;
+    auto start = std::chrono::steady_clock::now();
+    rgb_t *buffer = os_led_strip_segment_buffer(segments[producer]);
+    for (int frame = 0; frame < TEST_STRIP_PRODUCER_FRAMES; frame++)
+    {
+        for (int p = 0; p < count; p++)
+        {
+            if (use_segment)
+            {
+                buffer[p] = test_led_strip_producer_col(producer, frame, p);
+            }
+            else
+            {
+                os_led_strip_set_rgb(&strips[4], producer * count + p, test_led_strip_producer_col(producer, frame, p));
+            }
+        }
+        if (use_segment)
+        {
+            buffer = os_led_strip_segment_publish(segments[producer]);
+        }
+    }
+    producer_us[producer] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    producers_running--;
+}
+
+// Runs the producers while showing the strip over and over, returns how long the slowest one took to draw its frames
+static int64_t test_led_strip_run_producers(bool use_segment)
+{
+    os_led_strip_t *strip = use_segment ? &strips[3] : &strips[4];
+    producers_running = TEST_STRIP_PRODUCERS;
+    std::thread threads[TEST_STRIP_PRODUCERS];
+    for (int n = 0; n < TEST_STRIP_PRODUCERS; n++)
+    {
+        threads[n] = std::thread(test_led_strip_producer, n, use_segment);
+    }
+    while (producers_running > 0)
+    {
+        os_led_strip_show(strip);
+    }
+    for (int n = 0; n < TEST_STRIP_PRODUCERS; n++)
+    {
+        threads[n].join();
+    }
+    os_led_strip_show(strip);
+
+    int64_t slowest = 0;
+    for (int n = 0; n < TEST_STRIP_PRODUCERS; n++)
+    {
+        slowest = producer_us[n] > slowest ? producer_us[n] : slowest;
+    }
+    return slowest;
+}
+
+static void test_led_strip_render(int frame)
+{
+    for (int n = 0; n < TEST_STRIP_COUNT; n++)
+    {
+        hsv_t col = {(uint8_t)(frame * 8 + n * 32), 255, 128};
+        os_led_strip_fill_hsv_range(&strips[n], 0, TEST_STRIP_PIXELS - 1, col);
+    }
+}
+
+void test_led_strip(void *parameters)
+{
+    for (int n = 0; n < TEST_STRIP_COUNT; n++)
+    {
+        int ret = os_led_strip_init(&strips[n], STRIP_SIMULATED_RGB, 0, n, TEST_STRIP_PIXELS);
+        if (ret != OS_RET_OK)
+        {
+            os_printf("Failed to initialize led strip %d: %d\n", n, ret);
+            return;
+        }
+    }
+
+    // One strip after the other, how it's done without a group
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < TEST_STRIP_FRAMES; frame++)
+    {
+        test_led_strip_render(frame);
+        for (int n = 0; n < TEST_STRIP_COUNT; n++)
+        {
+            os_led_strip_show(&strips[n]);
+        }
+    }
+    auto time = std::chrono::steady_clock::now() - start;
+    os_printf("sequential show: %lld us/frame\n",
+              (long long)std::chrono::duration_cast<std::chrono::microseconds>(time).count() / TEST_STRIP_FRAMES);
+
+    os_led_strip_group_init(&group, 0);
+    for (int n = 0; n < TEST_STRIP_COUNT; n++)
+    {
+        os_led_strip_group_add(&group, &strips[n]);
+    }
+
+    // Next frame gets rendered while the last one is going out
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < TEST_STRIP_FRAMES; frame++)
+    {
+        test_led_strip_render(frame);
+        os_led_strip_group_show(&group);
+    }
+    os_led_strip_group_wait(&group);
+    time = std::chrono::steady_clock::now() - start;
+    os_printf("group show: %lld us/frame\n",
+              (long long)std::chrono::duration_cast<std::chrono::microseconds>(time).count() / TEST_STRIP_FRAMES);
+
+    os_led_strip_group_stats_t stats;
+    os_led_strip_group_get_stats(&group, &stats);
+    os_printf("group frames %u, last frame %u us, max frame %u us, start skew %u us\n",
+              stats.frames_shown, stats.last_frame_us, stats.max_frame_us, stats.last_start_skew_us);
+
+    // Last frame should be what's lit up on every strip
+    int wrong = 0;
+    for (int n = 0; n < TEST_STRIP_COUNT; n++)
+    {
+        rgb_t expected = hsv2rgb({(uint8_t)((TEST_STRIP_FRAMES - 1) * 8 + n * 32), 255, 128});
+        const rgb_t *output = _sim_os_led_strip_get_output(strips[n].strip);
+        for (int p = 0; p < TEST_STRIP_PIXELS; p++)
+        {
+            if (memcmp(&output[p], &expected, sizeof(rgb_t)) != 0)
+            {
+                wrong++;
+            }
+        }
+    }
+    os_printf("pixels wrong after group show: %d\n", wrong);
+
+    // Dimming a strip while its frame is still going out only takes effect from the next frame on
+    test_led_strip_render(0);
+    os_led_strip_group_show(&group);
+    os_led_strip_set_brightness(&strips[5], 127);
+    rgb_t full = hsv2rgb({5 * 32, 255, 128});
+    const rgb_t *dimmed = _sim_os_led_strip_get_output(strips[5].strip);
+    wrong = memcmp(&dimmed[0], &full, sizeof(rgb_t)) != 0;
+    os_led_strip_show(&strips[5]);
+    wrong += dimmed[0].r != full.r / 2 || dimmed[0].g != full.g / 2 || dimmed[0].b != full.b / 2;
+    os_led_strip_set_brightness(&strips[5], 255);
+    os_led_strip_group_wait(&group);
+    os_printf("brightness change during a frame: %s\n", wrong ? "FAIL" : "waits for the frame");
+
+    // GRB with gamma, what the simulated strip gets should be the pipeline's bytes as is
+    os_led_strip_pipeline_config_t config = {{2.2f, 2.2f, 2.2f, 0}, 128, LED_ORDER_GRB, false};
+    os_led_strip_set_pipeline(&strips[0], &config);
+    test_led_strip_render(0);
+    os_led_strip_show(&strips[0]);
+
+    wrong = 0;
+    rgb_t col = hsv2rgb({0, 255, 128});
+    uint8_t expected[3] = {col.g, col.r, col.b};
+    const uint8_t *output = (const uint8_t *)_sim_os_led_strip_get_output(strips[0].strip);
+    for (int p = 0; p < TEST_STRIP_PIXELS * 3; p++)
+    {
+        if (output[p] != (uint8_t)lrintf(powf(expected[p % 3] / 255.0f, 2.2f) * 128))
+        {
+            wrong++;
+        }
+    }
+    os_printf("bytes wrong through the output pipeline: %d\n", wrong);
+
+    // Dim enough that 8 bits would band, dithering should average out to the 16 bit value over the frames
+    os_led_strip_enable_hdr(&strips[1]);
+    os_led_strip_set_brightness(&strips[1], 4);
+    rgb16_t *buffer16 = os_led_strip_get_buffer16(&strips[1]);
+    for (int p = 0; p < TEST_STRIP_PIXELS; p++)
+    {
+        buffer16[p] = {(uint16_t)(p * 200), 0, 0};
+    }
+
+    static uint32_t sum[TEST_STRIP_PIXELS];
+    memset(sum, 0, sizeof(sum));
+    const rgb_t *dithered = _sim_os_led_strip_get_output(strips[1].strip);
+    for (int frame = 0; frame < 64; frame++)
+    {
+        os_led_strip_show(&strips[1]);
+        for (int p = 0; p < TEST_STRIP_PIXELS; p++)
+        {
+            sum[p] += dithered[p].r;
+        }
+    }
+
+    float max_err = 0;
+    for (int p = 0; p < TEST_STRIP_PIXELS; p++)
+    {
+        float err = fabsf(sum[p] / 64.0f - p * 200 * 4 / 65535.0f);
+        max_err = err > max_err ? err : max_err;
+    }
+    os_printf("hdr dithering worst average error: %.3f of an 8 bit step\n", max_err);
+
+    // 4 bit palette of hues, rotating it should scroll them along the strip without touching a pixel
+    hsv_t hues[16];
+    for (int n = 0; n < 16; n++)
+    {
+        hues[n] = {(uint8_t)(n * 16), 255, 255};
+    }
+    os_led_strip_enable_palette(&strips[2], 4, &col, 1);
+    os_led_strip_set_palette_hsv(&strips[2], 0, hues, 16);
+    for (int p = 0; p < TEST_STRIP_PIXELS; p++)
+    {
+        os_led_strip_set_index(&strips[2], p, p % 16);
+    }
+
+    wrong = 0;
+    const rgb_t *rotated = _sim_os_led_strip_get_output(strips[2].strip);
+    for (int frame = 0; frame < 16; frame++)
+    {
+        os_led_strip_rotate_palette(&strips[2], 0, 16, 1);
+        os_led_strip_show(&strips[2]);
+        for (int p = 0; p < TEST_STRIP_PIXELS; p++)
+        {
+            rgb_t expected_col = hsv2rgb(hues[(p + 15 - frame) % 16]);
+            if (memcmp(&rotated[p], &expected_col, sizeof(rgb_t)) != 0)
+            {
+                wrong++;
+            }
+        }
+    }
+    os_printf("pixels wrong while rotating the palette: %d, %d bytes of indices instead of %d of colors\n", wrong,
+              TEST_STRIP_PIXELS / 2, TEST_STRIP_PIXELS * (int)sizeof(rgb_t));
+
+    // Producers each owning a quarter of the strip, against the same drawing done a pixel at a time under the mutex
+    const int count = TEST_STRIP_PIXELS / TEST_STRIP_PRODUCERS;
+    for (int n = 0; n < TEST_STRIP_PRODUCERS; n++)
+    {
+        os_led_strip_add_segment(&strips[3], n * count, count, &segments[n]);
+    }
+    int64_t segment_us = test_led_strip_run_producers(true);
+    int64_t locked_us = test_led_strip_run_producers(false);
+
+    wrong = 0;
+    const rgb_t *shown = _sim_os_led_strip_get_output(strips[3].strip);
+    for (int p = 0; p < TEST_STRIP_PIXELS; p++)
+    {
+        rgb_t expected_col = test_led_strip_producer_col(p / count, TEST_STRIP_PRODUCER_FRAMES - 1, p % count);
+        if (memcmp(&shown[p], &expected_col, sizeof(rgb_t)) != 0)
+        {
+            wrong++;
+        }
+    }
+    os_printf("%d producers, %d frames: %lld us with segments, %lld us setting pixels, %d pixels wrong\n",
+              TEST_STRIP_PRODUCERS, TEST_STRIP_PRODUCER_FRAMES, (long long)segment_us, (long long)locked_us, wrong);
+}
+
+#endif
@@ -0,0 +1,515 @@
+#include "global_includes.h"
+
+#ifdef OS_TEST_LEDMATRIX
+#include <chrono>
+#include <math.h>
+#include <thread>
+
+#define TEST_MATRIX_WIDTH 64
+#define TEST_MATRIX_HEIGHT 32
+#define TEST_MATRIX_FRAMES 100
+#define TEST_SPRITE_SIZE 32
+#define TEST_CANVAS_MARGIN 96
+#define TEST_CLIP_SHAPES 2000
+#define TEST_PALETTE_WIDTH 16
+#define TEST_PALETTE_HEIGHT 12
+
+// Stand in backend that just keeps its own copy of the panel, like most DMA backends do
+static rgb_t panel[TEST_MATRIX_WIDTH * TEST_MATRIX_HEIGHT];
+static hsv_t image[TEST_MATRIX_WIDTH * TEST_MATRIX_HEIGHT];
+static uint8_t logo[TEST_SPRITE_SIZE * TEST_SPRITE_SIZE * 3];
+static rgb_t reference[TEST_MATRIX_WIDTH * TEST_MATRIX_HEIGHT];
+static int panel_calls = 0;
+static os_ledmatrix_t matrix;
+static os_ledmatrix_t buffered;
+// Bigger than the matrix by a margin all round so nothing drawn on it gets clipped, what clipping is checked against
+static os_ledmatrix_t canvas;
+static os_ledmatrix_t mapped_square;
+static os_ledmatrix_t mapped_wide;
+static os_ledmatrix_t composited;
+static os_ledmatrix_t paletted;
+static os_ledmatrix_compositor_t comp;
+static os_ledmatrix_layer_t layers[3];
+
+typedef struct test_mapping
+{
+    const char *name;
+    os_ledmatrix_t *matrix;
+    os_ledmatrix_mapping_t mapping;
+    // Chain index of every logical pixel, row by row, worked out by hand
+    uint32_t chain[16];
+} test_mapping_t;
+
+static const test_mapping_t mappings[] = {
+    {"serpentine", &mapped_square, {0, 0, 1, 1, true, false, false, MATRIX_ROTATE_0, false, false},
+     {0, 1, 2, 3, 7, 6, 5, 4, 8, 9, 10, 11, 15, 14, 13, 12}},
+    {"column major", &mapped_square, {0, 0, 1, 1, false, true, false, MATRIX_ROTATE_0, false, false},
+     {0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15}},
+    {"column major serpentine", &mapped_square, {0, 0, 1, 1, true, true, false, MATRIX_ROTATE_0, false, false},
+     {0, 7, 8, 15, 1, 6, 9, 14, 2, 5, 10, 13, 3, 4, 11, 12}},
+    {"2x2 tiles, tile serpentine", &mapped_square, {2, 2, 2, 2, false, false, true, MATRIX_ROTATE_0, false, false},
+     {0, 1, 4, 5, 2, 3, 6, 7, 12, 13, 8, 9, 14, 15, 10, 11}},
+    {"mirrored serpentine", &mapped_square, {0, 0, 1, 1, true, false, false, MATRIX_ROTATE_0, true, false},
+     {3, 2, 1, 0, 4, 5, 6, 7, 11, 10, 9, 8, 12, 13, 14, 15}},
+    {"rotated 90", &mapped_wide, {0, 0, 1, 1, false, false, false, MATRIX_ROTATE_90, false, false}, {1, 3, 5, 7, 0, 2, 4, 6}},
+    {"rotated 180, mirrored y", &mapped_wide, {0, 0, 1, 1, false, false, false, MATRIX_ROTATE_180, false, true},
+     {3, 2, 1, 0, 7, 6, 5, 4}},
+};
+
+static int test_matrix_init(void *ptr, int width, int height)
+{
+    return OS_RET_OK;
+}
+
+static int test_matrix_setpixel(void *ptr, int x, int y, uint8_t r, uint8_t g, uint8_t b)
+{
+    panel_calls++;
+    panel[y * TEST_MATRIX_WIDTH + x] = {r, g, b};
+    return OS_RET_OK;
+}
+
+static int test_matrix_update(void *ptr)
+{
+    return OS_RET_OK;
+}
+
+static int test_matrix_blit(void *ptr, int x, int y, int w, int h, const rgb_t *buf, int stride)
+{
+    panel_calls++;
+    for (int n = 0; n < h; n++)
+    {
+        memcpy(&panel[(y + n) * TEST_MATRIX_WIDTH + x], &buf[n * stride], w * sizeof(rgb_t));
+    }
+    return OS_RET_OK;
+}
+
+// Backend pointer is the width of the rows coming in, the panel itself is always TEST_MATRIX_WIDTH wide
+static int test_matrix_blit_rows(void *ptr, int y, int rows, const rgb_t *buf)
+{
+    int width = *(int *)ptr;
+    panel_calls++;
+    for (int n = 0; n < rows; n++)
+    {
+        memcpy(&panel[(y + n) * TEST_MATRIX_WIDTH], &buf[n * width], width * sizeof(rgb_t));
+    }
+    return OS_RET_OK;
+}
+
+static int test_matrix_clear(void *ptr)
+{
+    panel_calls++;
+    memset(panel, 0, sizeof(panel));
+    return OS_RET_OK;
+}
+
+// Times pushing a full frame and a cleared frame out to the backend, returns nanoseconds per frame
+static int64_t test_ledmatrix_frame_cost(void)
+{
+    panel_calls = 0;
+    std::chrono::steady_clock::duration update_time(0);
+    for (int frame = 0; frame < TEST_MATRIX_FRAMES; frame++)
+    {
+        os_setpixel_ledmatrix_hsv_image(&matrix, image);
+        auto start = std::chrono::steady_clock::now();
+        os_ledmatrix_update(&matrix);
+        update_time += std::chrono::steady_clock::now() - start;
+
+        os_clear_ledmatrix(&matrix);
+        start = std::chrono::steady_clock::now();
+        os_ledmatrix_update(&matrix);
+        update_time += std::chrono::steady_clock::now() - start;
+    }
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(update_time).count() / TEST_MATRIX_FRAMES;
+}
+
+// Straightforward floating point scale + rotate, what the transformed blit is measured against
+static void test_ledmatrix_float_transform(float scale, float angle)
+{
+    float c = cosf(angle);
+    float s = sinf(angle);
+    for (int y = 0; y < TEST_MATRIX_HEIGHT; y++)
+    {
+        for (int x = 0; x < TEST_MATRIX_WIDTH; x++)
+        {
+            float dx = x + 0.5f - TEST_MATRIX_WIDTH / 2;
+            float dy = y + 0.5f - TEST_MATRIX_HEIGHT / 2;
+            int u = (int)floorf((c * dx + s * dy) / scale + TEST_SPRITE_SIZE / 2);
+            int v = (int)floorf((c * dy - s * dx) / scale + TEST_SPRITE_SIZE / 2);
+            if (u >= 0 && u < TEST_SPRITE_SIZE && v >= 0 && v < TEST_SPRITE_SIZE)
+            {
+                const uint8_t *px = &logo[(v * TEST_SPRITE_SIZE + u) * 3];
+                reference[y * TEST_MATRIX_WIDTH + x] = {px[0], px[1], px[2]};
+            }
+        }
+    }
+}
+
+// Times drawing the logo spinning and zooming in the middle of the panel, returns nanoseconds per frame
+static int64_t test_ledmatrix_transform_cost(os_ledmatrix_t *matrix, int mode)
+{
+    os_ledmatrix_sprite_t sprite = {logo, MATRIX_SPRITE_RGB, TEST_SPRITE_SIZE, TEST_SPRITE_SIZE, 0};
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < TEST_MATRIX_FRAMES; frame++)
+    {
+        float scale = 0.5f + frame / (float)TEST_MATRIX_FRAMES;
+        float angle = frame * 0.05f;
+        if (mode < 0)
+        {
+            test_ledmatrix_float_transform(scale, angle);
+            continue;
+        }
+
+        os_ledmatrix_transform_t transform;
+        os_ledmatrix_transform_init(&transform, {TEST_SPRITE_SIZE / 2, TEST_SPRITE_SIZE / 2},
+                                    {TEST_MATRIX_WIDTH / 2, TEST_MATRIX_HEIGHT / 2}, scale, scale, angle);
+        os_blit_sprite_transformed_ledmatrix(matrix, &sprite, &transform, (os_ledmatrix_sample_t)mode, 0);
+    }
+    auto time = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time).count() / TEST_MATRIX_FRAMES;
+}
+
+// Pixels of the matrix that differ from the window of the canvas it lines up with
+static int test_ledmatrix_clip_diff(void)
+{
+    int wrong = 0;
+    int canvas_width = TEST_MATRIX_WIDTH + 2 * TEST_CANVAS_MARGIN;
+    for (int y = 0; y < TEST_MATRIX_HEIGHT; y++)
+    {
+        for (int x = 0; x < TEST_MATRIX_WIDTH; x++)
+        {
+            const rgb_t *clipped = &matrix.framebuffer[y * TEST_MATRIX_WIDTH + x];
+            const rgb_t *unclipped = &canvas.framebuffer[(y + TEST_CANVAS_MARGIN) * canvas_width + x + TEST_CANVAS_MARGIN];
+            wrong += memcmp(clipped, unclipped, sizeof(rgb_t)) != 0;
+        }
+    }
+    return wrong;
+}
+
+// Anywhere from well off the panel to well past it, but inset from the canvas edge
+static os_2d_point_t test_ledmatrix_random_point(int inset)
+{
+    int reach = TEST_CANVAS_MARGIN - inset;
+    return {rand() % (TEST_MATRIX_WIDTH + 2 * reach) - reach, rand() % (TEST_MATRIX_HEIGHT + 2 * reach) - reach};
+}
+
+static os_2d_point_t test_ledmatrix_on_canvas(os_2d_point_t point)
+{
+    return {point.x + TEST_CANVAS_MARGIN, point.y + TEST_CANVAS_MARGIN};
+}
+
+// Random triangles, polygons and ellipses on the matrix and the canvas, returns how many left the two different
+static int test_ledmatrix_clip_fills(void)
+{
+    int wrong = 0;
+    for (int n = 0; n < TEST_CLIP_SHAPES; n++)
+    {
+        os_clear_ledmatrix(&matrix);
+        os_clear_ledmatrix(&canvas);
+        rgb_t color = {(uint8_t)(n * 7 + 1), (uint8_t)(n * 13), (uint8_t)(n * 29)};
+
+        os_2d_point_t points[OS_LEDMATRIX_MAX_POLYGON_POINTS];
+        os_2d_point_t moved[OS_LEDMATRIX_MAX_POLYGON_POINTS];
+        int num_points = 3 + n % (OS_LEDMATRIX_MAX_POLYGON_POINTS - 2);
+        for (int p = 0; p < num_points; p++)
+        {
+            points[p] = test_ledmatrix_random_point(0);
+            moved[p] = test_ledmatrix_on_canvas(points[p]);
+        }
+
+        switch (n % 3)
+        {
+        case 0:
+            os_filltriangle_ledmatrix(&matrix, points[0], points[1], points[2], color);
+            os_filltriangle_ledmatrix(&canvas, moved[0], moved[1], moved[2], color);
+            break;
+        case 1:
+            os_fillpolygon_ledmatrix(&matrix, points, num_points, color);
+            os_fillpolygon_ledmatrix(&canvas, moved, num_points, color);
+            break;
+        default:
+        {
+            int rx = rand() % 48;
+            int ry = rand() % 48;
+            os_2d_point_t center = test_ledmatrix_random_point(48);
+            os_fillellipse_ledmatrix(&matrix, center, rx, ry, color);
+            os_fillellipse_ledmatrix(&canvas, test_ledmatrix_on_canvas(center), rx, ry, color);
+            break;
+        }
+        }
+        wrong += test_ledmatrix_clip_diff() != 0;
+    }
+    return wrong;
+}
+
+// Random plain, thick and anti-aliased lines on the matrix and the canvas, returns how many left the two different
+static int test_ledmatrix_clip_lines(void)
+{
+    int wrong = 0;
+    for (int n = 0; n < TEST_CLIP_SHAPES; n++)
+    {
+        os_clear_ledmatrix(&matrix);
+        os_clear_ledmatrix(&canvas);
+        rgb_t color = {(uint8_t)(n * 7 + 1), (uint8_t)(n * 13), (uint8_t)(n * 29)};
+
+        // Thick lines stick out past their ends, so keep them clear of the canvas edge
+        os_2d_line_t line = {test_ledmatrix_random_point(8), test_ledmatrix_random_point(8)};
+        os_2d_line_t moved = {test_ledmatrix_on_canvas(line.p1), test_ledmatrix_on_canvas(line.p2)};
+        switch (n % 3)
+        {
+        case 0:
+            os_drawline_ledmatrix(&matrix, line, color);
+            os_drawline_ledmatrix(&canvas, moved, color);
+            break;
+        case 1:
+            os_drawline_ledmatrix_thick(&matrix, line, 1 + n % 6, color);
+            os_drawline_ledmatrix_thick(&canvas, moved, 1 + n % 6, color);
+            break;
+        default:
+            os_drawline_ledmatrix_aa(&matrix, line, color);
+            os_drawline_ledmatrix_aa(&canvas, moved, color);
+            break;
+        }
+        wrong += test_ledmatrix_clip_diff() != 0;
+    }
+    return wrong;
+}
+
+// Layouts whose chain index tables don't match the hand worked ones
+static int test_ledmatrix_mappings(void)
+{
+    int wrong = 0;
+    for (size_t n = 0; n < sizeof(mappings) / sizeof(mappings[0]); n++)
+    {
+        const test_mapping_t *test = &mappings[n];
+        int ret = os_ledmatrix_set_mapping(test->matrix, &test->mapping);
+        int pixels = test->matrix->width * test->matrix->height;
+        if (ret != OS_RET_OK || memcmp(test->matrix->map_lut, test->chain, pixels * sizeof(uint32_t)) != 0)
+        {
+            os_printf("mapping %s: wrong chain indices\n", test->name);
+            wrong++;
+        }
+    }
+    return wrong;
+}
+
+// Pixels on the first row of the composited output that don't match expected
+static int test_ledmatrix_compose_diff(const rgb_t *expected, int count)
+{
+    int wrong = 0;
+    for (int x = 0; x < count; x++)
+    {
+        wrong += memcmp(&composited.framebuffer[x], &expected[x], sizeof(rgb_t)) != 0;
+    }
+    return wrong;
+}
+
+// Red background, a half transparent blue layer keyed on black, and an opaque green one keyed on black added before it
+// but stacked above it. Returns how many pixels came out wrong, before and after taking the green layer away
+static int test_ledmatrix_compose(void)
+{
+    rgb_t black = {0, 0, 0};
+    os_ledmatrix_compositor_init(&comp, &composited);
+    os_ledmatrix_layer_init(&comp, &layers[0], 0);
+    os_ledmatrix_layer_init(&comp, &layers[2], 2);
+    os_ledmatrix_layer_init(&comp, &layers[1], 1);
+
+    for (int y = 0; y < TEST_MATRIX_HEIGHT; y++)
+    {
+        for (int x = 0; x < TEST_MATRIX_WIDTH; x++)
+        {
+            os_setpixel_ledmatrix(&layers[0].canvas, x, y, {200, 0, 0});
+        }
+    }
+    os_setpixel_ledmatrix(&layers[1].canvas, 2, 0, {0, 0, 200});
+    os_setpixel_ledmatrix(&layers[1].canvas, 3, 0, {0, 0, 200});
+    os_ledmatrix_layer_set_opacity(&comp, &layers[1], 128);
+    os_ledmatrix_layer_set_color_key(&comp, &layers[1], true, black);
+    os_setpixel_ledmatrix(&layers[2].canvas, 0, 0, {0, 255, 0});
+    os_setpixel_ledmatrix(&layers[2].canvas, 3, 0, {0, 255, 0});
+    os_ledmatrix_layer_set_color_key(&comp, &layers[2], true, black);
+    os_ledmatrix_compose(&comp);
+
+    // 200 blended half way towards 0 and 0 towards 200 both come out at 100
+    const rgb_t stacked[] = {{0, 255, 0}, {200, 0, 0}, {100, 0, 100}, {0, 255, 0}, {200, 0, 0}};
+    int wrong = test_ledmatrix_compose_diff(stacked, 5);
+
+    os_ledmatrix_layer_deinit(&comp, &layers[2]);
+    os_ledmatrix_compose(&comp);
+    const rgb_t removed[] = {{200, 0, 0}, {200, 0, 0}, {100, 0, 100}, {100, 0, 100}, {200, 0, 0}};
+    wrong += test_ledmatrix_compose_diff(removed, 5);
+
+    os_ledmatrix_layer_deinit(&comp, &layers[1]);
+    os_ledmatrix_layer_deinit(&comp, &layers[0]);
+    return wrong;
+}
+
+// Fills a row of a 4 bit palette matrix, then changes a pixel on it and one on the row below, all through blit_rows.
+// Returns how many pixels on the panel don't match what was drawn
+static int test_ledmatrix_palette_rows(void)
+{
+    rgb_t colors[16];
+    for (int n = 0; n < 16; n++)
+    {
+        colors[n] = {(uint8_t)(n * 16), (uint8_t)(255 - n * 16), (uint8_t)(n * 8)};
+    }
+    colors[0] = {0, 0, 0};
+
+    memset(panel, 0, sizeof(panel));
+    os_ledmatrix_enable_palette(&paletted, 4, colors, 16);
+    for (int x = 0; x < TEST_PALETTE_WIDTH; x++)
+    {
+        os_setpixel_ledmatrix(&paletted, x, 3, colors[1]);
+    }
+    os_ledmatrix_update(&paletted);
+    os_setpixel_ledmatrix(&paletted, 5, 3, colors[2]);
+    os_setpixel_ledmatrix(&paletted, 5, 4, colors[3]);
+    os_ledmatrix_update(&paletted);
+
+    int wrong = 0;
+    for (int y = 0; y < TEST_PALETTE_HEIGHT; y++)
+    {
+        for (int x = 0; x < TEST_PALETTE_WIDTH; x++)
+        {
+            rgb_t expected = y == 3 ? colors[x == 5 ? 2 : 1] : y == 4 && x == 5 ? colors[3] : colors[0];
+            wrong += memcmp(&panel[y * TEST_MATRIX_WIDTH + x], &expected, sizeof(rgb_t)) != 0;
+        }
+    }
+    return wrong;
+}
+
+void test_ledmatrix(void *parameters)
+{
+    int dummy_backend = TEST_MATRIX_WIDTH;
+    for (int n = 0; n < TEST_MATRIX_WIDTH * TEST_MATRIX_HEIGHT; n++)
+    {
+        image[n] = {(uint8_t)n, 255, 128};
+    }
+
+    os_ledmatrix_init_t init;
+    memset(&init, 0, sizeof(init));
+    init.init_func = test_matrix_init;
+    init.setpixel_func = test_matrix_setpixel;
+    init.update_func = test_matrix_update;
+    init.width = TEST_MATRIX_WIDTH;
+    init.height = TEST_MATRIX_HEIGHT;
+    init.matrix_ptr = &dummy_backend;
+
+    int ret = os_init_ledmatrix(init, &matrix);
+    if (ret != OS_RET_OK)
+    {
+        os_printf("Failed to initialize led matrix: %d\n", ret);
+        return;
+    }
+
+    // One matrix the whole way through, with more of the bulk callbacks filled in each time
+    int64_t ns = test_ledmatrix_frame_cost();
+    os_printf("setpixel only: %lld ns/frame, %d backend calls\n", (long long)ns, panel_calls / TEST_MATRIX_FRAMES);
+
+    matrix.blit_rows_func = test_matrix_blit_rows;
+    matrix.clear_func = test_matrix_clear;
+    ns = test_ledmatrix_frame_cost();
+    os_printf("blit_rows + clear: %lld ns/frame, %d backend calls\n", (long long)ns, panel_calls / TEST_MATRIX_FRAMES);
+
+    matrix.blit_func = test_matrix_blit;
+    ns = test_ledmatrix_frame_cost();
+    os_printf("blit + clear: %lld ns/frame, %d backend calls\n", (long long)ns, panel_calls / TEST_MATRIX_FRAMES);
+
+    for (int n = 0; n < TEST_SPRITE_SIZE * TEST_SPRITE_SIZE * 3; n++)
+    {
+        logo[n] = (uint8_t)(n * 7);
+    }
+
+    os_printf("float transform: %lld ns/frame\n", (long long)test_ledmatrix_transform_cost(&matrix, -1));
+    os_printf("fixed point nearest: %lld ns/frame\n", (long long)test_ledmatrix_transform_cost(&matrix, MATRIX_SAMPLE_NEAREST));
+
+    // Last frame of both should come out the same, give or take rounding along sprite pixel edges
+    int mismatched = 0;
+    for (int n = 0; n < TEST_MATRIX_WIDTH * TEST_MATRIX_HEIGHT; n++)
+    {
+        if (memcmp(&reference[n], &matrix.framebuffer[n], sizeof(rgb_t)) != 0)
+        {
+            mismatched++;
+        }
+    }
+    os_printf("float vs fixed point nearest: %d of %d pixels differ\n", mismatched, TEST_MATRIX_WIDTH * TEST_MATRIX_HEIGHT);
+
+    os_printf("fixed point bilinear: %lld ns/frame\n", (long long)test_ledmatrix_transform_cost(&matrix, MATRIX_SAMPLE_BILINEAR));
+
+    init.width = TEST_MATRIX_WIDTH + 2 * TEST_CANVAS_MARGIN;
+    init.height = TEST_MATRIX_HEIGHT + 2 * TEST_CANVAS_MARGIN;
+    os_init_ledmatrix(init, &canvas);
+    init.width = TEST_MATRIX_WIDTH;
+    init.height = TEST_MATRIX_HEIGHT;
+
+    srand(1);
+    int wrong = test_ledmatrix_clip_fills();
+    os_printf("clipped vs unclipped fills: %d of %d differ%s\n", wrong, TEST_CLIP_SHAPES, wrong ? " FAIL" : "");
+    wrong = test_ledmatrix_clip_lines();
+    os_printf("clipped vs unclipped lines: %d of %d differ%s\n", wrong, TEST_CLIP_SHAPES, wrong ? " FAIL" : "");
+
+    init.width = 4;
+    init.height = 4;
+    os_init_ledmatrix(init, &mapped_square);
+    init.height = 2;
+    os_init_ledmatrix(init, &mapped_wide);
+    init.width = TEST_MATRIX_WIDTH;
+    init.height = TEST_MATRIX_HEIGHT;
+    wrong = test_ledmatrix_mappings();
+    os_printf("panel mappings: %d of %d wrong%s\n", wrong, (int)(sizeof(mappings) / sizeof(mappings[0])), wrong ? " FAIL" : "");
+
+    int palette_backend = TEST_PALETTE_WIDTH;
+    init.width = TEST_PALETTE_WIDTH;
+    init.height = TEST_PALETTE_HEIGHT;
+    init.matrix_ptr = &palette_backend;
+    init.blit_rows_func = test_matrix_blit_rows;
+    os_init_ledmatrix(init, &paletted);
+    init.width = TEST_MATRIX_WIDTH;
+    init.height = TEST_MATRIX_HEIGHT;
+    init.matrix_ptr = &dummy_backend;
+    init.blit_rows_func = NULL;
+    wrong = test_ledmatrix_palette_rows();
+    os_printf("palette rows through blit_rows: %d pixels wrong%s\n", wrong, wrong ? " FAIL" : "");
+
+    os_init_ledmatrix(init, &composited);
+    wrong = test_ledmatrix_compose();
+    os_printf("compositor z order, opacity and color key: %d pixels wrong%s\n", wrong, wrong ? " FAIL" : "");
+
+    os_2d_point_t star[OS_LEDMATRIX_MAX_POLYGON_POINTS + 1];
+    for (int n = 0; n <= OS_LEDMATRIX_MAX_POLYGON_POINTS; n++)
+    {
+        float angle = n * 6.2831853f / OS_LEDMATRIX_MAX_POLYGON_POINTS;
+        int radius = n % 2 ? 12 : 40;
+        star[n] = {TEST_MATRIX_WIDTH / 2 + (int)(radius * cosf(angle)), TEST_MATRIX_HEIGHT / 2 + (int)(radius * sinf(angle))};
+    }
+    rgb_t white = {255, 255, 255};
+    bool limits = os_fillpolygon_ledmatrix(&matrix, star, OS_LEDMATRIX_MAX_POLYGON_POINTS, white) == OS_RET_OK &&
+                  os_fillpolygon_ledmatrix(&matrix, star, OS_LEDMATRIX_MAX_POLYGON_POINTS + 1, white) == OS_RET_INVALID_PARAM &&
+                  os_fillpolygon_ledmatrix(&matrix, star, 2, white) == OS_RET_INVALID_PARAM;
+    os_printf("polygon point limit: %s\n", limits ? "enforced" : "FAIL");
+
+    // Presents in a burst while the flush thread is still on its slot, the last frame has to make it out without another present
+    memset(panel, 0, sizeof(panel));
+    os_init_ledmatrix(init, &buffered);
+    os_ledmatrix_enable_double_buffer(&buffered, 200);
+    std::thread flush_thread(os_ledmatrix_flush_thread, &buffered);
+    flush_thread.detach();
+    for (int frame = 0; frame < TEST_MATRIX_HEIGHT; frame++)
+    {
+        os_setpixel_ledmatrix(&buffered, frame, frame, {(uint8_t)(frame + 1), 0, 0});
+        os_ledmatrix_present(&buffered);
+    }
+    os_ledmatrix_wait_vsync(&buffered);
+
+    int missing = 0;
+    for (int frame = 0; frame < TEST_MATRIX_HEIGHT; frame++)
+    {
+        missing += panel[frame * TEST_MATRIX_WIDTH + frame].r != frame + 1;
+    }
+    os_ledmatrix_frame_stats_t stats;
+    os_ledmatrix_get_frame_stats(&buffered, &stats);
+    os_printf("double buffered burst: %u presented, %u folded into later frames, %d pixels missing after wait_vsync%s\n",
+              stats.frames_presented, stats.frames_dropped, missing, missing ? " FAIL" : "");
+}
+
+#endif
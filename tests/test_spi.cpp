@@ -1,9 +1,25 @@
 #include "global_includes.h"
 
 #ifdef OS_TEST_SPI
+#include <atomic>
+#include <chrono>
+
+#define TEST_SPI_TRANSACTIONS 32
+#define TEST_SPI_SIZE 1500
 
 static os_spi_t spi_bus;
 static os_device_t spi_device;
+static os_device_t spi_device2;
+
+static os_spi_trans_t trans[TEST_SPI_TRANSACTIONS];
+static uint8_t trans_rx[TEST_SPI_TRANSACTIONS][TEST_SPI_SIZE];
+static uint8_t trans_tx[TEST_SPI_TRANSACTIONS][TEST_SPI_SIZE];
+static std::atomic<int> callbacks;
+
+static void test_spi_done(os_spi_trans_t *trans, void *arg)
+{
+    callbacks++;
+}
 
 void test_spi(void *parameters)
 {
@@ -35,6 +51,75 @@ void test_spi(void *parameters)
     {
         os_printf("Failed to send data to spi: %d\n", ret);
     }
+
+    // Second device on the bus at the bus speed, so queued transactions from both have to take turns
+    os_spi_setbus(&spi_bus, params.clk);
+    params.cs_gpio = GPIO_NUM_10;
+    params.clk = 0;
+    ret = os_spi_couple_device(params, &spi_device2);
+    if (ret != 0)
+    {
+        os_printf("Failed to initialize second spi device: %d\n", ret);
+    }
+
+    for (int n = 0; n < TEST_SPI_TRANSACTIONS; n++)
+    {
+        for (int i = 0; i < TEST_SPI_SIZE; i++)
+        {
+            trans_tx[n][i] = n * 31 + i;
+        }
+    }
+
+    // One after the other, waiting on each
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < TEST_SPI_TRANSACTIONS; n++)
+    {
+        os_spi_transfer(n % 2 ? &spi_device2 : &spi_device, trans_rx[n], trans_tx[n], TEST_SPI_SIZE);
+    }
+    double blocking_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // All queued at once, the second device's finishing through callbacks, with some work going on meanwhile
+    memset(trans_rx, 0, sizeof(trans_rx));
+    start = std::chrono::steady_clock::now();
+    for (int n = 0; n < TEST_SPI_TRANSACTIONS; n++)
+    {
+        os_spi_trans_init(&trans[n], n % 2 ? &spi_device2 : &spi_device, trans_rx[n], trans_tx[n], TEST_SPI_SIZE,
+                          n % 2 ? test_spi_done : NULL, NULL);
+        ret = os_spi_queue_transfer(&trans[n]);
+        if (ret != 0)
+        {
+            os_printf("Failed to queue spi transaction: %d\n", ret);
+        }
+    }
+    double queue_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Bus speed can change while the queue is going out, it's picked up by the next batch
+    os_spi_setbus(&spi_bus, 2000000);
+
+    uint32_t work = 0;
+    for (int n = 0; n < TEST_SPI_TRANSACTIONS * TEST_SPI_SIZE; n++)
+    {
+        work = work * 33 + trans_tx[n % TEST_SPI_TRANSACTIONS][n % TEST_SPI_SIZE];
+    }
+
+    int failed = 0;
+    int wrong = 0;
+    for (int n = 0; n < TEST_SPI_TRANSACTIONS; n++)
+    {
+        failed += os_spi_get_result(&trans[n]) != OS_RET_OK;
+        // Only holds with MOSI jumpered to MISO
+        wrong += memcmp(trans_rx[n], trans_tx[n], TEST_SPI_SIZE) != 0;
+    }
+    double queued_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    os_printf("%d transactions: %.2f ms blocking, %.2f ms queued(%.3f ms to queue), %d failed, %d callbacks, %d not looped back, "
+              "work %08x\n",
+              TEST_SPI_TRANSACTIONS, blocking_s * 1e3, queued_s * 1e3, queue_s * 1e3, failed, callbacks.load(), wrong,
+              (unsigned)work);
+
+    os_spi_decouple_device(&spi_device2);
+    os_spi_decouple_device(&spi_device);
+    os_spi_deinit(&spi_bus);
     // hal_ble_serial_init();
     //  eventqueue = new_local_eventqueue(20);
     //  attach_event(EVENT_LED_UPDATE, event_callback);